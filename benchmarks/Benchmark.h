@@ -0,0 +1,201 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+
+/// <summary>
+/// A small benchmark runner. A benchmark is timed as the best of several samples and reported in nanoseconds per operation
+/// and in millions of operations per second. Results can be compared against a baseline file,
+/// a benchmark slower than its baseline by more than the threshold is reported as a regression and fails the run.
+/// Command line: [--baseline file] [--update] [--threshold fraction] [--filter substring]
+/// --update writes the results to the baseline file instead of comparing them, baselines are only meaningful on the machine that recorded them.
+/// Benchmarks under a millisecond are noisy on a shared machine, so the threshold should allow for it.
+/// </summary>
+namespace Benchmark {
+	using Clock = std::chrono::steady_clock;
+
+	// Keeps a value from being optimized away.
+	template <typename T> inline void keep(const T& value)
+	{
+		asm volatile("" : : "m"(value) : "memory");
+	}
+
+	// Makes the compiler assume that a value has changed, so that work on it is not hoisted out of the timing loop.
+	template <typename T> inline void clobber(T& value)
+	{
+		asm volatile("" : "+m"(value) : : "memory");
+	}
+
+	class Runner {
+	public:
+		Runner(const int argc, char** argv)
+		{
+			for (int i = 1; i < argc; i++) {
+				if (!strcmp(argv[i], "--baseline") && i + 1 < argc) this->baselinePath = argv[++i];
+				else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) this->threshold = atof(argv[++i]);
+				else if (!strcmp(argv[i], "--filter") && i + 1 < argc) this->filter = argv[++i];
+				else if (!strcmp(argv[i], "--update")) this->update = true;
+				else fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+			}
+
+			if (!this->baselinePath.empty()) this->loadBaseline();
+			printf("%-44s %12s %12s %12s %8s\n", "benchmark", "ns/op", "Mop/s", "baseline", "change");
+		}
+
+		/// <summary>
+		/// Times a benchmark. fn(iterations) must perform opsPerIteration operations per iteration,
+		/// the number of iterations is chosen so that a sample takes about sampleTime.
+		/// </summary>
+		template <typename Fn> void run(const std::string& name, const size_t opsPerIteration, Fn&& fn)
+		{
+			if (!this->filter.empty() && name.find(this->filter) == std::string::npos) return;
+
+			// warm up and calibrate, growing the iterations until a sample is long enough
+			size_t iterations = 1;
+			while (true) {
+				const double seconds = time(fn, iterations);
+				if (seconds >= sampleTime || iterations >= (size_t(1) << 40)) break;
+				iterations *= seconds > 0.0 ? std::clamp<size_t>(static_cast<size_t>(sampleTime / seconds * 1.2), 2, 64) : 64;
+			}
+
+			const double ops = static_cast<double>(iterations) * opsPerIteration;
+			auto measure = [&]() {
+				double best = time(fn, iterations);
+				for (int i = 1; i < sampleCount; i++) best = std::min(best, time(fn, iterations));
+				return best * 1e9 / ops;
+			};
+
+			double nsPerOp = measure();
+			if (this->update) {
+				// the baseline is the median of several measurements, so that a single lucky one does not make it too strict
+				std::vector<double> measurements = { nsPerOp };
+				for (int i = 1; i < updateMeasurements; i++) measurements.push_back(measure());
+				std::nth_element(measurements.begin(), measurements.begin() + measurements.size() / 2, measurements.end());
+				nsPerOp = measurements[measurements.size() / 2];
+			}
+			else {
+				// measure a regression again before reporting it, the machine may have been busy
+				auto iter = this->baseline.find(name);
+				for (int i = 0; i < regressionRetries && iter != this->baseline.end() && nsPerOp > iter->second * (1.0 + this->threshold); i++) {
+					nsPerOp = std::min(nsPerOp, measure());
+				}
+			}
+
+			this->report(name, nsPerOp);
+		}
+
+		// Prints the summary and writes or checks the baseline. Returns the exit code for main.
+		int finish()
+		{
+			if (this->update) {
+				if (this->baselinePath.empty()) {
+					fprintf(stderr, "--update needs --baseline.\n");
+					return 1;
+				}
+				return this->saveBaseline() ? 0 : 1;
+			}
+
+			if (this->baselinePath.empty()) return 0;
+			if (this->regressions.empty()) {
+				printf("No regressions above %.0f%% against %s\n", this->threshold * 100.0, this->baselinePath.c_str());
+				return 0;
+			}
+
+			printf("%zu regressions above %.0f%% against %s:\n", this->regressions.size(), this->threshold * 100.0, this->baselinePath.c_str());
+			for (const std::string& name : this->regressions) printf("  %s\n", name.c_str());
+			return 1;
+		}
+
+	private:
+		static constexpr double sampleTime = 0.002;
+		static constexpr int sampleCount = 7;
+		static constexpr int updateMeasurements = 5;
+		static constexpr int regressionRetries = 3;
+
+		std::string baselinePath;
+		std::string filter;
+		double threshold = 0.25;
+		bool update = false;
+
+		std::unordered_map<std::string, double> baseline;
+		// Benchmarks in the order they ran, with their results.
+		std::vector<std::pair<std::string, double>> results;
+		std::vector<std::string> regressions;
+
+		template <typename Fn> static double time(Fn& fn, const size_t iterations)
+		{
+			const auto start = Clock::now();
+			fn(iterations);
+			return std::chrono::duration<double>(Clock::now() - start).count();
+		}
+
+		void report(const std::string& name, const double nsPerOp)
+		{
+			this->results.emplace_back(name, nsPerOp);
+
+			auto iter = this->baseline.find(name);
+			if (this->update || iter == this->baseline.end()) {
+				printf("%-44s %12.3f %12.2f %12s %8s\n", name.c_str(), nsPerOp, 1e3 / nsPerOp, "-", "-");
+				return;
+			}
+
+			const double change = nsPerOp / iter->second - 1.0;
+			const bool regressed = change > this->threshold;
+			if (regressed) this->regressions.push_back(name);
+			printf("%-44s %12.3f %12.2f %12.3f %+7.1f%%%s\n", name.c_str(), nsPerOp, 1e3 / nsPerOp, iter->second, change * 100.0, regressed ? " REGRESSION" : "");
+		}
+
+		// The baseline format is one "name ns/op" pair per line, the name is everything before the last space. Lines starting with # are comments.
+		void loadBaseline()
+		{
+			std::ifstream file(this->baselinePath);
+			std::string line;
+			while (std::getline(file, line)) {
+				if (line.empty() || line[0] == '#') continue;
+				const size_t separator = line.rfind(' ');
+				if (separator == std::string::npos) continue;
+				this->baseline[line.substr(0, separator)] = atof(line.c_str() + separator + 1);
+			}
+		}
+
+		// Writes the results, keeping the baselines of benchmarks that were filtered out.
+		bool saveBaseline()
+		{
+			for (auto& [name, nsPerOp] : this->results) this->baseline[name] = nsPerOp;
+
+			std::vector<std::string> order;
+			for (auto& result : this->results) order.push_back(result.first);
+			std::vector<std::string> others;
+			for (auto& entry : this->baseline) {
+				if (std::find(order.begin(), order.end(), entry.first) == order.end()) others.push_back(entry.first);
+			}
+			std::sort(others.begin(), others.end());
+			order.insert(order.end(), others.begin(), others.end());
+
+			std::ofstream file(this->baselinePath);
+			if (!file) {
+				fprintf(stderr, "Unable to write %s.\n", this->baselinePath.c_str());
+				return false;
+			}
+
+			file << "# benchmark ns/op, written by --update\n";
+			for (const std::string& name : order) {
+				std::ostringstream value;
+				value.precision(4);
+				value << this->baseline[name];
+				file << name << ' ' << value.str() << '\n';
+			}
+
+			printf("Wrote %zu baselines to %s\n", order.size(), this->baselinePath.c_str());
+			return true;
+		}
+	};
+}
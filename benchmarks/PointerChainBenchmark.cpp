@@ -0,0 +1,75 @@
+#include <random>
+
+#include "include/PointerChain.h"
+#include "include/VxD.h"
+#include "Benchmark.h"
+
+// Benchmarks of PointerChain::resolveBatch against resolving the same chain for one character at a time,
+// as SkeletonMan reads the module blocks of all characters every frame. An operation is one resolved character.
+// The synthetic characters are the character instance, module and physics blocks of the game's layout (see HkSkeleton.h),
+// scattered over an arena much larger than the cache, so that every hop of a cold walk is a cache and TLB miss.
+
+namespace {
+	constexpr size_t slotSize = 0x400;
+	constexpr size_t arenaSize = 64 << 20;
+
+	using Module = PointerChain::Chain<uint8_t, 0x190, 0x0>;
+	using Position = PointerChain::Chain<V4D, 0x190u, 0x68u, 0x70u>;
+
+	struct Characters {
+		std::vector<uint8_t> arena;
+		std::vector<uint8_t*> chrInses;
+
+		Characters(const size_t count) : arena(arenaSize)
+		{
+			std::vector<size_t> slots(arenaSize / slotSize);
+			for (size_t i = 0; i < slots.size(); i++) slots[i] = i;
+			std::mt19937 rng(40);
+			std::shuffle(slots.begin(), slots.end(), rng);
+
+			for (size_t i = 0; i < count; i++) {
+				uint8_t* chrIns = this->arena.data() + slots[i * 3] * slotSize;
+				uint8_t* module = this->arena.data() + slots[i * 3 + 1] * slotSize;
+				uint8_t* physics = this->arena.data() + slots[i * 3 + 2] * slotSize;
+				memcpy(chrIns + 0x190, &module, sizeof(module));
+				memcpy(module + 0x68, &physics, sizeof(physics));
+				this->chrInses.push_back(chrIns);
+			}
+		}
+	};
+
+	template <typename Chain> void batchBenchmarks(Benchmark::Runner& runner, const std::string& name, Characters& characters)
+	{
+		const size_t count = characters.chrInses.size();
+		std::vector<typename Chain::PointerType*> results(count);
+
+		runner.run(name + " resolveBatch " + std::to_string(count), count, [&](const size_t iterations) {
+			for (size_t k = 0; k < iterations; k++) {
+				Benchmark::clobber(characters.arena[0]);
+				PointerChain::resolveBatch<Chain>(characters.chrInses.data(), results.data(), count);
+				Benchmark::clobber(results[0]);
+			}
+		});
+
+		runner.run(name + " serial " + std::to_string(count), count, [&](const size_t iterations) {
+			for (size_t k = 0; k < iterations; k++) {
+				Benchmark::clobber(characters.arena[0]);
+				for (size_t i = 0; i < count; i++) results[i] = std::get<0>(PointerChain::Bundle<Chain>::resolve(characters.chrInses[i]));
+				Benchmark::clobber(results[0]);
+			}
+		});
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Benchmark::Runner runner(argc, argv);
+
+	// as many characters as are usually loaded, whose blocks stay cached from frame to frame, and a crowd that does not fit
+	for (const size_t count : { 64, 8192 }) {
+		Characters characters(count);
+		batchBenchmarks<Module>(runner, "module", characters);
+		batchBenchmarks<Position>(runner, "position", characters);
+	}
+	return runner.finish();
+}
@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <thread>
+
+#include "include/PEImage.h"
+#include "include/RTTIScanner.h"
+#include "tests/SyntheticPE.h"
+#include "Benchmark.h"
+
+// Benchmarks of RTTIScanner::scan on PE images loaded from disk with PEImage, on one thread and on all hardware threads.
+// An operation is one scanned .rdata slot, so ns/op is the time per slot.
+// A synthetic image (see tests/SyntheticPE.h) is always scanned. An executable with MSVC RTTI, like the game's,
+// is also scanned if its path is in the SKELETONMAN_BENCHMARK_IMAGE environment variable. The checked in baseline is recorded
+// without it, so the results for the executable are only reported.
+
+namespace {
+	size_t rdataSlots(const PEImage& image)
+	{
+		PEParser parser;
+		if (!parser.parse(image.makeProcessInfo())) return 0;
+
+		size_t size = 0;
+		if (PEParser::PESections* rdata = parser.getSectionsWithName(".rdata")) {
+			for (auto& section : *rdata) size += section->size;
+		}
+		return size / sizeof(void*);
+	}
+
+	void scanBenchmarks(Benchmark::Runner& runner, const std::string& name, const PEImage& image)
+	{
+		const size_t slots = rdataSlots(image);
+		const unsigned int hardwareThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+		RTTIScanner scanner;
+		if (!slots || !scanner.scan(image.makeProcessInfo())) {
+			printf("%s has no RTTI to scan, skipped\n", name.c_str());
+			return;
+		}
+
+		for (const unsigned int threadCount : { 1u, hardwareThreads }) {
+			runner.run(name + " scan " + std::to_string(threadCount) + (threadCount == 1 ? " thread" : " threads"), slots, [&](const size_t iterations) {
+				for (size_t i = 0; i < iterations; i++) scanner.scan(image.makeProcessInfo(), threadCount);
+			});
+			if (hardwareThreads == 1) break;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	CPUFeatures::initialize();
+
+	SyntheticPE::Options options;
+	options.classCount = 3000;
+	options.secondaryTables = 500;
+	options.decoys = 20000;
+	options.rdataSections = 2;
+	options.rdataSize = 2 << 20;
+	const SyntheticPE::TempFile file(SyntheticPE::build(options).file);
+	const PEImage synthetic(file.getPath());
+
+	Benchmark::Runner runner(argc, argv);
+	scanBenchmarks(runner, "synthetic", synthetic);
+
+	const char* path = getenv("SKELETONMAN_BENCHMARK_IMAGE");
+	if (!path || !*path) {
+		printf("SKELETONMAN_BENCHMARK_IMAGE is not set, the executable image benchmarks are skipped\n");
+	}
+	else {
+		try {
+			const PEImage image(path);
+			scanBenchmarks(runner, "image", image);
+		}
+		catch (const std::exception& e) {
+			printf("Unable to load %s: %s\n", path, e.what());
+			return 1;
+		}
+	}
+
+	return runner.finish();
+}
@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <random>
+
+#include "include/PEImage.h"
+#include "include/SignatureScanner.h"
+#include "Benchmark.h"
+
+// Benchmarks of SignatureScanner on synthetic memory with the byte frequencies of x64 code, without the game.
+// An operation is one scanned byte, so ns/op is the time per byte and Mop/s the throughput in MB/s.
+// The .text sections of an executable, like the game's, are also scanned if its path is in the SKELETONMAN_BENCHMARK_IMAGE
+// environment variable, with the kernels selected for the CPU. The checked in baseline is recorded without it, so those results are only reported.
+
+namespace {
+	constexpr size_t memorySize = 4 << 20;
+
+	// Bytes that are frequent in x64 code: REX prefixes, moves, lea, calls, jumps, int3 padding, stack offsets and small displacements.
+	constexpr unsigned char frequentBytes[] = {
+		0x00, 0x00, 0x00, 0x00, 0x48, 0x48, 0x48, 0x8B, 0x8B, 0x89, 0x4C, 0x8D, 0x0F, 0xFF, 0xCC, 0xCC, 0xE8, 0x24,
+		0x44, 0x45, 0x85, 0xC0, 0x74, 0x75, 0xEB, 0x83, 0xC4, 0x20, 0x28, 0x30, 0x38, 0x40, 0x08, 0x10, 0x01, 0xC3
+	};
+
+	std::vector<unsigned char> makeMemory()
+	{
+		std::mt19937 rng(49);
+		std::vector<unsigned char> memory(memorySize);
+		for (auto& byte : memory) byte = rng() % 2 ? frequentBytes[rng() % std::size(frequentBytes)] : static_cast<unsigned char>(rng());
+		return memory;
+	}
+
+	// Signatures like the ones in the README, from a common prologue to rare SSE instructions. Each is planted a few times.
+	const char* singlePatterns[][2] = {
+		{ "common", "48 8B 05 ?? ?? ?? ?? 48 85 C0 74 ?? 48 8B 40 08" },
+		{ "call", "E8 ?? ?? ?? ?? 48 8B D8 48 85 C0" },
+		{ "rare", "0F 28 ?? ?? ?? ?? ?? 0F 59 C1 F3 0F 11" },
+		{ "long", "48 89 5C 24 ?? 48 89 74 24 ?? 57 48 83 EC 20 48 8B F9 48 8B 0D ?? ?? ?? ?? 48 8B F2 E8 ?? ?? ?? ?? 48 8B D8" },
+	};
+
+	// A set of the size a mod scans for at startup: prologues, global loads, calls and SSE math, with some common and some rare anchors.
+	const char* setPatterns[] = {
+		"48 8D 05 ?? ?? ?? ?? 48 89", "48 89 5C 24 ?? 57 48 83 EC 20", "E8 ?? ?? ?? ?? 48 8B", "CC CC CC CC CC CC CC CC 48 89 5C 24",
+		"0F 1F 44 00 00", "DE AD BE EF", "41 57 41 56 41 55 41 54 56 57 55 53 48 83 EC ?? 48 8D 6C 24 ?? 48 8B ?? 48 89",
+		"48 8B 0D ?? ?? ?? ?? 48 85 C9 74", "40 53 48 83 EC 20 48 8B D9", "F3 0F 10 05 ?? ?? ?? ?? F3 0F 59", "48 8B 05 ?? ?? ?? ?? 48 8B 88",
+		"80 B9 ?? ?? ?? ?? 00 74", "C7 44 24 ?? ?? ?? ?? ?? E8", "0F B6 81 ?? ?? ?? ?? C3", "48 63 41 ?? 48 8D", "66 0F 6F 05 ?? ?? ?? ??",
+		"48 89 6C 24 ?? 48 89 74 24 ?? 57", "4C 8D 05 ?? ?? ?? ?? BA ?? ?? ?? ?? 48 8B CB", "0F 28 F0 0F 28 C6", "83 F8 FF 75", "48 83 C4 28 C3",
+		"48 81 EC ?? ?? ?? ?? 48 8B 05", "44 8B C0 48 8B D3", "FF 15 ?? ?? ?? ?? 85 C0", "BA 10 00 00 00 48 8B", "B9 ?? ?? ?? ?? E8 ?? ?? ?? ?? 48 85 C0",
+		"48 8D 4C 24 ?? E8", "0F 84 ?? ?? ?? ?? 48 8B 4B", "F6 41 ?? 01 74", "C6 05 ?? ?? ?? ?? 01", "48 8B 5C 24 ?? 48 83 C4 ?? 5F C3", "41 B8 ?? ?? ?? ?? 48 8B D7"
+	};
+
+	// Writes copies of a pattern at random places, with random bytes for its wildcards.
+	void plant(std::vector<unsigned char>& memory, const char* pattern, std::mt19937& rng)
+	{
+		std::vector<unsigned char> bytes;
+		for (const char* c = pattern; *c; c++) {
+			if (*c == ' ') continue;
+			if (*c == '?') {
+				bytes.push_back(static_cast<unsigned char>(rng()));
+				if (c[1] == '?') c++;
+			}
+			else {
+				bytes.push_back(static_cast<unsigned char>(strtoul(std::string(c, 2).c_str(), nullptr, 16)));
+				c++;
+			}
+		}
+		for (int copy = 0; copy < 4; copy++) memcpy(memory.data() + rng() % (memory.size() - bytes.size()), bytes.data(), bytes.size());
+	}
+
+	void singleScanBenchmarks(Benchmark::Runner& runner, std::vector<unsigned char>& memory)
+	{
+		static const char* tierNames[] = { "SSE2", "SSE41", "AVX2", "AVX512" };
+
+		std::mt19937 rng(50);
+		std::vector<SignatureScanner::Signature> signatures;
+		for (const auto& [name, pattern] : singlePatterns) {
+			signatures.emplace_back(pattern);
+			plant(memory, pattern, rng);
+		}
+
+		// single scans have no SSE4.1 kernel, at that tier they run the SSE2 one
+		unsigned char* begin = memory.data();
+		unsigned char* end = memory.data() + memory.size();
+		for (const CPUFeatures::Tier tier : { CPUFeatures::Tier::SSE2, CPUFeatures::Tier::AVX2 }) {
+			if (CPUFeatures::force(tier) != tier) continue;
+			const std::string suffix = std::string("[") + tierNames[static_cast<int>(tier)] + "]";
+
+			for (size_t i = 0; i < signatures.size(); i++) {
+				runner.run(std::string("scan ") + singlePatterns[i][0] + suffix, memory.size(), [&](const size_t iterations) {
+					for (size_t k = 0; k < iterations; k++) {
+						Benchmark::clobber(begin);
+						Benchmark::keep(SignatureScanner::scan(signatures[i], begin, end).size());
+					}
+				});
+			}
+
+			// the first match is near the end, First mode scans almost all of the memory
+			SignatureScanner::Signature last("CC CC CC 48 8B 05 ?? ?? ?? ?? C3");
+			memcpy(end - 16, "\xCC\xCC\xCC\x48\x8B\x05\x01\x02\x03\x04\xC3", 11);
+			runner.run("scan First" + suffix, memory.size(), [&](const size_t iterations) {
+				for (size_t k = 0; k < iterations; k++) {
+					Benchmark::clobber(begin);
+					Benchmark::keep(SignatureScanner::scan(last, begin, end, SignatureScanner::Mode::First).size());
+				}
+			});
+		}
+		CPUFeatures::initialize();
+	}
+
+	// One pass for a set of signatures against a pass per signature, both per byte of memory scanned for the whole set.
+	void setScanBenchmarks(Benchmark::Runner& runner, std::vector<unsigned char>& memory)
+	{
+		static const char* tierNames[] = { "SSE2", "SSE41", "AVX2", "AVX512" };
+
+		std::mt19937 rng(51);
+		std::vector<SignatureScanner::Signature> signatures;
+		for (const char* pattern : setPatterns) {
+			signatures.emplace_back(pattern);
+			plant(memory, pattern, rng);
+		}
+		const SignatureScanner::SignatureSet set(signatures);
+		const std::string setName = "set of " + std::to_string(signatures.size());
+
+		unsigned char* begin = memory.data();
+		unsigned char* end = memory.data() + memory.size();
+		for (const CPUFeatures::Tier tier : { CPUFeatures::Tier::SSE2, CPUFeatures::Tier::SSE41, CPUFeatures::Tier::AVX2 }) {
+			if (CPUFeatures::force(tier) != tier) continue;
+			const std::string suffix = std::string("[") + tierNames[static_cast<int>(tier)] + "]";
+
+			runner.run("scan " + setName + suffix, memory.size(), [&](const size_t iterations) {
+				for (size_t k = 0; k < iterations; k++) {
+					Benchmark::clobber(begin);
+					Benchmark::keep(SignatureScanner::scan(set, begin, end).size());
+				}
+			});
+
+			// single scans have no SSE4.1 kernel
+			if (tier == CPUFeatures::Tier::SSE41) continue;
+			runner.run("scan " + setName + " separately" + suffix, memory.size(), [&](const size_t iterations) {
+				for (size_t k = 0; k < iterations; k++) {
+					Benchmark::clobber(begin);
+					for (const SignatureScanner::Signature& signature : signatures) Benchmark::keep(SignatureScanner::scan(signature, begin, end).size());
+				}
+			});
+		}
+		CPUFeatures::initialize();
+	}
+
+	// The signatures have no planted copies in an executable, so most of them are never found, as when a game update breaks a signature.
+	void imageBenchmarks(Benchmark::Runner& runner, const PEImage& image)
+	{
+		PEParser parser;
+		PEParser::PESections* text = parser.parse(image.makeProcessInfo()) ? parser.getSectionsWithName(".text") : nullptr;
+		if (!text) {
+			printf("The image has no .text section, skipped\n");
+			return;
+		}
+
+		size_t size = 0;
+		for (auto& section : *text) size += section->size;
+
+		unsigned char* base = image.getBase();
+		for (const auto& [name, pattern] : singlePatterns) {
+			const SignatureScanner::Signature signature(pattern);
+			runner.run(std::string("image scan ") + name, size, [&](const size_t iterations) {
+				for (size_t k = 0; k < iterations; k++) {
+					Benchmark::clobber(base);
+					for (auto& section : *text) Benchmark::keep(SignatureScanner::scan(signature, section->start.as(base), section->end.as(base)).size());
+				}
+			});
+		}
+
+		const std::vector<SignatureScanner::Signature> signatures(std::begin(setPatterns), std::end(setPatterns));
+		const SignatureScanner::SignatureSet set(signatures);
+		const std::string setName = "image scan set of " + std::to_string(signatures.size());
+		runner.run(setName, size, [&](const size_t iterations) {
+			for (size_t k = 0; k < iterations; k++) {
+				Benchmark::clobber(base);
+				for (auto& section : *text) Benchmark::keep(SignatureScanner::scan(set, section->start.as(base), section->end.as(base)).size());
+			}
+		});
+		runner.run(setName + " separately", size, [&](const size_t iterations) {
+			for (size_t k = 0; k < iterations; k++) {
+				Benchmark::clobber(base);
+				for (const SignatureScanner::Signature& signature : signatures) {
+					for (auto& section : *text) Benchmark::keep(SignatureScanner::scan(signature, section->start.as(base), section->end.as(base)).size());
+				}
+			}
+		});
+	}
+}
+
+int main(int argc, char** argv)
+{
+	CPUFeatures::initialize();
+	std::vector<unsigned char> memory = makeMemory();
+
+	Benchmark::Runner runner(argc, argv);
+	singleScanBenchmarks(runner, memory);
+	setScanBenchmarks(runner, memory);
+
+	const char* path = getenv("SKELETONMAN_BENCHMARK_IMAGE");
+	if (!path || !*path) {
+		printf("SKELETONMAN_BENCHMARK_IMAGE is not set, the executable image benchmarks are skipped\n");
+	}
+	else {
+		try {
+			const PEImage image(path);
+			imageBenchmarks(runner, image);
+		}
+		catch (const std::exception& e) {
+			printf("Unable to load %s: %s\n", path, e.what());
+			return 1;
+		}
+	}
+
+	return runner.finish();
+}
@@ -0,0 +1,296 @@
+#include <random>
+
+#include "include/VxD.h"
+#include "Benchmark.h"
+
+// Microbenchmarks of the VxD math.
+// Latency benchmarks feed every result into the next operation, so they measure the length of the dependency chain of one operation.
+// Operations that return a float are chained through one extra multiply and add. Throughput benchmarks run the operation
+// on independent elements, so they measure how many operations can overlap.
+
+namespace {
+	constexpr size_t count = 256;
+
+	struct Data {
+		alignas(16) V4D qa[count], qb[count];
+		alignas(16) V4D va[count], vb[count];
+		alignas(16) V4D axes[count];
+		alignas(16) ViewMatrix views[count];
+		m128Matrix ma[count], mb[count];
+		VxD::QuatX4 pa[count / 4], pb[count / 4];
+		float fa[count], weights[count * 4];
+
+		alignas(16) V4D outV[count];
+		float outF[count];
+		bool outB[count];
+		m128Matrix outM[count];
+		VxD::QuatX4 outP[count / 4];
+	};
+
+	Data data;
+
+	V4D randomQ(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> d(-1.0f, 1.0f);
+		return V4D(d(rng), d(rng), d(rng), d(rng)).normalize();
+	}
+
+	V4D randomV(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> d(-10.0f, 10.0f);
+		return V4D(d(rng), d(rng), d(rng));
+	}
+
+	void fill()
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		for (size_t i = 0; i < count; i++) {
+			data.qa[i] = randomQ(rng);
+			data.qb[i] = randomQ(rng);
+			data.va[i] = randomV(rng);
+			data.vb[i] = randomV(rng);
+			data.axes[i] = randomV(rng).normalize();
+			data.fa[i] = unit(rng);
+			data.weights[i * 4] = unit(rng);
+
+			data.ma[i] = VxD::mFromTransform(data.qa[i], data.va[i], V4D(1.5f));
+			data.mb[i] = VxD::mFromTransform(data.qb[i], data.vb[i], V4D(0.5f));
+
+			// a rotation matrix with the translation in the last row, as the game stores them
+			alignas(16) float rows[4][4];
+			for (int r = 0; r < 4; r++) _mm_store_ps(rows[r], data.ma[i].r[r]);
+			memcpy(data.views[i].mtx, rows, sizeof(rows));
+		}
+
+		for (size_t i = 0; i < count / 4; i++) {
+			data.pa[i] = VxD::QuatX4::load(&data.qa[i * 4]);
+			data.pb[i] = VxD::QuatX4::load(&data.qb[i * 4]);
+		}
+	}
+
+	constexpr size_t mask = count - 1;
+
+	// Every result is the next input. step(value, i) must depend on value.
+	template <typename T, typename Step> void latency(Benchmark::Runner& runner, const std::string& name, const T initial, Step step)
+	{
+		runner.run(name + " latency", 1, [&](const size_t iterations) {
+			T value = initial;
+			for (size_t i = 0; i < iterations; i++) value = step(value, i & mask);
+			Benchmark::keep(value);
+		});
+	}
+
+	// Operations on independent elements, op(i) is stored to out[i].
+	template <typename T, size_t N, typename Op> void throughput(Benchmark::Runner& runner, const std::string& name, T (&out)[N], Op op)
+	{
+		runner.run(name + " throughput", N, [&](const size_t iterations) {
+			for (size_t k = 0; k < iterations; k++) {
+				Benchmark::clobber(data);
+				for (size_t i = 0; i < N; i++) out[i] = op(i);
+				Benchmark::clobber(out);
+			}
+		});
+	}
+
+	// Chains a float result into the next input vector.
+	inline V4D feed(const V4D v, const float f)
+	{
+		return _mm_add_ss(v, _mm_set_ss(f * 0.0f));
+	}
+
+	void vectorBenchmarks(Benchmark::Runner& runner)
+	{
+		const V4D* va = data.va;
+		const V4D* vb = data.vb;
+
+		latency(runner, "V4D::operator+", va[0], [&](V4D v, size_t i) { return v + vb[i]; });
+		throughput(runner, "V4D::operator+", data.outV, [&](size_t i) { return va[i] + vb[i]; });
+		latency(runner, "V4D::operator-", va[0], [&](V4D v, size_t i) { return v - vb[i]; });
+		throughput(runner, "V4D::operator-", data.outV, [&](size_t i) { return va[i] - vb[i]; });
+		latency(runner, "V4D::operator*(float)", va[0], [&](V4D v, size_t i) { return v * (1.0f + data.fa[i] * 1e-6f); });
+		throughput(runner, "V4D::operator*(float)", data.outV, [&](size_t i) { return va[i] * data.fa[i]; });
+		latency(runner, "V4D::operator/(float)", va[0], [&](V4D v, size_t i) { return v / (1.0f + data.fa[i] * 1e-6f); });
+		throughput(runner, "V4D::operator/(float)", data.outV, [&](size_t i) { return va[i] / (1.0f + data.fa[i]); });
+		latency(runner, "V4D::operator+=", va[0], [&](V4D v, size_t i) { v += vb[i]; return v; });
+		latency(runner, "V4D::operator-=", va[0], [&](V4D v, size_t i) { v -= vb[i]; return v; });
+		latency(runner, "V4D::operator*=", va[0], [&](V4D v, size_t i) { v *= 1.0f + data.fa[i] * 1e-6f; return v; });
+		latency(runner, "V4D::operator/=", va[0], [&](V4D v, size_t i) { v /= 1.0f + data.fa[i] * 1e-6f; return v; });
+
+		throughput(runner, "V4D::isfinite", data.outB, [&](size_t i) { return va[i].isfinite(); });
+		throughput(runner, "V4D::iszero", data.outB, [&](size_t i) { return va[i].iszero(); });
+		latency(runner, "V4D::hadd", va[0], [&](V4D v, size_t i) { return V4D(v.hadd()) + vb[i]; });
+		throughput(runner, "V4D::hadd", data.outV, [&](size_t i) { return va[i].hadd(); });
+		latency(runner, "V4D::length", va[0], [&](V4D v, size_t i) { return feed(vb[i] + v, v.length()); });
+		throughput(runner, "V4D::length", data.outF, [&](size_t i) { return va[i].length(); });
+		latency(runner, "V4D::length2", va[0], [&](V4D v, size_t i) { return feed(vb[i] + v, v.length2()); });
+		throughput(runner, "V4D::length2", data.outF, [&](size_t i) { return va[i].length2(); });
+		throughput(runner, "V4D::inRange", data.outF, [&](size_t i) { return va[i].inRange(vb[i], 10.0f); });
+		latency(runner, "V4D::normalize", va[0], [&](V4D v, size_t i) { return v.normalize() + vb[i]; });
+		throughput(runner, "V4D::normalize", data.outV, [&](size_t i) { return va[i].normalize(); });
+		latency(runner, "V4D::scaleTo", va[0], [&](V4D v, size_t i) { return v.scaleTo(2.0f) + vb[i]; });
+		throughput(runner, "V4D::scaleTo", data.outV, [&](size_t i) { return va[i].scaleTo(2.0f); });
+		latency(runner, "V4D::flatten<Z>", va[0], [&](V4D v, size_t i) { return v.flatten<V4D::CoordinateAxis::Z>() + vb[i]; });
+		throughput(runner, "V4D::flatten<Z>", data.outV, [&](size_t i) { return va[i].flatten<V4D::CoordinateAxis::Z>(); });
+		latency(runner, "V4D::flatten<Z, Normalize>", va[0], [&](V4D v, size_t i) { return v.flatten<V4D::CoordinateAxis::Z, true>() + vb[i]; });
+		throughput(runner, "V4D::flatten<Z, Normalize>", data.outV, [&](size_t i) { return va[i].flatten<V4D::CoordinateAxis::Z, true>(); });
+		latency(runner, "V4D::operator*(V4D)", va[0], [&](V4D v, size_t i) { return feed(vb[i] + v, v * vb[i]); });
+		throughput(runner, "V4D::operator*(V4D)", data.outF, [&](size_t i) { return va[i] * vb[i]; });
+		latency(runner, "V4D::dot3", va[0], [&](V4D v, size_t i) { return feed(vb[i] + v, v.dot3(vb[i])); });
+		throughput(runner, "V4D::dot3", data.outF, [&](size_t i) { return va[i].dot3(vb[i]); });
+		latency(runner, "V4D::cross", va[0], [&](V4D v, size_t i) { return v.cross(data.axes[i]); });
+		throughput(runner, "V4D::cross", data.outV, [&](size_t i) { return va[i].cross(vb[i]); });
+		latency(runner, "V4D::projectOnto", va[0], [&](V4D v, size_t i) { return v.projectOnto(data.axes[i]) + vb[i]; });
+		throughput(runner, "V4D::projectOnto", data.outV, [&](size_t i) { return va[i].projectOnto(data.axes[i]); });
+		throughput(runner, "V4D::sign2v", data.outF, [&](size_t i) { return va[i].sign2v(vb[i]); });
+		throughput(runner, "V4D(axis, angle)", data.outV, [&](size_t i) { return V4D(data.axes[i], data.fa[i] * 3.0f); });
+		throughput(runner, "V4D(from, to)", data.outV, [&](size_t i) { return V4D(data.axes[i], data.axes[(i + 1) & mask]); });
+	}
+
+	void quaternionBenchmarks(Benchmark::Runner& runner)
+	{
+		const V4D* qa = data.qa;
+		const V4D* qb = data.qb;
+
+		latency(runner, "V4D::qConjugate", qa[0], [&](V4D q, size_t i) { return q.qConjugate() + qb[i]; });
+		throughput(runner, "V4D::qConjugate", data.outV, [&](size_t i) { return qa[i].qConjugate(); });
+		latency(runner, "V4D::qNegate", qa[0], [&](V4D q, size_t i) { return q.qNegate() + qb[i]; });
+		throughput(runner, "V4D::qNegate", data.outV, [&](size_t i) { return qa[i].qNegate(); });
+		latency(runner, "V4D::qMul", qa[0], [&](V4D q, size_t i) { return q.qMul(qb[i]); });
+		throughput(runner, "V4D::qMul", data.outV, [&](size_t i) { return qa[i].qMul(qb[i]); });
+		latency(runner, "V4D::qDiv", qa[0], [&](V4D q, size_t i) { return q.qDiv(qb[i]); });
+		throughput(runner, "V4D::qDiv", data.outV, [&](size_t i) { return qa[i].qDiv(qb[i]); });
+		latency(runner, "V4D::qTransform", data.va[0], [&](V4D v, size_t i) { return v.qTransform(qb[i]); });
+		throughput(runner, "V4D::qTransform", data.outV, [&](size_t i) { return data.va[i].qTransform(qb[i]); });
+		latency(runner, "V4D::qPow<Fast>", qa[0], [&](V4D q, size_t i) { return q.qPow<true>(0.5f + data.fa[i]).qMul(qb[i]); });
+		throughput(runner, "V4D::qPow<Fast>", data.outV, [&](size_t i) { return qa[i].qPow<true>(data.fa[i]); });
+		latency(runner, "V4D::qPow<Accurate>", qa[0], [&](V4D q, size_t i) { return q.qPow<false>(0.5f + data.fa[i]).qMul(qb[i]); });
+		throughput(runner, "V4D::qPow<Accurate>", data.outV, [&](size_t i) { return qa[i].qPow<false>(data.fa[i]); });
+		latency(runner, "V4D::qSlerp<Fast>", qa[0], [&](V4D q, size_t i) { return q.qSlerp<true>(qb[i], data.fa[i]); });
+		throughput(runner, "V4D::qSlerp<Fast>", data.outV, [&](size_t i) { return qa[i].qSlerp<true>(qb[i], data.fa[i]); });
+		latency(runner, "V4D::qSlerp<Accurate>", qa[0], [&](V4D q, size_t i) { return q.qSlerp<false>(qb[i], data.fa[i]); });
+		throughput(runner, "V4D::qSlerp<Accurate>", data.outV, [&](size_t i) { return qa[i].qSlerp<false>(qb[i], data.fa[i]); });
+		latency(runner, "V4D::qNlerp", qa[0], [&](V4D q, size_t i) { return q.qNlerp(qb[i], data.fa[i]); });
+		throughput(runner, "V4D::qNlerp", data.outV, [&](size_t i) { return qa[i].qNlerp(qb[i], data.fa[i]); });
+		latency(runner, "V4D::qFromTo", data.axes[0], [&](V4D v, size_t i) { return v.qFromTo(data.axes[i]).qTransform(data.axes[i]).normalize(); });
+		throughput(runner, "V4D::qFromTo", data.outV, [&](size_t i) { return data.axes[i].qFromTo(data.axes[(i + 1) & mask]); });
+		throughput(runner, "V4D::vmtxToQ", data.outV, [&](size_t i) { return V4D::vmtxToQ(&data.views[i]); });
+	}
+
+	void approxBenchmarks(Benchmark::Runner& runner)
+	{
+		using namespace VxD::Approx;
+		const float* fa = data.fa;
+
+		latency(runner, "Approx::sin", 0.5f, [&](float x, size_t i) { return sin(x) + fa[i]; });
+		throughput(runner, "Approx::sin", data.outF, [&](size_t i) { return sin(fa[i] * 6.0f); });
+		latency(runner, "Approx::cos", 0.5f, [&](float x, size_t i) { return cos(x) + fa[i]; });
+		throughput(runner, "Approx::cos", data.outF, [&](size_t i) { return cos(fa[i] * 6.0f); });
+		latency(runner, "Approx::atan2", 0.5f, [&](float x, size_t i) { return atan2(x, fa[i] + 0.5f); });
+		throughput(runner, "Approx::atan2", data.outF, [&](size_t i) { return atan2(fa[i], 1.0f - fa[i]); });
+		latency(runner, "Approx::acos", 0.5f, [&](float x, size_t i) { return acos(x) * fa[i]; });
+		throughput(runner, "Approx::acos", data.outF, [&](size_t i) { return acos(fa[i] * 2.0f - 1.0f); });
+		latency(runner, "Approx::log", 0.5f, [&](float x, size_t i) { return log(x + 2.0f) + fa[i]; });
+		throughput(runner, "Approx::log", data.outF, [&](size_t i) { return log(fa[i] + 0.5f); });
+		latency(runner, "Approx::exp", 0.5f, [&](float x, size_t i) { return exp(x) * fa[i]; });
+		throughput(runner, "Approx::exp", data.outF, [&](size_t i) { return exp(fa[i]); });
+	}
+
+	void packetBenchmarks(Benchmark::Runner& runner)
+	{
+		using VxD::QuatX4;
+		const QuatX4* pa = data.pa;
+		const QuatX4* pb = data.pb;
+		constexpr size_t packetMask = count / 4 - 1;
+
+		// per packet of 4 quaternions
+		latency(runner, "QuatX4::qMul", pa[0], [&](QuatX4 p, size_t i) { return p.qMul(pb[i & packetMask]); });
+		throughput(runner, "QuatX4::qMul", data.outP, [&](size_t i) { return pa[i].qMul(pb[i]); });
+		latency(runner, "QuatX4::qTransform", pa[0], [&](QuatX4 p, size_t i) { return p.qTransform(pb[i & packetMask]); });
+		throughput(runner, "QuatX4::qTransform", data.outP, [&](size_t i) { return pa[i].qTransform(pb[i]); });
+		latency(runner, "QuatX4::normalize", pa[0], [&](QuatX4 p, size_t i) { return p.qMul(pb[i & packetMask]).normalize(); });
+		throughput(runner, "QuatX4::normalize", data.outP, [&](size_t i) { return pa[i].normalize(); });
+		latency(runner, "QuatX4::normalizeFast", pa[0], [&](QuatX4 p, size_t i) { return p.qMul(pb[i & packetMask]).normalizeFast(); });
+		throughput(runner, "QuatX4::normalizeFast", data.outP, [&](size_t i) { return pa[i].normalizeFast(); });
+		throughput(runner, "QuatX4::qNlerp", data.outP, [&](size_t i) { return pa[i].qNlerp(pb[i], _mm_set1_ps(data.fa[i])); });
+		throughput(runner, "QuatX4::qNlerp<SlerpCorrected>", data.outP, [&](size_t i) { return pa[i].qNlerp<true>(pb[i], _mm_set1_ps(data.fa[i])); });
+		throughput(runner, "QuatX4::load", data.outP, [&](size_t i) { return QuatX4::load(&data.qa[i * 4]); });
+	}
+
+	void matrixBenchmarks(Benchmark::Runner& runner)
+	{
+		const m128Matrix* ma = data.ma;
+		const m128Matrix* mb = data.mb;
+
+		latency(runner, "VxD::mMul", ma[0], [&](m128Matrix m, size_t i) { return VxD::mMul(m, mb[i]); });
+		throughput(runner, "VxD::mMul", data.outM, [&](size_t i) { return VxD::mMul(ma[i], mb[i]); });
+		latency(runner, "VxD::mTransformPoint", data.va[0], [&](V4D v, size_t i) { return VxD::mTransformPoint(ma[i], v); });
+		throughput(runner, "VxD::mTransformPoint", data.outV, [&](size_t i) { return VxD::mTransformPoint(ma[i], data.va[i]); });
+		throughput(runner, "VxD::mTranspose", data.outM, [&](size_t i) { return VxD::mTranspose(ma[i]); });
+		throughput(runner, "VxD::mInverseAffine", data.outM, [&](size_t i) { return VxD::mInverseAffine(ma[i]); });
+		throughput(runner, "VxD::mFromTransform", data.outM, [&](size_t i) { return VxD::mFromTransform(data.qa[i], data.va[i], data.vb[i]); });
+	}
+
+	// The batch kernels, at every tier the CPU supports.
+	void kernelBenchmarks(Benchmark::Runner& runner)
+	{
+		static const char* tierNames[] = { "SSE2", "SSE41", "AVX2", "AVX512" };
+
+		V4D* pointers[count];
+		for (size_t i = 0; i < count; i++) pointers[i] = &data.outV[i];
+
+		for (const CPUFeatures::Tier tier : { CPUFeatures::Tier::SSE2, CPUFeatures::Tier::AVX2 }) {
+			if (CPUFeatures::force(tier) != tier) continue;
+			const std::string suffix = std::string("[") + tierNames[static_cast<int>(tier)] + "]";
+
+			runner.run("Kernels::qNormalize" + suffix, count, [&](const size_t iterations) {
+				for (size_t k = 0; k < iterations; k++) {
+					std::copy(data.va, data.va + count, data.outV);
+					VxD::Kernels::qNormalize(pointers, count);
+					Benchmark::clobber(data.outV);
+				}
+			});
+
+			runner.run("Kernels::qNlerpIdentity" + suffix, count, [&](const size_t iterations) {
+				for (size_t k = 0; k < iterations; k++) {
+					std::copy(data.qa, data.qa + count, data.outV);
+					VxD::Kernels::qNlerpIdentity(data.outV, data.weights, count, sizeof(V4D));
+					Benchmark::clobber(data.outV);
+				}
+			});
+		}
+		CPUFeatures::initialize();
+
+		float q[4][count], pos[3][count], scale[3][count];
+		for (size_t i = 0; i < count; i++) {
+			for (int c = 0; c < 4; c++) q[c][i] = data.qa[i][c];
+			for (int c = 0; c < 3; c++) pos[c][i] = data.va[i][c], scale[c][i] = 1.0f;
+		}
+		const float* qs[4] = { q[0], q[1], q[2], q[3] };
+		const float* positions[3] = { pos[0], pos[1], pos[2] };
+		const float* scales[3] = { scale[0], scale[1], scale[2] };
+		runner.run("VxD::mFromTransforms", count, [&](const size_t iterations) {
+			for (size_t k = 0; k < iterations; k++) {
+				Benchmark::clobber(q);
+				VxD::mFromTransforms(qs, positions, scales, data.outM, count);
+				Benchmark::clobber(data.outM);
+			}
+		});
+	}
+}
+
+int main(int argc, char** argv)
+{
+	CPUFeatures::initialize();
+	fill();
+
+	Benchmark::Runner runner(argc, argv);
+	vectorBenchmarks(runner);
+	quaternionBenchmarks(runner);
+	approxBenchmarks(runner);
+	packetBenchmarks(runner);
+	matrixBenchmarks(runner);
+	kernelBenchmarks(runner);
+	return runner.finish();
+}
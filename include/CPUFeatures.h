@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// Marks a function as using SSE4.1 (and SSSE3) or AVX2 instructions, so that it can be compiled without enabling them for the whole project.
+// FMA is left disabled, so that the compiler does not contract multiplies and adds and every tier gives bitwise identical results.
+// MSVC allows any intrinsics in any function.
+#if defined(_MSC_VER)
+#define CPUFEATURES_TARGET_SSE41
+#define CPUFEATURES_TARGET_AVX2
+#else
+#define CPUFEATURES_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define CPUFEATURES_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Runtime CPU feature detection and kernel dispatch.
+// The library itself only requires SSE2, wider implementations of hot kernels are selected at runtime
+// by the highest instruction set tier supported by both the CPU and the OS. SkeletonMan::initialize detects it once.
+namespace CPUFeatures {
+	enum class Tier : int {
+		SSE2 = 0,
+		SSE41 = 1,
+		AVX2 = 2,
+		AVX512 = 3
+	};
+
+	inline Tier detect();
+
+	namespace Impl {
+		inline void cpuid(int info[4], const int leaf, const int subleaf = 0)
+		{
+#if defined(_MSC_VER)
+			__cpuidex(info, leaf, subleaf);
+#else
+			__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+		}
+
+		// The register state the OS saves on context switches, AVX is unusable without it.
+		inline uint64_t xgetbv()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			uint32_t eax, edx;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return static_cast<uint64_t>(edx) << 32 | eax;
+#endif
+		}
+
+		inline Tier& active()
+		{
+			static Tier tier = Tier::SSE2;
+			return tier;
+		}
+
+		inline Tier detected()
+		{
+			static const Tier tier = CPUFeatures::detect();
+			return tier;
+		}
+	}
+
+	// Queries the CPU for the highest tier it and the OS support. Does not change the active tier.
+	inline Tier detect()
+	{
+		int info[4] = {};
+		Impl::cpuid(info, 0);
+		const int maxLeaf = info[0];
+
+		Impl::cpuid(info, 1);
+		const bool sse41 = info[2] & (1 << 19);
+		const bool osxsave = info[2] & (1 << 27);
+		const bool avx = info[2] & (1 << 28);
+		const bool fma = info[2] & (1 << 12);
+		if (!sse41) return Tier::SSE2;
+
+		// XMM and YMM state, then opmask and ZMM state
+		const uint64_t xcr0 = osxsave ? Impl::xgetbv() : 0;
+		const bool osAVX = (xcr0 & 0x6) == 0x6;
+		const bool osAVX512 = (xcr0 & 0xE6) == 0xE6;
+		if (!avx || !fma || !osAVX || maxLeaf < 7) return Tier::SSE41;
+
+		Impl::cpuid(info, 7);
+		const bool avx2 = info[1] & (1 << 5);
+		const bool avx512f = info[1] & (1 << 16);
+		const bool avx512bw = info[1] & (1 << 30);
+		if (!avx2) return Tier::SSE41;
+		if (!avx512f || !avx512bw || !osAVX512) return Tier::AVX2;
+
+		return Tier::AVX512;
+	}
+
+	// Detects the supported tier and makes it active. Called by SkeletonMan::initialize.
+	inline Tier initialize()
+	{
+		Impl::active() = Impl::detected();
+		return Impl::active();
+	}
+
+	// The tier kernels are currently dispatched for.
+	inline Tier get()
+	{
+		return Impl::active();
+	}
+
+	inline bool supports(const Tier tier)
+	{
+		return static_cast<int>(tier) <= static_cast<int>(Impl::active());
+	}
+
+	// Forces a lower tier, for example to compare results between implementations.
+	// Tiers above the one supported by the CPU can not be forced, the supported tier is used instead. Returns the active tier.
+	inline Tier force(const Tier tier)
+	{
+		Impl::active() = static_cast<int>(tier) < static_cast<int>(Impl::detected()) ? tier : Impl::detected();
+		return Impl::active();
+	}
+
+	// A kernel with one implementation per tier, called through the best implementation for the active tier.
+	// Only the SSE2 implementation is required, missing implementations fall back to the next lower tier.
+	template <typename Fn> class Kernel {
+	public:
+		constexpr Kernel(Fn* sse2, Fn* sse41 = nullptr, Fn* avx2 = nullptr, Fn* avx512 = nullptr) : impl{ sse2, sse41, avx2, avx512 } {}
+
+		Fn* get() const
+		{
+			for (int tier = static_cast<int>(CPUFeatures::get()); tier > 0; tier--) {
+				if (!!this->impl[tier]) return this->impl[tier];
+			}
+			return this->impl[0];
+		}
+
+		template <typename... Args> auto operator () (Args&&... args) const
+		{
+			return this->get()(std::forward<Args>(args)...);
+		}
+
+	private:
+		Fn* impl[4];
+	};
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <atomic>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <stdio.h>
+#endif
+
+/// <summary>
+/// A table of the readable memory ranges of the process, for validating pointers without a system call per check.
+/// Ranges come from a pluggable source (VirtualQuery on Windows, /proc/self/maps on Linux) and are stored merged and sorted,
+/// in Eytzinger (breadth first) order so that lookups are a short, branchless and cache friendly binary search.
+/// </summary>
+namespace MemoryRanges {
+	// A half-open range of addresses, [begin, end).
+	struct Range {
+		uintptr_t begin;
+		uintptr_t end;
+	};
+
+	// A source of readable memory ranges.
+	class Source {
+	public:
+		virtual ~Source() {}
+
+		// Appends all readable ranges of the process to the vector, in any order.
+		virtual bool enumerate(std::vector<Range>& ranges) = 0;
+
+		// Finds the readable range that contains an address, for incremental updates.
+		// The default implementation enumerates all ranges, sources should override it with something cheaper if they can.
+		virtual bool query(const uintptr_t address, Range& range)
+		{
+			std::vector<Range> ranges;
+			if (!this->enumerate(ranges)) return false;
+
+			for (const Range& r : ranges) {
+				if (r.begin <= address && address < r.end) {
+					range = r;
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+#if defined(_WIN32)
+	// Reads committed, readable and non-guard regions with VirtualQuery.
+	class VirtualQuerySource : public Source {
+	public:
+		virtual bool enumerate(std::vector<Range>& ranges)
+		{
+			SYSTEM_INFO systemInfo;
+			GetSystemInfo(&systemInfo);
+
+			uintptr_t address = reinterpret_cast<uintptr_t>(systemInfo.lpMinimumApplicationAddress);
+			const uintptr_t maxAddress = reinterpret_cast<uintptr_t>(systemInfo.lpMaximumApplicationAddress);
+
+			MEMORY_BASIC_INFORMATION mbi;
+			while (address < maxAddress && VirtualQuery(reinterpret_cast<LPCVOID>(address), &mbi, sizeof(mbi)) == sizeof(mbi)) {
+				const uintptr_t begin = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+				if (isReadable(mbi)) ranges.push_back({ begin, begin + mbi.RegionSize });
+				address = begin + mbi.RegionSize;
+			}
+
+			return true;
+		}
+
+		virtual bool query(const uintptr_t address, Range& range)
+		{
+			MEMORY_BASIC_INFORMATION mbi;
+			if (VirtualQuery(reinterpret_cast<LPCVOID>(address), &mbi, sizeof(mbi)) != sizeof(mbi) || !isReadable(mbi)) return false;
+
+			range.begin = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+			range.end = range.begin + mbi.RegionSize;
+			return true;
+		}
+
+	private:
+		static bool isReadable(const MEMORY_BASIC_INFORMATION& mbi)
+		{
+			constexpr DWORD readable = PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+			return mbi.State == MEM_COMMIT && (mbi.Protect & readable) && !(mbi.Protect & (PAGE_GUARD | PAGE_NOACCESS));
+		}
+	};
+#endif
+
+#if defined(__linux__)
+	// Reads the readable mappings of /proc/self/maps.
+	class ProcMapsSource : public Source {
+	public:
+		virtual bool enumerate(std::vector<Range>& ranges)
+		{
+			FILE* maps = fopen("/proc/self/maps", "r");
+			if (!maps) return false;
+
+			char line[512];
+			while (fgets(line, sizeof(line), maps)) {
+				unsigned long long begin, end;
+				char perms[5] = {};
+				if (sscanf(line, "%llx-%llx %4s", &begin, &end, perms) == 3 && perms[0] == 'r') {
+					ranges.push_back({ static_cast<uintptr_t>(begin), static_cast<uintptr_t>(end) });
+				}
+			}
+
+			fclose(maps);
+			return true;
+		}
+	};
+#endif
+
+	// The platform's default source, or nullptr if there is none.
+	inline std::unique_ptr<Source> makeDefaultSource()
+	{
+#if defined(_WIN32)
+		return std::make_unique<VirtualQuerySource>();
+#elif defined(__linux__)
+		return std::make_unique<ProcMapsSource>();
+#else
+		return nullptr;
+#endif
+	}
+
+	// Not thread safe: lookups remember the last range hit, use one table per thread or synchronize access.
+	class Table {
+	public:
+		Table(std::unique_ptr<Source> source) : source(std::move(source)) {}
+
+		// Rebuilds the table from all ranges of the source.
+		bool refresh()
+		{
+			this->stale = false;
+			this->generation++;
+			if (!this->source) return false;
+
+			std::vector<Range> ranges;
+			if (!this->source->enumerate(ranges)) return false;
+
+			std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+			this->ranges = std::move(ranges);
+			this->pending.clear();
+			this->build();
+			return true;
+		}
+
+		// Marks the table as stale after ranges may have been freed, like when a character or an area is unloaded.
+		// Cheap enough to call from unload paths: the table is refreshed once, by the next MemoryRanges::isReadable.
+		void invalidate()
+		{
+			this->stale = true;
+			this->generation++;
+		}
+
+		bool isStale() const { return this->stale; }
+
+		// Adds the range that contains an address, if it is readable. Cheaper than a full refresh when only a few ranges are new:
+		// the range is inserted into a short sorted list, which is folded into the Eytzinger layout only once it is full.
+		bool update(const uintptr_t address)
+		{
+			Range range;
+			if (!this->source || !this->source->query(address, range)) return false;
+
+			auto& pending = this->pending;
+			pending.insert(std::upper_bound(pending.begin(), pending.end(), range, [](const Range& a, const Range& b) { return a.begin < b.begin; }), range);
+			if (pending.size() >= maxPending) this->fold();
+
+			// the new range may contain addresses that were cached as misses
+			this->generation++;
+			return true;
+		}
+
+		// Whether size bytes starting at address are all readable, according to the table.
+		bool contains(const uintptr_t address, const size_t size = 1) const
+		{
+			// consecutive lookups mostly land in the same range (the same heap), try it first
+			if (covers(this->lastHit, address, size)) return true;
+
+			const size_t count = this->eytzinger.size() - 1;
+
+			// find the first range that ends after the address, the ranges are disjoint so their ends are sorted too
+			size_t k = 1;
+			while (k <= count) {
+				k = 2 * k + (this->eytzinger[k].end <= address);
+			}
+			k >>= countTrailingZeros(~k) + 1;
+
+			if (k != 0 && covers(this->eytzinger[k], address, size)) {
+				this->lastHit = this->eytzinger[k];
+				return true;
+			}
+
+			for (const Range& range : this->pending) {
+				if (covers(range, address, size)) {
+					this->lastHit = range;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Whether the page of an address was recently found unreadable by the source, see Table::addMiss.
+		bool isKnownMiss(const uintptr_t address) const
+		{
+			const uintptr_t page = address >> pageShift;
+			const Miss& miss = this->misses[page % missCount];
+			return miss.page == page && miss.generation == this->generation && Clock::now() < miss.expiry;
+		}
+
+		// Remembers that the page of an address is unreadable, so repeated checks of a garbage pointer do not query the source every time.
+		// Misses are forgotten when the table changes, and after missLifetime in case the page was allocated since.
+		void addMiss(const uintptr_t address)
+		{
+			const uintptr_t page = address >> pageShift;
+			this->misses[page % missCount] = { page, this->generation, Clock::now() + missLifetime };
+		}
+
+		size_t size() const { return this->eytzinger.size() - 1 + this->pending.size(); }
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct Miss {
+			uintptr_t page;
+			uint64_t generation;
+			Clock::time_point expiry;
+		};
+
+		static constexpr size_t maxPending = 16;
+		static constexpr size_t missCount = 64;
+		static constexpr int pageShift = 12;
+		static constexpr auto missLifetime = std::chrono::milliseconds(100);
+
+		std::unique_ptr<Source> source;
+		// Sorted by begin and merged.
+		std::vector<Range> ranges = {};
+		// Index 0 is unused, the children of node k are 2k and 2k + 1.
+		std::vector<Range> eytzinger = { Range{} };
+		// Ranges added by Table::update since the last build, sorted by begin.
+		std::vector<Range> pending = {};
+		mutable Range lastHit = {};
+		Miss misses[missCount] = {};
+		// Incremented on every change of the table, invalidating the cached misses.
+		uint64_t generation = 1;
+		bool stale = false;
+
+		static bool covers(const Range& range, const uintptr_t address, const size_t size)
+		{
+			return range.begin <= address && address < range.end && size <= range.end - address;
+		}
+
+		static int countTrailingZeros(const size_t x)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward64(&index, x);
+			return static_cast<int>(index);
+#else
+			return __builtin_ctzll(x);
+#endif
+		}
+
+		// Merges the pending ranges into the sorted ones, both are sorted so no re-sort is needed.
+		void fold()
+		{
+			std::vector<Range> ranges;
+			ranges.reserve(this->ranges.size() + this->pending.size());
+			std::merge(this->ranges.begin(), this->ranges.end(), this->pending.begin(), this->pending.end(), std::back_inserter(ranges),
+				[](const Range& a, const Range& b) { return a.begin < b.begin; });
+
+			this->ranges = std::move(ranges);
+			this->pending.clear();
+			this->build();
+		}
+
+		// Merges the sorted ranges, then lays them out in Eytzinger order.
+		void build()
+		{
+			auto& ranges = this->ranges;
+
+			size_t merged = 0;
+			for (size_t i = 0; i < ranges.size(); i++) {
+				if (ranges[i].begin >= ranges[i].end) continue;
+				if (merged > 0 && ranges[i].begin <= ranges[merged - 1].end) {
+					ranges[merged - 1].end = (std::max)(ranges[merged - 1].end, ranges[i].end);
+				}
+				else {
+					ranges[merged++] = ranges[i];
+				}
+			}
+			ranges.resize(merged);
+
+			this->eytzinger.assign(merged + 1, Range{});
+			this->lastHit = {};
+			size_t i = 0;
+			this->layout(i, 1);
+		}
+
+		void layout(size_t& i, const size_t k)
+		{
+			if (k >= this->eytzinger.size()) return;
+			this->layout(i, 2 * k);
+			this->eytzinger[k] = this->ranges[i++];
+			this->layout(i, 2 * k + 1);
+		}
+	};
+
+	namespace Impl {
+		// Incremented by MemoryRanges::invalidate, every thread's table compares it with the last value it has seen.
+		inline std::atomic<uint64_t>& epoch()
+		{
+			static std::atomic<uint64_t> epoch(0);
+			return epoch;
+		}
+	}
+
+	// The table used by range safe pointer chains (PointerChain::Safety::Range), using the platform's default source.
+	// Every thread has its own table, since lookups modify it: the hooks and PointerChain::resolveBatch may run on different threads.
+	// It is filled on first use, see MemoryRanges::isReadable.
+	inline Table& global()
+	{
+		thread_local Table table(makeDefaultSource());
+		return table;
+	}
+
+	// Whether size bytes starting at address are readable. Addresses missing from the global table are looked up once
+	// with the source and added, so new allocations are picked up incrementally; unreadable ones are cached for a while.
+	// A table invalidated by MemoryRanges::invalidate, on any thread, is refreshed first, so ranges freed since are not trusted.
+	inline bool isReadable(const void* address, const size_t size = 1)
+	{
+		Table& table = global();
+		const uintptr_t begin = reinterpret_cast<uintptr_t>(address);
+
+		thread_local uint64_t seenEpoch = 0;
+		const uint64_t epoch = Impl::epoch().load(std::memory_order_acquire);
+		if (seenEpoch != epoch) {
+			seenEpoch = epoch;
+			table.invalidate();
+		}
+
+		if (table.isStale()) table.refresh();
+		if (table.contains(begin, size)) return true;
+		if (table.size() == 0 && table.refresh() && table.contains(begin, size)) return true;
+		if (table.isKnownMiss(begin)) return false;
+		if (table.update(begin)) return table.contains(begin, size);
+
+		table.addMiss(begin);
+		return false;
+	}
+
+	// Invalidates the global tables of all threads, call after memory may have been freed (character and area unloads).
+	// Each thread refreshes its table on its next MemoryRanges::isReadable.
+	inline void invalidate()
+	{
+		Impl::epoch().fetch_add(1, std::memory_order_release);
+	}
+}
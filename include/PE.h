@@ -1,15 +1,20 @@
 #pragma once
 
+#if defined(_WIN32)
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <DbgHelp.h>
 #pragma comment(lib, "DbgHelp")
 #include <Psapi.h>
+#else
+#include "WinCompat.h"
+#endif
 
 #include <memory>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
 #include <unordered_map>
 
@@ -155,6 +160,65 @@ public:
 
 	typedef std::vector<std::unique_ptr<PEParser::Section>> PESections;
 
+	// The absolute address ranges of all sections with the same name, sorted and with adjacent sections merged.
+	// Built by PEParser::parse, so that membership checks need neither the process information nor a loop over the sections.
+	class SectionRanges {
+	public:
+		struct Range {
+			uintptr_t start;
+			uintptr_t end;
+		};
+
+		SectionRanges(PESections& sections, unsigned char* base) : base(reinterpret_cast<uintptr_t>(base))
+		{
+			for (auto& section : sections) {
+				this->ranges.push_back({ section->start.as<uintptr_t>(base), section->end.as<uintptr_t>(base) });
+			}
+
+			std::sort(this->ranges.begin(), this->ranges.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+
+			size_t merged = 0;
+			for (size_t i = 1; i < this->ranges.size(); i++) {
+				if (this->ranges[i].start <= this->ranges[merged].end) {
+					this->ranges[merged].end = (std::max)(this->ranges[merged].end, this->ranges[i].end);
+				}
+				else {
+					this->ranges[++merged] = this->ranges[i];
+				}
+			}
+			this->ranges.resize(this->ranges.empty() ? 0 : merged + 1);
+
+			if (this->ranges.size() == 1) {
+				this->singleStart = this->ranges[0].start;
+				this->singleSize = this->ranges[0].end - this->ranges[0].start;
+			}
+		}
+
+		// Whether an address is inside any of the sections.
+		// With a single range, a wrapping subtraction makes this one compare and no branches.
+		bool contains(const uintptr_t address) const
+		{
+			if (this->ranges.size() == 1) return address - this->singleStart < this->singleSize;
+
+			// the last range starting at or before the address
+			auto iter = std::upper_bound(this->ranges.begin(), this->ranges.end(), address, [](uintptr_t address, const Range& range) { return address < range.start; });
+			return iter != this->ranges.begin() && address < (iter - 1)->end;
+		}
+
+		template <typename T> bool contains(T* address) const { return this->contains(reinterpret_cast<uintptr_t>(address)); }
+
+		// Whether an integer base offset is inside any of the sections.
+		bool contains(ibo32 ibo) const { return this->contains(this->base + static_cast<intptr_t>(ibo.as())); }
+
+		const std::vector<Range>& getRanges() const { return this->ranges; }
+
+	private:
+		uintptr_t base;
+		uintptr_t singleStart = 0;
+		uintptr_t singleSize = 0;
+		std::vector<Range> ranges;
+	};
+
 	class SectionMap {
 	public:
 		// internal function, refer to PEParser::getSectionsWithName
@@ -170,6 +234,22 @@ public:
 			}
 		}
 
+		// internal function, refer to PEParser::getSectionRanges
+		const SectionRanges* getSectionRanges(const std::string& name)
+		{
+			auto iter = this->rangeMap.find(name);
+			return iter != this->rangeMap.end() ? &iter->second : nullptr;
+		}
+
+		// Internal function. Builds the flat section ranges, after all sections have been added.
+		void buildRanges(unsigned char* base)
+		{
+			this->rangeMap.clear();
+			for (auto& [name, sections] : this->sectionMap) {
+				this->rangeMap.emplace(name, SectionRanges(sections, base));
+			}
+		}
+
 		/// <summary>
 		/// Internal function. Adds a section to the section map.
 		/// </summary>
@@ -196,6 +276,7 @@ public:
 
 	private:
 		std::unordered_map<std::string, std::vector<std::unique_ptr<Section>>> sectionMap;
+		std::unordered_map<std::string, SectionRanges> rangeMap;
 	};
 
 	/// <summary>
@@ -220,6 +301,7 @@ public:
 	{
 		// the ProcessInfo struct is necessary to get the base address of the executable
 		PEParser::setProcessInfo(pInfo);
+		if (!PEParser::pInfo) return false;
 
 		unsigned char* base = reinterpret_cast<unsigned char*>(PEParser::pInfo->mInfo->lpBaseOfDll);
 		if (!base || *reinterpret_cast<short*>(base) != 0x5A4D) return false; // executable image magic number
@@ -227,6 +309,7 @@ public:
 		base += *reinterpret_cast<int*>(base + 0x3C);
 		if (*reinterpret_cast<int*>(base) != 0x4550) return false; // PE header magic number
 
+		unsigned char* imageBase = reinterpret_cast<unsigned char*>(PEParser::pInfo->mInfo->lpBaseOfDll);
 		const short sectionCount = *reinterpret_cast<short*>(base + 0x06);
 
 		base += *reinterpret_cast<short*>(base + 0x14) + 0x18; // add COFF and optional header sizes
@@ -246,6 +329,47 @@ public:
 			base += 0x28; // size of a section header
 		}
 
+		PEParser::sectionMap->buildRanges(imageBase);
+
+		return true;
+	}
+
+	// Identifies an executable image, so that data derived from it can be cached between launches.
+	struct ImageIdentity {
+		unsigned int timestamp;
+		unsigned int sizeOfImage;
+		unsigned long long sectionHash;
+
+		bool operator == (const ImageIdentity& other) const { return this->timestamp == other.timestamp && this->sizeOfImage == other.sizeOfImage && this->sectionHash == other.sectionHash; }
+		bool operator != (const ImageIdentity& other) const { return !(*this == other); }
+	};
+
+	/// <summary>
+	/// Static. Reads the identity of the image described by the process information: its PE timestamp, SizeOfImage and an FNV-1a hash of its section headers.
+	/// </summary>
+	/// <param name="identity">: the identity to fill out</param>
+	/// <returns>true on success, false if ProcessInfo is missing or the PE headers do not match those of an executable image</returns>
+	static bool getImageIdentity(ImageIdentity& identity)
+	{
+		if (!PEParser::pInfo) return false;
+
+		unsigned char* base = reinterpret_cast<unsigned char*>(PEParser::pInfo->mInfo->lpBaseOfDll);
+		if (!base || *reinterpret_cast<short*>(base) != 0x5A4D) return false; // executable image magic number
+
+		base += *reinterpret_cast<int*>(base + 0x3C);
+		if (*reinterpret_cast<int*>(base) != 0x4550) return false; // PE header magic number
+
+		const short sectionCount = *reinterpret_cast<short*>(base + 0x06);
+		identity.timestamp = *reinterpret_cast<unsigned int*>(base + 0x08);
+		identity.sizeOfImage = *reinterpret_cast<unsigned int*>(base + 0x18 + 0x38); // optional header, same offset in PE32 and PE32+
+
+		const unsigned char* sectionHeaders = base + *reinterpret_cast<short*>(base + 0x14) + 0x18;
+		unsigned long long hash = 0xCBF29CE484222325ull;
+		for (int i = 0; i < sectionCount * 0x28; i++) {
+			hash = (hash ^ sectionHeaders[i]) * 0x100000001B3ull;
+		}
+		identity.sectionHash = hash;
+
 		return true;
 	}
 
@@ -261,6 +385,18 @@ public:
 		return PEParser::sectionMap->getSectionsWithName(name);
 	}
 
+	/// <summary>
+	/// Retrieve the flat address ranges of the sections with a matching name, for fast membership checks. See PEParser::SectionRanges.
+	/// </summary>
+	/// <param name="name">: sections to match</param>
+	/// <returns>a pointer to the ranges of the sections with a matching name; if PEParser::parse had not been called or the section is missing, nullptr</returns>
+	const SectionRanges* getSectionRanges(const std::string& name)
+	{
+		if (!PEParser::sectionMap) return nullptr;
+
+		return PEParser::sectionMap->getSectionRanges(name);
+	}
+
 	/// <summary>
 	/// Static. Checks if a given address is inside any of the given sections.  
 	/// </summary>
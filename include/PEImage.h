@@ -0,0 +1,208 @@
+#pragma once
+
+#include "PE.h"
+
+#include <new>
+#include <memory>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+
+/// <summary>
+/// A PE image loaded from a file instead of the current process, so that PEParser, RTTIScanner and other scanners can run offline,
+/// e.g. in tests and benchmarks or on other platforms. The file is mapped and its sections are placed at their virtual addresses
+/// in a new allocation, then the image is relocated to that allocation, like the loader would do.
+/// Nothing is executed or imported. Pass PEImage::makeProcessInfo to a parser or scanner to use the image.
+/// </summary>
+class PEImage {
+public:
+	enum class Layout {
+		File, // an executable or DLL as stored on disk, with sections at their file offsets
+		Image // a dump of a loaded module, with sections already at their virtual addresses
+	};
+
+	/// <summary>
+	/// Loads a PE image from a file. Throws if the file can not be read or is not a valid PE image.
+	/// </summary>
+	/// <param name="path">: path to the file</param>
+	/// <param name="layout">: (optional) the layout of the file, PEImage::Layout::File by default</param>
+	/// <param name="dumpBase">: (optional) the address a Layout::Image dump was loaded at, if its headers do not say.
+	/// Only needed if the dump's relocations were applied for another base than the ImageBase in its headers</param>
+	PEImage(const char* path, Layout layout = Layout::File, uintptr_t dumpBase = 0)
+	{
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Unable to open image file.");
+
+		LARGE_INTEGER fileSize = {};
+		HANDLE mapping = nullptr;
+		const unsigned char* view = nullptr;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!!mapping) view = reinterpret_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+
+		const char* error = !view ? "Unable to map image file." : this->load(view, static_cast<size_t>(fileSize.QuadPart), layout, dumpBase);
+
+		if (!!view) UnmapViewOfFile(view);
+		if (!!mapping) CloseHandle(mapping);
+		CloseHandle(file);
+
+		if (!!error) throw std::runtime_error(error);
+	}
+
+	PEImage(const PEImage&) = delete;
+	PEImage& operator = (const PEImage&) = delete;
+
+	/// <summary>
+	/// Creates process information describing the loaded image, for PEParser::parse, RTTIScanner::scan etc.
+	/// Ownership of the returned struct is transferred to the parser it is passed to. The image must outlive any use of it.
+	/// </summary>
+	/// <returns>a pointer to a new PEParser::ProcessInfo struct</returns>
+	PEParser::ProcessInfo* makeProcessInfo() const
+	{
+		auto pInfo = new PEParser::ProcessInfo();
+
+		pInfo->hProcess = nullptr;
+		pInfo->hProcessModule = reinterpret_cast<HMODULE>(this->image.get());
+		pInfo->mInfo = std::make_unique<MODULEINFO>();
+		pInfo->mInfo->lpBaseOfDll = this->image.get();
+		pInfo->mInfo->SizeOfImage = static_cast<DWORD>(this->size);
+		pInfo->mInfo->EntryPoint = this->image.get() + this->entryPoint;
+
+		return pInfo;
+	}
+
+	unsigned char* getBase() const { return this->image.get(); }
+	size_t getSize() const { return this->size; }
+
+private:
+	struct AlignedDelete {
+		void operator () (unsigned char* p) const { ::operator delete(p, std::align_val_t(alignment)); }
+	};
+
+	// Images are allocated page aligned, so that page boundaries within the image are where they would be in a process.
+	static constexpr size_t alignment = 4096;
+
+	std::unique_ptr<unsigned char, AlignedDelete> image{};
+	size_t size = 0;
+	unsigned int entryPoint = 0;
+
+	template <typename T> static bool read(const unsigned char* data, const size_t dataSize, const size_t offset, T& value)
+	{
+		if (offset > dataSize || dataSize - offset < sizeof(T)) return false;
+
+		memcpy(&value, data + offset, sizeof(T));
+		return true;
+	}
+
+	// Places the headers and sections and applies relocations. Returns an error message, or nullptr on success.
+	const char* load(const unsigned char* data, const size_t dataSize, const Layout layout, const uintptr_t dumpBase)
+	{
+		unsigned short magic = 0;
+		unsigned int peOffset = 0, peMagic = 0;
+		if (!read(data, dataSize, 0, magic) || magic != 0x5A4D) return "Not an executable image."; // executable image magic number
+		if (!read(data, dataSize, 0x3C, peOffset) || !read(data, dataSize, peOffset, peMagic) || peMagic != 0x4550) return "Missing PE header."; // PE header magic number
+
+		const size_t optionalHeader = peOffset + 0x18;
+		unsigned short sectionCount = 0, optionalHeaderSize = 0, optionalMagic = 0;
+		unsigned int sizeOfImage = 0, sizeOfHeaders = 0;
+		if (!read(data, dataSize, peOffset + 0x06, sectionCount) || !read(data, dataSize, peOffset + 0x14, optionalHeaderSize)
+			|| !read(data, dataSize, optionalHeader, optionalMagic) || !read(data, dataSize, optionalHeader + 0x10, this->entryPoint)
+			|| !read(data, dataSize, optionalHeader + 0x38, sizeOfImage) || !read(data, dataSize, optionalHeader + 0x3C, sizeOfHeaders)) return "Truncated PE header.";
+
+		// PE32+ has a 64 bit ImageBase, which moves the data directories
+		const bool pe32Plus = optionalMagic == 0x20B;
+		if (!pe32Plus && optionalMagic != 0x10B) return "Unknown optional header format.";
+
+		unsigned long long imageBase = 0;
+		if (pe32Plus) {
+			if (!read(data, dataSize, optionalHeader + 0x18, imageBase)) return "Truncated PE header.";
+		}
+		else {
+			unsigned int imageBase32 = 0;
+			if (!read(data, dataSize, optionalHeader + 0x1C, imageBase32)) return "Truncated PE header.";
+			imageBase = imageBase32;
+		}
+
+		if (!sizeOfImage) return "Empty image.";
+
+		// the whole allocation is cleared, a SizeOfImage that is not a multiple of the section alignment would leave its tail uninitialized
+		const size_t allocationSize = (static_cast<size_t>(sizeOfImage) + alignment - 1) & ~(alignment - 1);
+		this->size = sizeOfImage;
+		this->image.reset(static_cast<unsigned char*>(::operator new(allocationSize, std::align_val_t(alignment))));
+		memset(this->image.get(), 0, allocationSize);
+
+		if (layout == Layout::Image) {
+			memcpy(this->image.get(), data, std::min<size_t>(dataSize, sizeOfImage));
+		}
+		else {
+			memcpy(this->image.get(), data, std::min<size_t>({ dataSize, sizeOfHeaders, sizeOfImage }));
+
+			const size_t sectionHeaders = optionalHeader + optionalHeaderSize;
+			for (size_t i = 0; i < sectionCount; i++) {
+				const size_t header = sectionHeaders + i * 0x28; // size of a section header
+				unsigned int virtualSize = 0, virtualAddress = 0, rawSize = 0, rawOffset = 0;
+				if (!read(data, dataSize, header + 0x08, virtualSize) || !read(data, dataSize, header + 0x0C, virtualAddress)
+					|| !read(data, dataSize, header + 0x10, rawSize) || !read(data, dataSize, header + 0x14, rawOffset)) return "Truncated section headers.";
+
+				// the raw data is padded to the file alignment, the rest of the virtual size is zero filled
+				if (virtualAddress >= sizeOfImage || rawOffset >= dataSize) continue;
+				const size_t copySize = std::min<size_t>({ rawSize, virtualSize ? virtualSize : rawSize, sizeOfImage - virtualAddress, dataSize - rawOffset });
+				memcpy(this->image.get() + virtualAddress, data + rawOffset, copySize);
+			}
+		}
+
+		// a dump was relocated to the address it was loaded at, which the loader writes to its ImageBase
+		const uintptr_t loadedBase = layout == Layout::Image && !!dumpBase ? dumpBase : static_cast<uintptr_t>(imageBase);
+		return this->relocate(optionalHeader + (pe32Plus ? 0x70 : 0x60), static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(this->image.get()) - loadedBase));
+	}
+
+	// Applies the base relocation table, which the image now has at its virtual address, for a move by delta bytes.
+	const char* relocate(const size_t dataDirectories, const unsigned long long delta)
+	{
+		unsigned char* base = this->image.get();
+		unsigned int directoryAddress = 0, directorySize = 0;
+		if (!read(base, this->size, dataDirectories + 5 * 8, directoryAddress) || !read(base, this->size, dataDirectories + 5 * 8 + 4, directorySize)) return nullptr; // no relocations
+		if (!delta || !directoryAddress || !directorySize) return nullptr;
+		if (directoryAddress >= this->size || this->size - directoryAddress < directorySize) return "Relocation table outside of the image.";
+
+		// blocks of 16 bit entries for one 4KB page each: 4 bits of type, 12 bits of offset
+		for (size_t block = directoryAddress; block + 8 <= directoryAddress + directorySize;) {
+			unsigned int page = 0, blockSize = 0;
+			read(base, this->size, block, page);
+			read(base, this->size, block + 4, blockSize);
+			if (blockSize < 8 || block + blockSize > directoryAddress + directorySize) return "Invalid relocation block.";
+
+			for (size_t entry = block + 8; entry + 2 <= block + blockSize; entry += 2) {
+				unsigned short value = 0;
+				read(base, this->size, entry, value);
+				const size_t target = static_cast<size_t>(page) + (value & 0xFFF);
+
+				switch (value >> 12) {
+				case 0: // IMAGE_REL_BASED_ABSOLUTE, padding
+					break;
+				case 3: { // IMAGE_REL_BASED_HIGHLOW
+					unsigned int address = 0;
+					if (!read(base, this->size, target, address)) return "Relocation outside of the image.";
+					address += static_cast<unsigned int>(delta);
+					memcpy(base + target, &address, sizeof(address));
+					break;
+				}
+				case 10: { // IMAGE_REL_BASED_DIR64
+					unsigned long long address = 0;
+					if (!read(base, this->size, target, address)) return "Relocation outside of the image.";
+					address += delta;
+					memcpy(base + target, &address, sizeof(address));
+					break;
+				}
+				default:
+					return "Unsupported relocation type.";
+				}
+			}
+
+			block += blockSize;
+		}
+
+		return nullptr;
+	}
+};
@@ -2,18 +2,21 @@
 #define POINTERCHAIN_H
 
 #include <tuple>
+#include <utility>
+#include <algorithm>
 #include <stdint.h>
 #include <type_traits>
 
+#include "MemoryRanges.h"
+
 // https://meghprkh.github.io/blog/posts/c++-force-inline/
 // Local always inline macro.
 // Makes the compiler less likely to turn what should be a compile time calculation into a runtime function call.
 // (mostly applies to MSVC)
-#if defined(__clang__)
-#define POINTERCHAIN_FORCE_INLINE [[gnu::always_inline]] [[gnu::gnu_inline]] extern inline
-
-#elif defined(__GNUC__)
-#define POINTERCHAIN_FORCE_INLINE [[gnu::always_inline]] inline
+// GCC and Clang use the GNU attribute syntax, which unlike [[gnu::always_inline]] may follow other specifiers like constexpr,
+// and is allowed on class members (extern is not).
+#if defined(__clang__) || defined(__GNUC__)
+#define POINTERCHAIN_FORCE_INLINE __attribute__((always_inline)) inline
 
 #elif defined(_MSC_VER)
 #pragma warning(error: 4714)
@@ -29,11 +32,23 @@
 /// A chain with an invalid base or consisting of just a base is undefined.
 /// </summary>
 namespace PointerChain {
+	// How much a chain checks while traversing it, from cheapest to safest. Each level includes the checks of the ones before it.
+	// Null: every offset is treated as unsafe (unsigned), a nullptr check is performed before adding it.
+	// Range: every pointer read and the final pointer are also checked against MemoryRanges::global(), the calling thread's table, catching stale and garbage pointers.
+	// A chain that fails a check returns nullptr.
+	namespace Safety {
+		enum : int {
+			None = 0,
+			Null = 1,
+			Range = 2
+		};
+	}
+
 	// Implementation helpers for constructing and traversing pointer chains.
 	namespace Impl {
 		// Helper make functions, use PointerChain::make instead.
-		template <typename PointerType, bool null_safe, std::size_t extra_offset_count = 0, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto make(Tb&& base, Offsets&&... offsets) noexcept;
-		template <typename PointerType, bool null_safe, std::size_t extra_offset_count = 0, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto make(Tb&& base, std::tuple<Offsets...>) noexcept;
+		template <typename PointerType, int safety, std::size_t extra_offset_count = 0, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto make(Tb&& base, Offsets&&... offsets) noexcept;
+		template <typename PointerType, int safety, std::size_t extra_offset_count = 0, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto make(Tb&& base, std::tuple<Offsets...>) noexcept;
 
 		template <typename T> struct pointer_depth {
 			static constexpr std::size_t value = 0;
@@ -133,7 +148,7 @@ namespace PointerChain {
 	}
 
 	// Base PointerChain class
-	template <typename PointerType_, typename Tb_, bool null_safe_ = false, std::size_t extra_offset_count_ = 0, typename... Offsets_> class PtrChainBase {
+	template <typename PointerType_, typename Tb_, int safety_ = Safety::None, std::size_t extra_offset_count_ = 0, typename... Offsets_> class PtrChainBase {
 		static_assert(std::conjunction_v<std::is_integral<std::decay_t<Offsets_>>...>
 			|| std::disjunction_v<Impl::is_same_template_class<Impl::ref_offset_wrapper<>, std::decay_t<Offsets_>>...>,
 			"Offset type must explicitly be an integer type.");
@@ -152,7 +167,7 @@ namespace PointerChain {
 		// Create a chain with a new pointed to type.
 		template <typename TOther> POINTERCHAIN_FORCE_INLINE constexpr auto to()
 		{
-			return PtrChainBase<TOther, Tb_, null_safe_, extra_offset_count_, Offsets_...>(this->base, this->offsets);
+			return PtrChainBase<TOther, Tb_, safety_, extra_offset_count_, Offsets_...>(this->base, this->offsets);
 		}
 
 		// Traverse offsets up until and including N (default = all) and return a pointer from the last offset traversed.
@@ -164,7 +179,11 @@ namespace PointerChain {
 				return this->apply_(Impl::subtuple<0, extra_offset_count_ + N>(this->offsets));
 			}
 			else {
-				return reinterpret_cast<PointerType_*>(this->apply_(this->offsets));
+				PointerType_* result = reinterpret_cast<PointerType_*>(this->apply_(this->offsets));
+				if constexpr (safety_ >= Safety::Range && !std::is_void_v<PointerType_>) {
+					if (!!result && !MemoryRanges::isReadable(result, sizeof(PointerType_))) return static_cast<PointerType_*>(nullptr);
+				}
+				return result;
 			}
 		}
 
@@ -179,15 +198,15 @@ namespace PointerChain {
 				auto ref_wrapper = std::make_tuple(Impl::make_ref_offset_wrapper(std::get<lastIndex>(this->offsets), offset));
 				if constexpr (offsetNum > 1) {
 					auto t = std::tuple_cat(Impl::subtuple<0, lastIndex - 1>(this->offsets), ref_wrapper);
-					return Impl::make<PointerType_, null_safe_, extra_offset_count_, Tb_>(this->base, t);
+					return Impl::make<PointerType_, safety_, extra_offset_count_, Tb_>(this->base, t);
 				}
 				else {
-					return Impl::make<PointerType_, null_safe_, extra_offset_count_, Tb_>(this->base, ref_wrapper);
+					return Impl::make<PointerType_, safety_, extra_offset_count_, Tb_>(this->base, ref_wrapper);
 				}
 			}
 			else {
 				auto t = std::tuple_cat(Impl::subtuple<0, lastIndex - 1>(this->offsets), std::make_tuple(std::get<lastIndex>(this->offsets) + offset));
-				return Impl::make<PointerType_, null_safe_, extra_offset_count_, Tb_>(this->base, t);
+				return Impl::make<PointerType_, safety_, extra_offset_count_, Tb_>(this->base, t);
 			}
 		}
 
@@ -202,24 +221,28 @@ namespace PointerChain {
 				auto ref_wrapper = std::make_tuple(Impl::make_ref_offset_wrapper(std::get<lastIndex>(this->offsets), -offset));
 				if constexpr (offsetNum > 1) {
 					auto t = std::tuple_cat(Impl::subtuple<0, lastIndex - 1>(this->offsets), ref_wrapper);
-					return Impl::make<PointerType_, null_safe_, extra_offset_count_, Tb_>(this->base, t);
+					return Impl::make<PointerType_, safety_, extra_offset_count_, Tb_>(this->base, t);
 				}
 				else {
-					return Impl::make<PointerType_, null_safe_, extra_offset_count_, Tb_>(this->base, ref_wrapper);
+					return Impl::make<PointerType_, safety_, extra_offset_count_, Tb_>(this->base, ref_wrapper);
 				}
 			}
 			else {
 				auto t = std::tuple_cat(Impl::subtuple<0, lastIndex - 1>(this->offsets), std::make_tuple(std::get<lastIndex>(this->offsets) - offset));
-				return Impl::make<PointerType_, null_safe_, extra_offset_count_, Tb_>(this->base, t);
+				return Impl::make<PointerType_, safety_, extra_offset_count_, Tb_>(this->base, t);
 			}
 		}
 
 		POINTERCHAIN_FORCE_INLINE constexpr operator bool() noexcept
 		{
 			constexpr int64_t offsetIndex = Impl::pack_size_v<Offsets_...> -extra_offset_count_ - 2;
-			if constexpr (offsetIndex >= 0) {
+			if constexpr (safety_ >= Safety::Range) {
+				// a non-null pointer may still be stale, only a fully checked traversal tells
+				return !!this->get();
+			}
+			else if constexpr (offsetIndex >= 0) {
 				void** pResult = reinterpret_cast<void**>(this->get<offsetIndex>());
-				return !!*pResult;
+				return !!pResult && !!*pResult;
 			}
 			else {
 				return !!base;
@@ -279,10 +302,10 @@ namespace PointerChain {
 		const Tb_ base;
 		const std::tuple<Offsets_...> offsets;
 
-		// Applies a tuple to a traversal function. If null_safe was set at instantiation, nullptr checks will be added every step of the chain.
+		// Applies a tuple to a traversal function. If a safety level was set at instantiation, nullptr checks will be added every step of the chain.
 		template <typename T = void, typename... Ts> POINTERCHAIN_FORCE_INLINE constexpr T* apply_(const std::tuple<Ts...>& t) noexcept
 		{
-			if constexpr (null_safe_) {
+			if constexpr (safety_ >= Safety::Null) {
 				return std::apply([this](auto &&... args) constexpr -> T* { return reinterpret_cast<T*>(this->traverse(this->base, static_cast<const unsigned int&>(args)...)); }, t);
 			}
 			else {
@@ -291,12 +314,17 @@ namespace PointerChain {
 		}
 
 		// Chain traversal functions. If an offset is of an unsigned type, perform a nullptr check before adding it.
+		// Range safe chains also check that every address read from is readable.
 		template <typename Tb, typename To> POINTERCHAIN_FORCE_INLINE constexpr void* traverse(Tb base, const To& offset0) noexcept
 		{
 			if constexpr (std::is_same_v<typename Impl::unwrap_type<To>::type, unsigned int>) {
 				if (!base) return nullptr;
 			}
-			return reinterpret_cast<void*>(reinterpret_cast<unsigned char*>(base) + static_cast<int>(offset0));
+			void* result = reinterpret_cast<void*>(reinterpret_cast<unsigned char*>(base) + static_cast<int>(offset0));
+			if constexpr (safety_ >= Safety::Range) {
+				if (!MemoryRanges::isReadable(result)) return nullptr;
+			}
+			return result;
 		}
 
 		template <typename Tb, typename To, typename... Args> POINTERCHAIN_FORCE_INLINE constexpr void* traverse(Tb base, const To& offset0, const Args... offsets) noexcept
@@ -304,33 +332,203 @@ namespace PointerChain {
 			if constexpr (std::is_same_v<typename Impl::unwrap_type<To>::type, unsigned int>) {
 				if (!base) return nullptr;
 			}
-			return traverse(*reinterpret_cast<uintptr_t*>(reinterpret_cast<unsigned char*>(base) + static_cast<int>(offset0)), offsets...);
+			uintptr_t* next = reinterpret_cast<uintptr_t*>(reinterpret_cast<unsigned char*>(base) + static_cast<int>(offset0));
+			if constexpr (safety_ >= Safety::Range) {
+				if (!MemoryRanges::isReadable(next, sizeof(uintptr_t))) return nullptr;
+			}
+			return traverse(*next, offsets...);
 		}
 	};
 
-	template <typename PointerType, bool null_safe, std::size_t extra_offset_count, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto Impl::make(Tb&& base, Offsets&&... offsets) noexcept
+	template <typename PointerType, int safety, std::size_t extra_offset_count, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto Impl::make(Tb&& base, Offsets&&... offsets) noexcept
 	{
-		return PtrChainBase<PointerType, Impl::decay_rvalue_reference_t<decltype(base)>, null_safe, extra_offset_count, Impl::decay_rvalue_reference_t<decltype(offsets)>...>(std::forward<decltype(base)>(base), std::forward<Offsets>(offsets)...);
+		return PtrChainBase<PointerType, Impl::decay_rvalue_reference_t<decltype(base)>, safety, extra_offset_count, Impl::decay_rvalue_reference_t<decltype(offsets)>...>(std::forward<decltype(base)>(base), std::forward<Offsets>(offsets)...);
 	}
 
-	template <typename PointerType, bool null_safe, std::size_t extra_offset_count, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto Impl::make(Tb&& base, std::tuple<Offsets...> offsets) noexcept
+	template <typename PointerType, int safety, std::size_t extra_offset_count, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto Impl::make(Tb&& base, std::tuple<Offsets...> offsets) noexcept
 	{
-		return PtrChainBase<PointerType, Impl::decay_rvalue_reference_t<decltype(base)>, null_safe, extra_offset_count, Impl::decay_rvalue_reference_t<Offsets>...>(std::forward<decltype(base)>(base), offsets);
+		return PtrChainBase<PointerType, Impl::decay_rvalue_reference_t<decltype(base)>, safety, extra_offset_count, Impl::decay_rvalue_reference_t<Offsets>...>(std::forward<decltype(base)>(base), offsets);
 	}
 
-	// PointerType is the type pointed to by the chain, null_safe dictates whether EVERY offset should be treated as unsafe (unsigned).
+	// PointerType is the type pointed to by the chain, safety is a PointerChain::Safety level:
+	// Safety::Null treats EVERY offset as unsafe (unsigned), Safety::Range also checks every read against the readable memory ranges.
 	// The base can be of any type, references and pointers are dereferenced when traversing the pointer!
 	// The offsets can either be immediate integral values or variables of types that can be implicitly converted to such.
 	// Keep in mind any variable passed to PointerChain::make will be stored as a reference to that variable.
-	template <typename PointerType = unsigned char, bool null_safe = false, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto make(Tb&& base, Offsets&&... offsets) noexcept
+	template <typename PointerType = unsigned char, int safety = Safety::None, typename Tb, typename... Offsets> POINTERCHAIN_FORCE_INLINE constexpr auto make(Tb&& base, Offsets&&... offsets) noexcept
 	{
 		constexpr int64_t pointerDepth = Impl::pointer_depth_v<std::decay_t<Tb>> - 1;
 
 		if constexpr (pointerDepth <= 0) {
-			return Impl::make<PointerType, null_safe>(base, std::forward<Offsets>(offsets)...);
+			return Impl::make<PointerType, safety>(base, std::forward<Offsets>(offsets)...);
 		}
 		else {
-			return std::apply([&](auto ... extraOffsets) constexpr -> auto { return Impl::make<PointerType, null_safe, pointerDepth>(base, static_cast<std::decay_t<decltype(extraOffsets)>>(extraOffsets)..., std::forward<Offsets>(offsets)...); }, Impl::generate_tuple<std::conditional_t<null_safe, unsigned int, int>, pointerDepth>());
+			return std::apply([&](auto ... extraOffsets) constexpr -> auto { return Impl::make<PointerType, safety, pointerDepth>(base, static_cast<std::decay_t<decltype(extraOffsets)>>(extraOffsets)..., std::forward<Offsets>(offsets)...); }, Impl::generate_tuple<std::conditional_t<safety >= Safety::Null, unsigned int, int>, pointerDepth>());
+		}
+	}
+
+	// A chain with compile time offsets, to be resolved as a part of a PointerChain::Bundle.
+	// As with PointerChain::make, a nullptr check is performed before adding an offset of an unsigned type.
+	template <typename PointerType_, auto... Offsets_> struct Chain {
+		static_assert(sizeof...(Offsets_) > 0, "A chain needs at least one offset.");
+		static_assert(std::conjunction_v<std::is_integral<decltype(Offsets_)>...>, "Offset type must explicitly be an integer type.");
+
+		using PointerType = PointerType_;
+		static constexpr std::size_t size = sizeof...(Offsets_);
+		static constexpr int offsets[size] = { static_cast<int>(Offsets_)... };
+		static constexpr bool checked[size] = { std::is_same_v<decltype(Offsets_), unsigned int>... };
+	};
+
+	/// <summary>
+	/// Resolves several chains from the same base in one traversal, into a tuple of typed pointers.
+	/// Chains that start with the same offsets (and the same nullptr checks) share the pointers along that prefix,
+	/// so every intermediate pointer is only loaded once. Which chain resolves which pointer is decided at compile time.
+	/// Example: PointerChain::Bundle<PointerChain::Chain<V4D, 0x190, 0x68, 0x70>, PointerChain::Chain<V4D, 0x190, 0x68, 0x50>>::resolve(ChrIns)
+	/// </summary>
+	template <typename... Chains_> class Bundle {
+		static_assert(sizeof...(Chains_) > 0, "A bundle needs at least one chain.");
+
+		static constexpr std::size_t count = sizeof...(Chains_);
+		static constexpr std::size_t maxSize = (std::max)({ Chains_::size... });
+
+		struct Table {
+			std::size_t sizes[count];
+			int offsets[count][maxSize];
+			bool checked[count][maxSize];
+		};
+
+		template <typename Chain> static constexpr void fill(Table& table, const std::size_t index)
+		{
+			table.sizes[index] = Chain::size;
+			for (std::size_t i = 0; i < Chain::size; i++) {
+				table.offsets[index][i] = Chain::offsets[i];
+				table.checked[index][i] = Chain::checked[i];
+			}
+		}
+
+		static constexpr Table makeTable()
+		{
+			Table table{};
+			std::size_t index = 0;
+			(fill<Chains_>(table, index++), ...);
+			return table;
+		}
+
+		static constexpr Table table = makeTable();
+
+		// The first chain that reaches the pointer at depth D of chain I through the same offsets, that chain resolves it for both.
+		static constexpr std::size_t source(const std::size_t I, const std::size_t D)
+		{
+			for (std::size_t J = 0; J < I; J++) {
+				if (table.sizes[J] <= D) continue;
+
+				bool shared = true;
+				for (std::size_t k = 0; k < D; k++) {
+					shared = shared && table.offsets[J][k] == table.offsets[I][k] && table.checked[J][k] == table.checked[I][k];
+				}
+				if (shared) return J;
+			}
+			return I;
+		}
+
+		// nodes[I][D] is the pointer of chain I after D dereferences, failed[I] the step at which one of its nullptr checks failed.
+		struct State {
+			uintptr_t nodes[count][maxSize];
+			std::size_t failed[count];
+		};
+
+		template <std::size_t I, std::size_t D> static POINTERCHAIN_FORCE_INLINE void resolveNode(State& state) noexcept
+		{
+			constexpr std::size_t J = source(I, D);
+
+			if constexpr (J != I) {
+				state.nodes[I][D] = state.nodes[J][D];
+				if (state.failed[J] < D) state.failed[I] = state.failed[J];
+			}
+			else {
+				if (state.failed[I] < D) return;
+				if constexpr (table.checked[I][D - 1]) {
+					if (!state.nodes[I][D - 1]) {
+						state.failed[I] = D - 1;
+						return;
+					}
+				}
+				state.nodes[I][D] = *reinterpret_cast<uintptr_t*>(state.nodes[I][D - 1] + table.offsets[I][D - 1]);
+			}
+		}
+
+		template <std::size_t I, std::size_t... D> static POINTERCHAIN_FORCE_INLINE auto resolveChain(State& state, std::index_sequence<D...>) noexcept
+		{
+			(resolveNode<I, D + 1>(state), ...);
+
+			constexpr std::size_t last = table.sizes[I] - 1;
+			using PointerType = typename std::tuple_element_t<I, std::tuple<Chains_...>>::PointerType;
+
+			if (state.failed[I] <= last) return static_cast<PointerType*>(nullptr);
+			if constexpr (table.checked[I][last]) {
+				if (!state.nodes[I][last]) return static_cast<PointerType*>(nullptr);
+			}
+			return reinterpret_cast<PointerType*>(state.nodes[I][last] + table.offsets[I][last]);
+		}
+
+		template <std::size_t... I> static POINTERCHAIN_FORCE_INLINE auto resolveAll(State& state, std::index_sequence<I...>) noexcept
+		{
+			// the chains are resolved in order, so that every chain can reuse the pointers of the chains before it
+			std::tuple<typename Chains_::PointerType*...> result{};
+			((std::get<I>(result) = resolveChain<I>(state, std::make_index_sequence<Chains_::size - 1>{})), ...);
+			return result;
+		}
+
+	public:
+		Bundle() = delete;
+
+		// Resolves all chains from a base address. A chain whose nullptr check fails resolves to nullptr.
+		template <typename Tb> static POINTERCHAIN_FORCE_INLINE std::tuple<typename Chains_::PointerType*...> resolve(Tb* base) noexcept
+		{
+			State state;
+			for (std::size_t i = 0; i < count; i++) {
+				state.nodes[i][0] = reinterpret_cast<uintptr_t>(base);
+				state.failed[i] = maxSize;
+			}
+			return resolveAll(state, std::make_index_sequence<count>{});
+		}
+	};
+
+	/// <summary>
+	/// Resolves one chain from many bases, walking all of them in lockstep. The pointers of every base at one depth are loaded
+	/// before any pointer at the next depth, so the cache misses of the independent walks overlap instead of adding up.
+	/// A separate prefetch pass made it twice as slow, out-of-order execution already overlaps the loads (see PointerChainBenchmark).
+	/// results[i] is the chain resolved from bases[i], or nullptr if one of its nullptr checks failed. results must not overlap bases.
+	/// Example: PointerChain::resolveBatch<PointerChain::Chain<uint8_t, 0x190, 0x0>>(chrInses, modules, count)
+	/// </summary>
+	template <typename Chain_, typename Tb> inline void resolveBatch(Tb* const* bases, typename Chain_::PointerType** results, const std::size_t count) noexcept
+	{
+		using PointerType = typename Chain_::PointerType;
+
+		// the results hold the pointers of every walk at the current depth, until the last offset is added
+		for (std::size_t i = 0; i < count; i++) {
+			results[i] = reinterpret_cast<PointerType*>(bases[i]);
+		}
+
+		// once a walk passed a nullptr check it is skipped while it is nullptr, a failed check leaves it at nullptr
+		bool skipNull = false;
+		for (std::size_t depth = 0; depth + 1 < Chain_::size; depth++) {
+			const int offset = Chain_::offsets[depth];
+			skipNull = skipNull || Chain_::checked[depth];
+
+			for (std::size_t i = 0; i < count; i++) {
+				const uintptr_t node = reinterpret_cast<uintptr_t>(results[i]);
+				if (skipNull && !node) continue;
+				results[i] = *reinterpret_cast<PointerType**>(node + offset);
+			}
+		}
+
+		constexpr std::size_t last = Chain_::size - 1;
+		skipNull = skipNull || Chain_::checked[last];
+		for (std::size_t i = 0; i < count; i++) {
+			const uintptr_t node = reinterpret_cast<uintptr_t>(results[i]);
+			if (skipNull && !node) continue;
+			results[i] = reinterpret_cast<PointerType*>(node + Chain_::offsets[last]);
 		}
 	}
 }
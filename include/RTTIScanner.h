@@ -1,17 +1,29 @@
 #pragma once
 
 #include "PE.h"
+#include "CPUFeatures.h"
+#include "faststring.h"
 #include <immintrin.h>
 
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <string_view>
 
 class RTTIScanner {
 public:
 	struct SectionData {
-		SectionData(PEParser::PESections* text, PEParser::PESections* data, PEParser::PESections* rdata) : text(text), data(data), rdata(rdata) {}
+		SectionData(PEParser::PESections* text, PEParser::PESections* data, PEParser::PESections* rdata,
+			const PEParser::SectionRanges* textRanges, const PEParser::SectionRanges* dataRanges, const PEParser::SectionRanges* rdataRanges) :
+			text(text), data(data), rdata(rdata), textRanges(textRanges), dataRanges(dataRanges), rdataRanges(rdataRanges) {}
 		PEParser::PESections* text;
 		PEParser::PESections* data;
 		PEParser::PESections* rdata;
+		// flat ranges of the same sections, for the per-candidate checks
+		const PEParser::SectionRanges* textRanges;
+		const PEParser::SectionRanges* dataRanges;
+		const PEParser::SectionRanges* rdataRanges;
 	};
 
 #pragma pack(push, 1) // pack the struct to preserve instruction layout
@@ -111,72 +123,280 @@ public:
 	};
 
 	RTTIScanner() { RTTIScanner::parser.reset(new PEParser()); }
-	~RTTIScanner() { RTTIScanner::parser.reset(); RTTIScanner::classRTTI.clear(); RTTIScanner::sectionData.reset(); }
+	~RTTIScanner() { RTTIScanner::parser.reset(); RTTIScanner::clearClasses(); RTTIScanner::sectionData.reset(); }
 
 	/// <summary>
 	/// Scans the executable's text section(s) to retrieve class RTTI by matching instruction patterns inside class object constructors.
-	/// Pointers to RTTI structs are mapped on a RTTIScanner::classRTTI map, using class names as keys.
+	/// Pointers to RTTI structs are mapped on a RTTIScanner::classRTTI map, using the mangled type descriptor names (e.g. ".?AVPlayerIns@CS@@") as keys.
+	/// Names are only demangled on demand, see RTTIScanner::getClassRTTI and RTTI::getName.
+	/// The .rdata section(s) can be split into chunks scanned by several threads, the results are identical to a single threaded scan.
+	/// Only use more than one thread outside of DllMain: new threads wait for the loader lock, which DllMain holds, so waiting for them deadlocks.
 	/// </summary>
 	/// <param name="pInfo">: (optional) a pointer to a PEParser::ProcessInfo struct overriding the default process information used by the parser</param>
+	/// <param name="threadCount">: (optional) the number of threads to scan with, 1 by default, 0 for one per hardware thread</param>
+	/// <param name="cachePath">: (optional) a file to load the results from instead of scanning, if it was made for the same executable.
+	/// Otherwise the executable is scanned and the file is written for the next launch. See RTTIScanner::loadCache</param>
 	/// <returns>true on success, false on initialization failure</returns>
-	bool scan(PEParser::ProcessInfo* pInfo = nullptr)
+	bool scan(PEParser::ProcessInfo* pInfo = nullptr, unsigned int threadCount = 1, const char* cachePath = nullptr)
 	{
 		// parse the PE headers and get section addresses and process information
-		if (!RTTIScanner::parser->parse(pInfo) || !this->setSectionData()) return false;
+		unsigned char* base = this->prepare(pInfo);
+		if (!base) return false;
 
-		auto processInfo = this->parser->getProcessInfo();
-		if (!processInfo) return false;
+		// the keys of an earlier scan point into the image it scanned, which may have been unloaded since
+		RTTIScanner::clearClasses();
 
-		//get executable base address and sections
-		unsigned char* base = reinterpret_cast<unsigned char*>(processInfo->mInfo->lpBaseOfDll);
+		PEParser::ImageIdentity identity = {};
+		const bool cacheable = !!cachePath && PEParser::getImageIdentity(identity);
+		if (cacheable && this->loadCache(cachePath, base, identity)) return true;
 
-		PEParser::PESections* text = this->sectionData->text;
-		PEParser::PESections* data = this->sectionData->data;
-		PEParser::PESections* rdata = this->sectionData->rdata;
+		this->scanAll(base, threadCount);
+		if (cacheable) this->saveCache(cachePath, base, identity);
 
-		if (!text || !data || !rdata) return false;
+		return true;
+	}
 
-		for (auto& section : *rdata) {
-			auto pCOL = section->start.as<CompleteObjectLocator**>(base);
-			auto end = section->end.as<CompleteObjectLocator**>(base);
-			while (pCOL++ < end) {
-				auto COL = *pCOL;
-				if (!PEParser::isAddressInSection(COL, rdata)) continue;
-				if (!PEParser::isAddressInSection(*(++pCOL), text)) continue;
-				if (COL->signature != 1) continue;
-				if (!PEParser::isIbo32InSection(COL->iboTypeDescriptor, data)) continue;
-				if (!PEParser::isIbo32InSection(COL->iboClassDescriptor, rdata)) continue;
-				TypeDescriptor* TD = COL->iboTypeDescriptor.as<TypeDescriptor*>(base);
-				ClassHierarchyDescriptor* CHD = COL->iboClassDescriptor.as<ClassHierarchyDescriptor*>(base);
+	/// <summary>
+	/// Scans for the RTTI of a known set of classes only, stopping as soon as all of them have been found.
+	/// Candidates are matched by their mangled type descriptor names, nothing is demangled. Found classes are also added to the class map,
+	/// so RTTIScanner::getClassRTTI and name based hooks work for them as after a full scan. Use RTTIScanner::scan to map every class.
+	/// Names with template arguments or other non-plain parts can not be matched by their mangled form, if any are requested a full scan is done instead.
+	/// </summary>
+	/// <param name="classNames">: names of the classes to find, e.g. "CS::PlayerIns"</param>
+	/// <param name="pInfo">: (optional) a pointer to a PEParser::ProcessInfo struct overriding the default process information used by the parser</param>
+	/// <param name="cachePath">: (optional) a file to load the results from, see RTTIScanner::scan. The file only ever holds a complete class map:
+	/// if it is missing or was made for another executable, a full scan is done instead of the targeted one and the file is written for the next launch</param>
+	/// <returns>a pointer to the RTTI of each requested class in the same order, nullptr for classes that were not found or if initialization failed</returns>
+	std::vector<RTTI*> scanFor(const std::vector<std::string_view>& classNames, PEParser::ProcessInfo* pInfo = nullptr, const char* cachePath = nullptr)
+	{
+		std::vector<RTTI*> found(classNames.size(), nullptr);
 
-				if (!PEParser::isIbo32InSection(CHD->iboBaseClassDescriptor, rdata)) continue;
-				BaseClassDescriptor* pBCD = CHD->iboBaseClassDescriptor.as< BaseClassDescriptor*>(base);
+		const bool plainNames = std::none_of(classNames.begin(), classNames.end(),
+			[](std::string_view name) { return name.empty() || name.find_first_of("<>,()*&[]` ") != std::string_view::npos; });
+		if (!plainNames) {
+			if (this->scan(pInfo, 1, cachePath)) {
+				std::transform(classNames.begin(), classNames.end(), found.begin(), &RTTIScanner::getClassRTTI);
+			}
+			return found;
+		}
 
-				// demangleName will return an empty string if the class name is invalid
-				std::string name = RTTI::demangleName(TD->name);
-				if (name.empty()) continue;
+		unsigned char* base = this->prepare(pInfo);
+		if (!base) return found;
 
-				RTTIScanner::classRTTI.emplace(name, std::make_unique<RTTI>(reinterpret_cast<void**>(pCOL), COL, TD, CHD, pBCD));
+		RTTIScanner::clearClasses();
+
+		// a targeted scan is never saved, it would replace a complete cache with a part of it
+		PEParser::ImageIdentity identity = {};
+		if (!!cachePath && PEParser::getImageIdentity(identity)) {
+			if (!this->loadCache(cachePath, base, identity)) {
+				this->scanAll(base, 1);
+				this->saveCache(cachePath, base, identity);
 			}
+			std::transform(classNames.begin(), classNames.end(), found.begin(), &RTTIScanner::getClassRTTI);
+			return found;
 		}
 
-		return true;
+		// the mangled names of the requested classes, as either a class or a struct, each mapped to the index of the requested name
+		std::vector<std::string> mangledNames;
+		for (const std::string_view name : classNames) {
+			mangledNames.push_back(RTTIScanner::mangleClassName(name, 'V'));
+			mangledNames.push_back(RTTIScanner::mangleClassName(name, 'U'));
+		}
+
+		std::unordered_map<std::string_view, size_t, faststring::Hash> wanted;
+		for (size_t i = 0; i < mangledNames.size(); i++) {
+			wanted.emplace(mangledNames[i], i / 2);
+		}
+		size_t remaining = classNames.size();
+
+		// the sections are scanned in order a window at a time, the first RTTI found for a name is kept as in a full scan
+		const Filter filter = { getBounds(this->sectionData->rdataRanges), getBounds(this->sectionData->textRanges) };
+		constexpr size_t windowSize = 4096;
+
+		for (auto& section : *this->sectionData->rdata) {
+			CompleteObjectLocator** start = section->start.as<CompleteObjectLocator**>(base);
+			CompleteObjectLocator** end = section->end.as<CompleteObjectLocator**>(base);
+
+			for (CompleteObjectLocator** window = start; window < end && remaining > 0; window += std::min<size_t>(windowSize, end - window)) {
+				Chunk chunk = { window, window + std::min<size_t>(windowSize, end - window), end };
+				this->scanChunk(chunk, base, filter);
+
+				for (RTTI& rtti : chunk.results) {
+					const char* name = rtti.pTypeDescriptor->name;
+					const std::string_view mangledName(name, faststring::length(name));
+					auto iter = wanted.find(mangledName);
+					if (iter == wanted.end() || !!found[iter->second]) continue;
+
+					// as in a full scan, the key points to the name in the type descriptor
+					found[iter->second] = &RTTIScanner::classRTTI.emplace(mangledName, rtti).first->second;
+					remaining--;
+				}
+			}
+		}
+
+		return found;
 	}
 
 	/// <summary>
 	/// Retrieves a pointer to the RTTI of a class after a scan, by name.
+	/// Plain (possibly nested) class and struct names are translated to their mangled form and looked up directly.
+	/// Other names, like template instances, and plain names whose mangled form was not found demangle every class name once,
+	/// on the first such request.
 	/// </summary>
-	/// <param name="name">: name of the class to get RTTI of</param>
+	/// <param name="name">: name of the class to get RTTI of, e.g. "CS::PlayerIns"</param>
 	/// <returns>a pointer to class RTTI on success, otherwise nullptr</returns>
-	static RTTI* getClassRTTI(std::string name)
-	{ 
-		auto iter = RTTIScanner::classRTTI.find(name); 
-		return iter != RTTIScanner::classRTTI.end() ? RTTIScanner::classRTTI[name].get() : nullptr; 
+	static RTTI* getClassRTTI(const std::string_view name)
+	{
+		if (name.empty()) return nullptr;
+
+		if (name.find_first_of("<>,()*&[]` ") == std::string_view::npos) {
+			for (const char kind : { 'V', 'U' }) {
+				auto iter = RTTIScanner::classRTTI.find(RTTIScanner::mangleClassName(name, kind));
+				if (iter != RTTIScanner::classRTTI.end()) return &iter->second;
+			}
+		}
+
+		if (RTTIScanner::demangledRTTI.empty()) {
+			for (auto& [mangledName, rtti] : RTTIScanner::classRTTI) {
+				// demangleName will return an empty string if the class name is invalid
+				std::string demangledName = RTTI::demangleName(rtti.pTypeDescriptor->name);
+				if (!demangledName.empty()) RTTIScanner::demangledRTTI.emplace(std::move(demangledName), &rtti);
+			}
+		}
+
+		auto iter = RTTIScanner::demangledRTTI.find(std::string(name));
+		return iter != RTTIScanner::demangledRTTI.end() ? iter->second : nullptr;
 	}
 
+	/// <summary>
+	/// Translates a class name to the mangled name of its type descriptor, e.g. "CS::PlayerIns" to ".?AVPlayerIns@CS@@".
+	/// Repeated names are encoded as back references like MSVC does, e.g. "A::B::A" to ".?AVA@B@0@".
+	/// </summary>
+	/// <param name="name">: a class name without template arguments</param>
+	/// <param name="kind">: (optional) 'V' for classes, 'U' for structs</param>
+	/// <returns>the mangled name</returns>
+	static std::string mangleClassName(const std::string_view name, const char kind = 'V')
+	{
+		std::string mangled = ".?A";
+		mangled += kind;
+
+		// the innermost name comes first, the first 10 distinct names can be referred back to by their index
+		std::string_view names[10];
+		size_t nameCount = 0;
+		size_t end = name.size();
+		while (true) {
+			const size_t separator = end >= 2 ? name.rfind("::", end - 2) : std::string_view::npos;
+			const size_t start = separator == std::string_view::npos ? 0 : separator + 2;
+			const std::string_view part = name.substr(start, end - start);
+
+			const size_t index = std::find(names, names + nameCount, part) - names;
+			if (index < nameCount) {
+				mangled += static_cast<char>('0' + index);
+			}
+			else {
+				if (nameCount < std::size(names)) names[nameCount++] = part;
+				mangled += part;
+				mangled += '@';
+			}
+
+			if (separator == std::string_view::npos) break;
+			end = separator;
+		}
+
+		mangled += '@';
+		return mangled;
+	}
+
+	// The prefilter of RTTIScanner::scan, public so that its kernels can be tested directly.
+
+	// The absolute bounds that enclose all sections of a kind, for prefiltering candidates.
+	// Sections of the same name are usually contiguous, addresses that pass are checked against the exact sections afterwards.
+	struct Bounds {
+		uintptr_t start;
+		uintptr_t end;
+	};
+
+	struct Filter {
+		Bounds rdata;
+		Bounds text;
+	};
+
+	// Prefilter kernels: write the indices of the slots that point into .rdata and are followed by a pointer into .text.
+	// count slots are filtered, slots[count] must be readable. Returns the number of indices written.
+	typedef size_t FilterFn(const uintptr_t* slots, size_t count, const Filter& filter, uint32_t* candidates);
+
+	static size_t filterScalar(const uintptr_t* slots, const size_t count, const Filter& filter, uint32_t* candidates)
+	{
+		const uintptr_t rdataSize = filter.rdata.end - filter.rdata.start;
+		const uintptr_t textSize = filter.text.end - filter.text.start;
+		size_t found = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			// wrapping subtraction, one compare per range
+			if (slots[i] - filter.rdata.start < rdataSize && slots[i + 1] - filter.text.start < textSize) {
+				candidates[found++] = static_cast<uint32_t>(i);
+			}
+		}
+
+		return found;
+	}
+
+	// Four slots at a time. The packed 64-bit compares are signed, which is fine for user mode addresses (below 2^63).
+	// Values above it, like most non-pointer data, compare as negative and are rejected.
+	CPUFEATURES_TARGET_AVX2 static size_t filterAVX2(const uintptr_t* slots, const size_t count, const Filter& filter, uint32_t* candidates)
+	{
+		const __m256i rdataStart = _mm256_set1_epi64x(static_cast<long long>(filter.rdata.start - 1));
+		const __m256i rdataEnd = _mm256_set1_epi64x(static_cast<long long>(filter.rdata.end));
+		const __m256i textStart = _mm256_set1_epi64x(static_cast<long long>(filter.text.start - 1));
+		const __m256i textEnd = _mm256_set1_epi64x(static_cast<long long>(filter.text.end));
+		size_t found = 0;
+		size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			const __m256i col = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + i));
+			const __m256i vft = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + i + 1));
+			const __m256i inRdata = _mm256_and_si256(_mm256_cmpgt_epi64(col, rdataStart), _mm256_cmpgt_epi64(rdataEnd, col));
+			const __m256i inText = _mm256_and_si256(_mm256_cmpgt_epi64(vft, textStart), _mm256_cmpgt_epi64(textEnd, vft));
+
+			unsigned int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_and_si256(inRdata, inText)));
+			while (mask) {
+				candidates[found++] = static_cast<uint32_t>(i + countTrailingZeros(mask));
+				mask &= mask - 1;
+			}
+		}
+
+		const size_t tail = filterScalar(slots + i, count - i, filter, candidates + found);
+		for (size_t k = found; k < found + tail; k++) {
+			candidates[k] += static_cast<uint32_t>(i);
+		}
+
+		return found + tail;
+	}
+
+	static int countTrailingZeros(const unsigned int x)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, x);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(x);
+#endif
+	}
+
+	static inline const CPUFeatures::Kernel<FilterFn> filterKernel{ &RTTIScanner::filterScalar, nullptr, &RTTIScanner::filterAVX2 };
+
 private:
+	static void clearClasses()
+	{
+		RTTIScanner::demangledRTTI.clear();
+		RTTIScanner::classRTTI.clear();
+	}
+
 	static inline std::unique_ptr<PEParser> parser{};
-	static inline std::unordered_map<std::string, std::unique_ptr<RTTI>> classRTTI{};
+	static inline std::unordered_map<std::string_view, RTTI, faststring::Hash> classRTTI{};
+	// Demangled names, only built when a name can not be looked up by its mangled form.
+	static inline std::unordered_map<std::string, RTTI*, faststring::Hash> demangledRTTI{};
 	static inline std::unique_ptr<SectionData> sectionData{};
 
 	// REX.W lea reg1,[rip]
@@ -184,6 +404,236 @@ private:
 	const __m128i signature = _mm_setr_epi8(0x48, 0x8D, 0x05, 0x0, 0x0, 0x0, 0x0, 0x48, 0x89, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0);
 	const __m128i bitmask = _mm_setr_epi8(0b00000100, 0, 0b00111000, -1, -1, -1, -1, 0b00000101, 0, 0b00111111, -1, -1, -1, -1, -1, -1);
 
+	// A range of .rdata slots scanned as one unit, with the end of the section it is in and its local results.
+	struct Chunk {
+		CompleteObjectLocator** start;
+		CompleteObjectLocator** end;
+		CompleteObjectLocator** sectionEnd;
+		std::vector<RTTI> results = {};
+	};
+
+	static Bounds getBounds(const PEParser::SectionRanges* sections)
+	{
+		auto& ranges = sections->getRanges();
+		if (ranges.empty()) return { UINTPTR_MAX, 0 };
+
+		// the ranges are sorted
+		return { ranges.front().start, ranges.back().end };
+	}
+
+	// Parses the PE headers and sets the section data. Returns the base address of the image, or nullptr if it has no RTTI sections.
+	unsigned char* prepare(PEParser::ProcessInfo* pInfo)
+	{
+		if (!RTTIScanner::parser->parse(pInfo) || !this->setSectionData()) return nullptr;
+
+		auto processInfo = this->parser->getProcessInfo();
+		if (!processInfo) return nullptr;
+
+		return reinterpret_cast<unsigned char*>(processInfo->mInfo->lpBaseOfDll);
+	}
+
+	// Maps every class of the image, see RTTIScanner::scan.
+	void scanAll(unsigned char* base, unsigned int threadCount)
+	{
+		if (!threadCount) threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+		const Filter filter = { getBounds(this->sectionData->rdataRanges), getBounds(this->sectionData->textRanges) };
+
+		// split every .rdata section into chunks, a few per thread so that uneven chunks even out
+		std::vector<Chunk> chunks;
+		for (auto& section : *this->sectionData->rdata) {
+			CompleteObjectLocator** start = section->start.as<CompleteObjectLocator**>(base);
+			CompleteObjectLocator** end = section->end.as<CompleteObjectLocator**>(base);
+			const size_t slotCount = end - start;
+			const size_t chunkCount = threadCount > 1 ? (std::min)(static_cast<size_t>(threadCount) * 4, (std::max)(slotCount / 4096, static_cast<size_t>(1))) : 1;
+
+			for (size_t i = 0; i < chunkCount; i++) {
+				chunks.push_back({ start + slotCount * i / chunkCount, start + slotCount * (i + 1) / chunkCount, end });
+			}
+		}
+
+		if (threadCount > 1 && chunks.size() > 1) {
+			std::vector<std::thread> threads;
+			std::atomic<size_t> next = 0;
+			for (unsigned int i = 0; i < threadCount && i < chunks.size(); i++) {
+				threads.emplace_back([&]() {
+					for (size_t chunk = next++; chunk < chunks.size(); chunk = next++) {
+						this->scanChunk(chunks[chunk], base, filter);
+					}
+				});
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+		}
+		else {
+			for (Chunk& chunk : chunks) {
+				this->scanChunk(chunk, base, filter);
+			}
+		}
+
+		// merge in chunk order, so the first RTTI found for a name is kept as in a serial scan.
+		// The keys point to the names in the type descriptors, which live as long as the executable
+		RTTIScanner::clearClasses();
+		for (Chunk& chunk : chunks) {
+			for (RTTI& rtti : chunk.results) {
+				const char* name = rtti.pTypeDescriptor->name;
+				const size_t length = faststring::length(name);
+				if (length < 6 || !faststring::startsWith(name, ".?A")) continue;
+
+				RTTIScanner::classRTTI.emplace(std::string_view(name, length), rtti);
+			}
+		}
+	}
+
+	// Finds the virtual function tables in a chunk: a complete object locator pointer followed by a pointer into .text.
+	// Every slot is checked, the slot after the last one in the chunk is only read and may belong to the next chunk.
+	// Slots are prefiltered a window at a time against the section bounds, only the survivors are validated.
+	void scanChunk(Chunk& chunk, unsigned char* base, const Filter& filter)
+	{
+		const PEParser::SectionRanges& text = *this->sectionData->textRanges;
+		const PEParser::SectionRanges& data = *this->sectionData->dataRanges;
+		const PEParser::SectionRanges& rdata = *this->sectionData->rdataRanges;
+
+		constexpr size_t windowSize = 4096;
+		uint32_t candidates[windowSize];
+
+		CompleteObjectLocator** last = (std::min)(chunk.end, chunk.sectionEnd - 1);
+		for (CompleteObjectLocator** window = chunk.start; window < last; window += windowSize) {
+			const size_t count = std::min<size_t>(windowSize, last - window);
+			const size_t found = filterKernel(reinterpret_cast<const uintptr_t*>(window), count, filter, candidates);
+
+			for (size_t k = 0; k < found; k++) {
+				CompleteObjectLocator** pCOL = window + candidates[k];
+				auto COL = *pCOL;
+				if (!rdata.contains(COL)) continue;
+				if (!text.contains(pCOL[1])) continue;
+				if (COL->signature != 1) continue;
+				if (!data.contains(COL->iboTypeDescriptor)) continue;
+				if (!rdata.contains(COL->iboClassDescriptor)) continue;
+				TypeDescriptor* TD = COL->iboTypeDescriptor.as<TypeDescriptor*>(base);
+				ClassHierarchyDescriptor* CHD = COL->iboClassDescriptor.as<ClassHierarchyDescriptor*>(base);
+
+				if (!rdata.contains(CHD->iboBaseClassDescriptor)) continue;
+				BaseClassDescriptor* pBCD = CHD->iboBaseClassDescriptor.as<BaseClassDescriptor*>(base);
+
+				chunk.results.emplace_back(reinterpret_cast<void**>(pCOL + 1), COL, TD, CHD, pBCD);
+			}
+		}
+	}
+
+	// The RTTI scan cache file: a header identifying the executable, followed by the image relative offsets of every class's RTTI.
+	struct CacheHeader {
+		char magic[8];
+		unsigned int version;
+		unsigned int count;
+		PEParser::ImageIdentity identity;
+	};
+
+	struct CacheEntry {
+		PEParser::ibo32 VFT;
+		PEParser::ibo32 COL;
+		PEParser::ibo32 TD;
+		PEParser::ibo32 CHD;
+		PEParser::ibo32 BCD;
+	};
+
+	static constexpr char cacheMagic[8] = "SKMRTTI";
+	static constexpr unsigned int cacheVersion = 3;
+
+	/// <summary>
+	/// Loads the results of an earlier scan of the same executable, mapping the file instead of reading it.
+	/// Every entry is validated against the image: a cached virtual function table must still be preceded by its complete object locator,
+	/// which must still point to the cached descriptors. Any mismatch rejects the whole file.
+	/// </summary>
+	/// <returns>false if the file is missing, was made for another executable or does not match the image</returns>
+	bool loadCache(const char* path, unsigned char* base, const PEParser::ImageIdentity& identity)
+	{
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize = {};
+		HANDLE mapping = nullptr;
+		const void* view = nullptr;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(CacheHeader))) {
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!!mapping) view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+
+		bool loaded = false;
+		if (!!view) {
+			const CacheHeader* header = reinterpret_cast<const CacheHeader*>(view);
+			const CacheEntry* entries = reinterpret_cast<const CacheEntry*>(header + 1);
+			loaded = !memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) && header->version == cacheVersion && header->identity == identity
+				&& fileSize.QuadPart == static_cast<LONGLONG>(sizeof(CacheHeader) + header->count * sizeof(CacheEntry));
+
+			for (unsigned int i = 0; loaded && i < header->count; i++) {
+				loaded = this->addCacheEntry(entries[i], base, identity.sizeOfImage);
+			}
+
+			UnmapViewOfFile(view);
+		}
+
+		if (!!mapping) CloseHandle(mapping);
+		CloseHandle(file);
+
+		if (!loaded) RTTIScanner::clearClasses();
+		return loaded;
+	}
+
+	bool addCacheEntry(CacheEntry entry, unsigned char* base, const unsigned int sizeOfImage)
+	{
+		for (PEParser::ibo32 ibo : { entry.VFT, entry.COL, entry.TD, entry.CHD, entry.BCD }) {
+			if (ibo.as() < static_cast<int>(sizeof(void*)) || static_cast<unsigned int>(ibo.as()) >= sizeOfImage) return false;
+		}
+
+		void** pVFT = entry.VFT.as<void**>(base);
+		CompleteObjectLocator* COL = entry.COL.as<CompleteObjectLocator*>(base);
+		if (pVFT[-1] != COL || COL->signature != 1 || COL->iboTypeDescriptor != entry.TD || COL->iboClassDescriptor != entry.CHD) return false;
+
+		TypeDescriptor* TD = entry.TD.as<TypeDescriptor*>(base);
+		ClassHierarchyDescriptor* CHD = entry.CHD.as<ClassHierarchyDescriptor*>(base);
+		if (CHD->iboBaseClassDescriptor != entry.BCD) return false;
+
+		// the name must end within the image as well
+		if (static_cast<unsigned int>(entry.TD.as()) + offsetof(TypeDescriptor, name) >= sizeOfImage) return false;
+		const size_t maxLength = (std::min)(sizeof(TD->name), static_cast<size_t>(sizeOfImage - entry.TD.as() - offsetof(TypeDescriptor, name)));
+		const size_t length = strnlen(TD->name, maxLength);
+		if (length < 6 || length == maxLength || !faststring::startsWith(TD->name, ".?A")) return false;
+
+		RTTIScanner::classRTTI.emplace(std::string_view(TD->name, length), RTTI(pVFT, COL, TD, CHD, entry.BCD.as<BaseClassDescriptor*>(base)));
+		return true;
+	}
+
+	// Writes the results of a full scan as image relative offsets. The file is written next to the cache and renamed over it,
+	// so that a crash or a full disk never leaves a truncated cache behind. A failure to write only means the next launch scans again.
+	void saveCache(const char* path, unsigned char* base, const PEParser::ImageIdentity& identity)
+	{
+		std::vector<unsigned char> buffer(sizeof(CacheHeader) + RTTIScanner::classRTTI.size() * sizeof(CacheEntry));
+
+		CacheHeader* header = reinterpret_cast<CacheHeader*>(buffer.data());
+		memcpy(header->magic, cacheMagic, sizeof(cacheMagic));
+		header->version = cacheVersion;
+		header->count = static_cast<unsigned int>(RTTIScanner::classRTTI.size());
+		header->identity = identity;
+
+		CacheEntry* entry = reinterpret_cast<CacheEntry*>(header + 1);
+		for (auto& [name, rtti] : RTTIScanner::classRTTI) {
+			*entry++ = { PEParser::ibo32(rtti.pVirtualFunctionTable, base), PEParser::ibo32(rtti.pCompleteObjectLocator, base),
+				PEParser::ibo32(rtti.pTypeDescriptor, base), PEParser::ibo32(rtti.pClassHierarchyDescriptor, base), PEParser::ibo32(rtti.pBaseClassDescriptor, base) };
+		}
+
+		const std::string tempPath = std::string(path) + ".tmp";
+		HANDLE file = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return;
+
+		DWORD written = 0;
+		const bool complete = WriteFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &written, nullptr) && written == buffer.size();
+		CloseHandle(file);
+
+		if (!complete || !MoveFileExA(tempPath.c_str(), path, MOVEFILE_REPLACE_EXISTING)) DeleteFileA(tempPath.c_str());
+	}
+
 	bool setSectionData()
 	{
 		RTTIScanner::sectionData.reset();
@@ -194,7 +644,13 @@ private:
 
 		if (!text || !data || !rdata) return false;
 
-		RTTIScanner::sectionData.reset(new SectionData(text, data, rdata));
+		const PEParser::SectionRanges* textRanges = RTTIScanner::parser->getSectionRanges(".text");
+		const PEParser::SectionRanges* dataRanges = RTTIScanner::parser->getSectionRanges(".data");
+		const PEParser::SectionRanges* rdataRanges = RTTIScanner::parser->getSectionRanges(".rdata");
+
+		if (!textRanges || !dataRanges || !rdataRanges) return false;
+
+		RTTIScanner::sectionData.reset(new SectionData(text, data, rdata, textRanges, dataRanges, rdataRanges));
 
 		return true;
 	}
@@ -0,0 +1,669 @@
+#pragma once
+
+#include "PE.h"
+#include "CPUFeatures.h"
+#include <immintrin.h>
+
+#include <array>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+
+/// <summary>
+/// Masked byte signature (array of bytes) scanning over memory or PE sections.
+/// Candidates are found by comparing 16 (SSE2) or 32 (AVX2) positions at once against the two rarest bytes of the signature,
+/// only positions where both match are verified against the whole signature, with masked 16 or 32 byte compares.
+/// Many signatures can be scanned for in a single pass with a SignatureScanner::SignatureSet.
+/// </summary>
+class SignatureScanner {
+public:
+	class SignatureSet;
+
+	/// <summary>
+	/// A byte pattern with wildcard bits. A byte of memory matches a byte of the pattern if they are equal in every bit that is not ignored.
+	/// </summary>
+	class Signature {
+	public:
+		/// <summary>
+		/// Parses a signature from text, e.g. "48 8D 05 ?? ?? ?? ?? 48 89". Bytes are two hex digits, "?" or "??" is a wildcard byte.
+		/// Throws if the text is not a valid signature.
+		/// </summary>
+		/// <param name="pattern">: the signature as text</param>
+		Signature(const char* pattern)
+		{
+			std::vector<unsigned char> bytes, ignore;
+
+			for (const char* c = pattern; *c;) {
+				if (*c == ' ') {
+					c++;
+				}
+				else if (*c == '?') {
+					bytes.push_back(0);
+					ignore.push_back(0xFF);
+					c += c[1] == '?' ? 2 : 1;
+				}
+				else {
+					const int high = hexDigit(c[0]);
+					const int low = high < 0 ? -1 : hexDigit(c[1]);
+					if (low < 0) throw std::runtime_error("Invalid signature.");
+
+					bytes.push_back(static_cast<unsigned char>(high << 4 | low));
+					ignore.push_back(0);
+					c += 2;
+				}
+			}
+
+			this->initialize(bytes.data(), ignore.data(), bytes.size());
+		}
+
+		/// <summary>
+		/// Makes a signature from bytes and a mask of the bits to ignore in each byte (e.g. the register fields of an instruction).
+		/// Throws if the signature is empty.
+		/// </summary>
+		/// <param name="bytes">: the bytes to match</param>
+		/// <param name="ignore">: (optional) for each byte, the bits to ignore. All bits are compared if nullptr</param>
+		/// <param name="length">: the length of the signature in bytes</param>
+		Signature(const unsigned char* bytes, const unsigned char* ignore, const size_t length)
+		{
+			std::vector<unsigned char> none(length, 0);
+			this->initialize(bytes, !!ignore ? ignore : none.data(), length);
+		}
+
+		size_t size() const { return this->length; }
+
+		// Compares a signature length of memory with the signature, one byte at a time. Reads exactly SignatureScanner::Signature::size bytes.
+		bool matches(const unsigned char* mem) const
+		{
+			for (size_t i = 0; i < this->length; i++) {
+				if ((mem[i] | this->ignore[i]) != this->pattern[i]) return false;
+			}
+			return true;
+		}
+
+	private:
+		friend class SignatureScanner;
+		friend class SignatureSet;
+
+		// The pattern has the ignored bits set, so that (memory | ignore) == pattern for a match.
+		// Both are padded to a multiple of 32 bytes with ignored bytes, for the SIMD compares.
+		std::vector<unsigned char> pattern;
+		std::vector<unsigned char> ignore;
+		size_t length = 0;
+
+		// The offsets of the two rarest bytes, the candidate filter. They are the same offset if the signature is a single byte.
+		size_t anchor1 = 0;
+		size_t anchor2 = 0;
+
+		static int hexDigit(const char c)
+		{
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+			if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+			return -1;
+		}
+
+		// How rare a byte is expected to be in x64 code, higher is rarer.
+		// Fully compared bytes rank above partially ignored ones, which rank by how many bits are compared.
+		static int rarity(const unsigned char byte, const unsigned char ignore)
+		{
+			// the most common bytes in x64 code, most common first
+			static constexpr unsigned char common[] = {
+				0x00, 0x48, 0x8B, 0xFF, 0x83, 0x41, 0x24, 0x89, 0xE8, 0x0F, 0x01, 0x8D, 0x74, 0x44, 0xC0, 0xCC,
+				0x4C, 0x85, 0x08, 0x20, 0x75, 0xC3, 0x49, 0x45, 0x33, 0xEB, 0x02, 0x10, 0x03, 0x04, 0xC1, 0x40,
+				0x66, 0x3B, 0x30, 0x84, 0xE9, 0xC7, 0x05, 0xF8, 0xC4, 0x4D, 0xC9, 0xEC, 0xC8, 0x07, 0x5C, 0x38,
+				0x28, 0x06, 0x18, 0x15, 0x43, 0xFE, 0x80, 0x50, 0xD2, 0xB8, 0xC2, 0x0D, 0x0A, 0x09, 0x39, 0x42
+			};
+
+			if (!!ignore) {
+				int comparedBits = 0;
+				for (int bit = 0; bit < 8; bit++) comparedBits += !(ignore >> bit & 1);
+				return comparedBits;
+			}
+
+			const unsigned char* rank = std::find(std::begin(common), std::end(common), byte);
+			return 8 + static_cast<int>(rank - std::begin(common)) + (rank == std::end(common) ? 1 : 0);
+		}
+
+		void initialize(const unsigned char* bytes, const unsigned char* ignore, const size_t length)
+		{
+			if (!length) throw std::runtime_error("Empty signature.");
+
+			const size_t padded = (length + 31) & ~static_cast<size_t>(31);
+			this->length = length;
+			this->pattern.assign(padded, 0xFF);
+			this->ignore.assign(padded, 0xFF);
+
+			for (size_t i = 0; i < length; i++) {
+				this->ignore[i] = ignore[i];
+				this->pattern[i] = bytes[i] | ignore[i];
+			}
+
+			// the rarest byte, then the rarest byte at another offset
+			auto rarer = [&](size_t a, size_t b) { return rarity(bytes[a], ignore[a]) > rarity(bytes[b], ignore[b]); };
+			this->anchor1 = 0;
+			for (size_t i = 1; i < length; i++) {
+				if (rarer(i, this->anchor1)) this->anchor1 = i;
+			}
+
+			this->anchor2 = this->anchor1;
+			for (size_t i = 0; i < length; i++) {
+				if (i != this->anchor1 && (this->anchor2 == this->anchor1 || rarer(i, this->anchor2))) this->anchor2 = i;
+			}
+		}
+	};
+
+	enum class Mode {
+		First, // stop at the first match
+		All // find every match
+	};
+
+	/// <summary>
+	/// Static. Scans a block of memory for a signature. Matches may overlap. Nothing outside of [begin, end) is read.
+	/// </summary>
+	/// <param name="signature">: the signature to find</param>
+	/// <param name="begin">: start of the memory to scan</param>
+	/// <param name="end">: end of the memory to scan, exclusive</param>
+	/// <param name="mode">: (optional) whether to find every match or only the first one</param>
+	/// <returns>the addresses of the matches in ascending order, empty if there are none</returns>
+	static std::vector<unsigned char*> scan(const Signature& signature, unsigned char* begin, unsigned char* end, const Mode mode = Mode::All)
+	{
+		std::vector<unsigned char*> matches;
+		if (end > begin && static_cast<size_t>(end - begin) >= signature.size()) {
+			scanKernel(signature, begin, end, mode == Mode::First, matches);
+		}
+		return matches;
+	}
+
+	/// <summary>
+	/// Static. Scans sections for a signature, e.g. the ranges from PEParser::getSectionRanges(".text"). A match can not span two ranges.
+	/// </summary>
+	/// <param name="signature">: the signature to find</param>
+	/// <param name="sections">: the sections to scan</param>
+	/// <param name="mode">: (optional) whether to find every match or only the first one</param>
+	/// <returns>the addresses of the matches in ascending order, empty if there are none or sections is nullptr</returns>
+	static std::vector<unsigned char*> scan(const Signature& signature, const PEParser::SectionRanges* sections, const Mode mode = Mode::All)
+	{
+		std::vector<unsigned char*> matches;
+		if (!sections) return matches;
+
+		for (auto& range : sections->getRanges()) {
+			auto found = scan(signature, reinterpret_cast<unsigned char*>(range.start), reinterpret_cast<unsigned char*>(range.end), mode);
+			matches.insert(matches.end(), found.begin(), found.end());
+			if (mode == Mode::First && !matches.empty()) break;
+		}
+
+		return matches;
+	}
+
+	/// <summary>
+	/// Static. Finds the first match of a signature in sections.
+	/// </summary>
+	/// <returns>the address of the first match, nullptr if there is none</returns>
+	static unsigned char* findFirst(const Signature& signature, const PEParser::SectionRanges* sections)
+	{
+		auto found = scan(signature, sections, Mode::First);
+		return found.empty() ? nullptr : found.front();
+	}
+
+	/// <summary>
+	/// A set of signatures to scan for in a single pass.
+	/// Every signature contributes a fingerprint of up to 4 consecutive bytes, its rarest ones. The signatures are split into 8 buckets,
+	/// and a position is only a candidate for the signatures of a bucket if its bytes are compatible with a fingerprint in the bucket.
+	/// Fingerprints are sized per signature: a signature shorter than 4 bytes accepts any byte past its end, so it does not shorten
+	/// the fingerprints of the others, but it does weaken the prefilter of its own bucket.
+	/// The check is done on the low and high nibble of each byte with table lookups (a "Teddy" prefilter), 16 or 32 positions at a time.
+	/// </summary>
+	class SignatureSet {
+	public:
+		/// <summary>
+		/// Prepares the fingerprint tables for a set of signatures. Throws if the set is empty.
+		/// </summary>
+		/// <param name="signatures">: the signatures to scan for, results are reported in the same order</param>
+		SignatureSet(std::vector<Signature> signatures) : signatures(std::move(signatures))
+		{
+			if (this->signatures.empty()) throw std::runtime_error("Empty signature set.");
+
+			this->fingerprintSize = 0;
+			this->minFingerprintSize = maxFingerprintSize;
+			for (const Signature& signature : this->signatures) {
+				this->fingerprintSize = (std::max)(this->fingerprintSize, (std::min)(maxFingerprintSize, signature.size()));
+				this->minFingerprintSize = (std::min)(this->minFingerprintSize, signature.size());
+			}
+
+			// the offset of the rarest run of fingerprint bytes in each signature
+			for (const Signature& signature : this->signatures) {
+				const size_t size = (std::min)(this->fingerprintSize, signature.size());
+				size_t bestOffset = 0;
+				int bestRarity = -1;
+				for (size_t offset = 0; offset + size <= signature.size(); offset++) {
+					int rarity = 0;
+					for (size_t k = 0; k < size; k++) {
+						rarity += Signature::rarity(signature.pattern[offset + k] & ~signature.ignore[offset + k], signature.ignore[offset + k]);
+					}
+					if (rarity > bestRarity) {
+						bestRarity = rarity;
+						bestOffset = offset;
+					}
+				}
+				this->offsets.push_back(bestOffset);
+
+				// the fingerprint bytes packed for a single compare, unused bytes are ignored
+				Fingerprint fingerprint = { 0xFFFFFFFF, 0xFFFFFFFF };
+				for (size_t k = 0; k < size; k++) {
+					fingerprint.pattern = (fingerprint.pattern & ~(0xFFu << k * 8)) | static_cast<uint32_t>(signature.pattern[bestOffset + k]) << k * 8;
+					fingerprint.ignore = (fingerprint.ignore & ~(0xFFu << k * 8)) | static_cast<uint32_t>(signature.ignore[bestOffset + k]) << k * 8;
+				}
+				this->fingerprints.push_back(fingerprint);
+			}
+
+			// the nibble values compatible with each fingerprint byte of each signature, as bit sets. Bytes past the end of a short signature accept any value
+			std::vector<std::array<uint16_t, maxFingerprintSize * 2>> nibbleSets(this->signatures.size());
+			for (size_t index = 0; index < this->signatures.size(); index++) {
+				for (size_t k = 0; k < this->fingerprintSize; k++) {
+					if (k >= this->signatures[index].size()) {
+						nibbleSets[index][k * 2] = nibbleSets[index][k * 2 + 1] = 0xFFFF;
+						continue;
+					}
+
+					const unsigned char pattern = this->signatures[index].pattern[this->offsets[index] + k];
+					const unsigned char ignore = this->signatures[index].ignore[this->offsets[index] + k];
+					for (int nibble = 0; nibble < 16; nibble++) {
+						if ((nibble | (ignore & 0xF)) == (pattern & 0xF)) nibbleSets[index][k * 2] |= 1 << nibble;
+						if ((nibble | (ignore >> 4)) == (pattern >> 4)) nibbleSets[index][k * 2 + 1] |= 1 << nibble;
+					}
+				}
+			}
+
+			// The share of positions a bucket passes (assuming uniform nibbles) times the signatures it verifies, the expected verifications per position.
+			// Signatures are added weakest fingerprint first, each to the bucket it makes the least expensive,
+			// so weak fingerprints get buckets of their own instead of letting every position through for the signatures they share a bucket with
+			auto cost = [&](const std::array<uint16_t, maxFingerprintSize * 2>& sets, const size_t count) {
+				double passes = 1.0;
+				for (size_t i = 0; i < this->fingerprintSize * 2; i++) passes *= countBits(sets[i]) / 16.0;
+				return passes * count;
+			};
+
+			std::vector<size_t> order(this->signatures.size());
+			for (size_t i = 0; i < order.size(); i++) order[i] = i;
+			std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cost(nibbleSets[a], 1) > cost(nibbleSets[b], 1); });
+
+			std::array<uint16_t, maxFingerprintSize * 2> bucketSets[8] = {};
+			for (const size_t index : order) {
+				size_t best = 0;
+				double bestIncrease = 0.0;
+				for (size_t bucket = 0; bucket < 8; bucket++) {
+					std::array<uint16_t, maxFingerprintSize * 2> merged = bucketSets[bucket];
+					for (size_t i = 0; i < merged.size(); i++) merged[i] |= nibbleSets[index][i];
+
+					const double increase = cost(merged, this->buckets[bucket].size() + 1) - (this->buckets[bucket].empty() ? 0.0 : cost(bucketSets[bucket], this->buckets[bucket].size()));
+					if (bucket == 0 || increase < bestIncrease) {
+						best = bucket;
+						bestIncrease = increase;
+					}
+				}
+
+				this->buckets[best].push_back(index);
+				for (size_t i = 0; i < bucketSets[best].size(); i++) bucketSets[best][i] |= nibbleSets[index][i];
+			}
+
+			for (size_t bucket = 0; bucket < 8; bucket++) {
+				for (size_t k = 0; k < this->fingerprintSize; k++) {
+					for (int nibble = 0; nibble < 16; nibble++) {
+						if (bucketSets[bucket][k * 2] >> nibble & 1) this->lowNibbles[k][nibble] |= 1 << bucket;
+						if (bucketSets[bucket][k * 2 + 1] >> nibble & 1) this->highNibbles[k][nibble] |= 1 << bucket;
+					}
+				}
+			}
+
+			for (size_t k = 0; k < this->fingerprintSize; k++) {
+				for (int byte = 0; byte < 256; byte++) {
+					this->byteBuckets[k][byte] = this->lowNibbles[k][byte & 0xF] & this->highNibbles[k][byte >> 4];
+				}
+			}
+		}
+
+		size_t size() const { return this->signatures.size(); }
+		const Signature& operator [] (const size_t index) const { return this->signatures[index]; }
+
+	private:
+		friend class SignatureScanner;
+
+		static int countBits(unsigned int x)
+		{
+			int count = 0;
+			for (; x; x &= x - 1) count++;
+			return count;
+		}
+
+		// fingerprints are packed in 32 bits
+		static constexpr size_t maxFingerprintSize = 4;
+
+		struct Fingerprint {
+			uint32_t pattern;
+			uint32_t ignore;
+		};
+
+		std::vector<Signature> signatures;
+		// the offset of each signature's fingerprint, and its exact bytes, as the buckets only match nibbles
+		std::vector<size_t> offsets;
+		std::vector<Fingerprint> fingerprints;
+		std::vector<size_t> buckets[8];
+		// the bytes checked by the prefilter at each position, the longest fingerprint
+		size_t fingerprintSize;
+		// the shortest fingerprint, positions closer than this to the end can not match
+		size_t minFingerprintSize;
+
+		// for each fingerprint byte, the buckets compatible with a low or high nibble, and with a whole byte for the scalar path
+		alignas(16) unsigned char lowNibbles[maxFingerprintSize][16] = {};
+		alignas(16) unsigned char highNibbles[maxFingerprintSize][16] = {};
+		unsigned char byteBuckets[maxFingerprintSize][256] = {};
+	};
+
+	/// <summary>
+	/// Static. Scans a block of memory for every signature of a set in a single pass. Nothing outside of [begin, end) is read.
+	/// The block can be split into chunks scanned by several threads. A chunk owns the matches that start in it and reads past its end as far as they need,
+	/// so the results are identical to a single threaded scan.
+	/// Only use more than one thread outside of DllMain, see RTTIScanner::scan.
+	/// </summary>
+	/// <param name="signatures">: the signatures to find</param>
+	/// <param name="begin">: start of the memory to scan</param>
+	/// <param name="end">: end of the memory to scan, exclusive</param>
+	/// <param name="threadCount">: (optional) the number of threads to scan with, 1 by default, 0 for one per hardware thread</param>
+	/// <returns>for each signature in the set, the addresses of its matches in ascending order</returns>
+	static std::vector<std::vector<unsigned char*>> scan(const SignatureSet& signatures, unsigned char* begin, unsigned char* end, unsigned int threadCount = 1)
+	{
+		std::vector<std::vector<unsigned char*>> matches(signatures.size());
+		if (end <= begin || static_cast<size_t>(end - begin) < signatures.minFingerprintSize) return matches;
+
+		if (!threadCount) threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+		// chunks of fingerprint positions, a few per thread so that uneven chunks even out
+		const size_t positions = (end - begin) - signatures.minFingerprintSize + 1;
+		const size_t chunkCount = threadCount > 1 ? std::min<size_t>(threadCount * 4, std::max<size_t>(positions / (1 << 20), 1)) : 1;
+
+		std::vector<std::vector<std::vector<unsigned char*>>> chunkMatches(chunkCount, std::vector<std::vector<unsigned char*>>(signatures.size()));
+		auto scanChunk = [&](size_t chunk) {
+			scanSetKernel(signatures, begin + positions * chunk / chunkCount, begin + positions * (chunk + 1) / chunkCount, begin, end, chunkMatches[chunk]);
+		};
+
+		if (chunkCount > 1) {
+			std::vector<std::thread> threads;
+			std::atomic<size_t> next = 0;
+			for (unsigned int i = 0; i < threadCount && i < chunkCount; i++) {
+				threads.emplace_back([&]() {
+					for (size_t chunk = next++; chunk < chunkCount; chunk = next++) {
+						scanChunk(chunk);
+					}
+				});
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+		}
+		else {
+			scanChunk(0);
+		}
+
+		// chunks are in address order, and a signature's matches are in the order of their fingerprints
+		for (auto& chunk : chunkMatches) {
+			for (size_t i = 0; i < matches.size(); i++) {
+				matches[i].insert(matches[i].end(), chunk[i].begin(), chunk[i].end());
+			}
+		}
+
+		return matches;
+	}
+
+	/// <summary>
+	/// Static. Scans sections for every signature of a set in a single pass over each, e.g. the ranges from PEParser::getSectionRanges(".text").
+	/// A match can not span two ranges.
+	/// </summary>
+	/// <param name="signatures">: the signatures to find</param>
+	/// <param name="sections">: the sections to scan</param>
+	/// <param name="threadCount">: (optional) the number of threads to scan with, 1 by default, 0 for one per hardware thread</param>
+	/// <returns>for each signature in the set, the addresses of its matches in ascending order</returns>
+	static std::vector<std::vector<unsigned char*>> scan(const SignatureSet& signatures, const PEParser::SectionRanges* sections, const unsigned int threadCount = 1)
+	{
+		std::vector<std::vector<unsigned char*>> matches(signatures.size());
+		if (!sections) return matches;
+
+		for (auto& range : sections->getRanges()) {
+			auto found = scan(signatures, reinterpret_cast<unsigned char*>(range.start), reinterpret_cast<unsigned char*>(range.end), threadCount);
+			for (size_t i = 0; i < matches.size(); i++) {
+				matches[i].insert(matches[i].end(), found[i].begin(), found[i].end());
+			}
+		}
+
+		return matches;
+	}
+
+private:
+	typedef void ScanFn(const Signature& signature, unsigned char* begin, unsigned char* end, bool first, std::vector<unsigned char*>& matches);
+
+	// Checks the positions that are too close to the end for the SIMD loops, which read up to a padded signature length past a position.
+	static void scanTail(const Signature& signature, unsigned char* position, unsigned char* end, const bool first, std::vector<unsigned char*>& matches)
+	{
+		for (unsigned char* last = end - signature.size(); position <= last; position++) {
+			if (signature.matches(position)) {
+				matches.push_back(position);
+				if (first) return;
+			}
+		}
+	}
+
+	static int countTrailingZeros(const unsigned int x)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, x);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(x);
+#endif
+	}
+
+	static void scanSSE2(const Signature& signature, unsigned char* begin, unsigned char* end, const bool first, std::vector<unsigned char*>& matches)
+	{
+		const unsigned char* pattern = signature.pattern.data();
+		const unsigned char* ignore = signature.ignore.data();
+		const size_t anchor1 = signature.anchor1;
+		const size_t anchor2 = signature.anchor2;
+		const size_t verifySize = (signature.size() + 15) & ~static_cast<size_t>(15);
+
+		const __m128i pattern1 = _mm_set1_epi8(static_cast<char>(pattern[anchor1]));
+		const __m128i ignore1 = _mm_set1_epi8(static_cast<char>(ignore[anchor1]));
+		const __m128i pattern2 = _mm_set1_epi8(static_cast<char>(pattern[anchor2]));
+		const __m128i ignore2 = _mm_set1_epi8(static_cast<char>(ignore[anchor2]));
+
+		// 16 positions per iteration, every candidate in them can be verified without reading past the end
+		unsigned char* position = begin;
+		for (; static_cast<size_t>(end - position) >= 15 + verifySize; position += 16) {
+			const __m128i block1 = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(position + anchor1)), ignore1);
+			const __m128i block2 = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(position + anchor2)), ignore2);
+			unsigned int candidates = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block1, pattern1), _mm_cmpeq_epi8(block2, pattern2)));
+
+			while (candidates) {
+				unsigned char* candidate = position + countTrailingZeros(candidates);
+				candidates &= candidates - 1;
+
+				bool match = true;
+				for (size_t i = 0; match && i < verifySize; i += 16) {
+					const __m128i mem = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(candidate + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(ignore + i)));
+					match = _mm_movemask_epi8(_mm_cmpeq_epi8(mem, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + i)))) == 0xFFFF;
+				}
+
+				if (match) {
+					matches.push_back(candidate);
+					if (first) return;
+				}
+			}
+		}
+
+		scanTail(signature, position, end, first, matches);
+	}
+
+	CPUFEATURES_TARGET_AVX2 static void scanAVX2(const Signature& signature, unsigned char* begin, unsigned char* end, const bool first, std::vector<unsigned char*>& matches)
+	{
+		const unsigned char* pattern = signature.pattern.data();
+		const unsigned char* ignore = signature.ignore.data();
+		const size_t anchor1 = signature.anchor1;
+		const size_t anchor2 = signature.anchor2;
+		const size_t verifySize = (signature.size() + 31) & ~static_cast<size_t>(31);
+
+		const __m256i pattern1 = _mm256_set1_epi8(static_cast<char>(pattern[anchor1]));
+		const __m256i ignore1 = _mm256_set1_epi8(static_cast<char>(ignore[anchor1]));
+		const __m256i pattern2 = _mm256_set1_epi8(static_cast<char>(pattern[anchor2]));
+		const __m256i ignore2 = _mm256_set1_epi8(static_cast<char>(ignore[anchor2]));
+
+		// 32 positions per iteration, every candidate in them can be verified without reading past the end
+		unsigned char* position = begin;
+		for (; static_cast<size_t>(end - position) >= 31 + verifySize; position += 32) {
+			const __m256i block1 = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(position + anchor1)), ignore1);
+			const __m256i block2 = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(position + anchor2)), ignore2);
+			unsigned int candidates = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block1, pattern1), _mm256_cmpeq_epi8(block2, pattern2))));
+
+			while (candidates) {
+				unsigned char* candidate = position + countTrailingZeros(candidates);
+				candidates &= candidates - 1;
+
+				bool match = true;
+				for (size_t i = 0; match && i < verifySize; i += 32) {
+					const __m256i mem = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidate + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ignore + i)));
+					match = _mm256_movemask_epi8(_mm256_cmpeq_epi8(mem, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern + i)))) == -1;
+				}
+
+				if (match) {
+					matches.push_back(candidate);
+					if (first) return;
+				}
+			}
+		}
+
+		scanTail(signature, position, end, first, matches);
+	}
+
+	static inline const CPUFeatures::Kernel<ScanFn> scanKernel{ &SignatureScanner::scanSSE2, nullptr, &SignatureScanner::scanAVX2 };
+
+	// Set kernels: fingerprint positions in [chunkBegin, chunkEnd) are checked, matches are verified within [begin, end).
+	typedef void ScanSetFn(const SignatureSet& signatures, unsigned char* chunkBegin, unsigned char* chunkEnd, unsigned char* begin, unsigned char* end, std::vector<std::vector<unsigned char*>>& matches);
+
+	// Verifies the signatures of the buckets a fingerprint position is a candidate for.
+	static void verifyBuckets(const SignatureSet& signatures, unsigned int buckets, unsigned char* position, unsigned char* begin, unsigned char* end, std::vector<std::vector<unsigned char*>>& matches)
+	{
+		while (buckets) {
+			const int bucket = countTrailingZeros(buckets);
+			buckets &= buckets - 1;
+
+			for (const size_t index : signatures.buckets[bucket]) {
+				const Signature& signature = signatures.signatures[index];
+				const size_t offset = signatures.offsets[index];
+				if (static_cast<size_t>(position - begin) < offset || static_cast<size_t>(end - position) < signature.size() - offset) continue;
+
+				// rule out nibble combinations of different signatures in the bucket before comparing the whole signature
+				uint32_t fingerprint = 0;
+				if (end - position >= 4) memcpy(&fingerprint, position, 4);
+				else memcpy(&fingerprint, position, end - position);
+				if ((fingerprint | signatures.fingerprints[index].ignore) != signatures.fingerprints[index].pattern) continue;
+
+				unsigned char* candidate = position - offset;
+				if (signature.matches(candidate)) matches[index].push_back(candidate);
+			}
+		}
+	}
+
+	static void scanSetScalar(const SignatureSet& signatures, unsigned char* chunkBegin, unsigned char* chunkEnd, unsigned char* begin, unsigned char* end, std::vector<std::vector<unsigned char*>>& matches)
+	{
+		// near the end of the block only the bytes left are checked, verifyBuckets rules out the signatures that do not fit
+		for (unsigned char* position = chunkBegin; position < chunkEnd; position++) {
+			const size_t size = std::min<size_t>(signatures.fingerprintSize, end - position);
+			unsigned int buckets = signatures.byteBuckets[0][position[0]];
+			for (size_t k = 1; buckets && k < size; k++) {
+				buckets &= signatures.byteBuckets[k][position[k]];
+			}
+
+			if (buckets) verifyBuckets(signatures, buckets, position, begin, end, matches);
+		}
+	}
+
+	CPUFEATURES_TARGET_SSE41 static void scanSetSSE41(const SignatureSet& signatures, unsigned char* chunkBegin, unsigned char* chunkEnd, unsigned char* begin, unsigned char* end, std::vector<std::vector<unsigned char*>>& matches)
+	{
+		const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+		__m128i low[SignatureSet::maxFingerprintSize], high[SignatureSet::maxFingerprintSize];
+		for (size_t k = 0; k < SignatureSet::maxFingerprintSize; k++) {
+			low[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(signatures.lowNibbles[k]));
+			high[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(signatures.highNibbles[k]));
+		}
+
+		// 16 positions per iteration, the loads for the last fingerprint byte must end within the block
+		const size_t readSize = 15 + signatures.fingerprintSize;
+		unsigned char* position = chunkBegin;
+		for (; position < chunkEnd && static_cast<size_t>(end - position) >= readSize; position += 16) {
+			__m128i buckets = _mm_set1_epi8(-1);
+			for (size_t k = 0; k < signatures.fingerprintSize; k++) {
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position + k));
+				const __m128i lowBuckets = _mm_shuffle_epi8(low[k], _mm_and_si128(block, nibbleMask));
+				const __m128i highBuckets = _mm_shuffle_epi8(high[k], _mm_and_si128(_mm_srli_epi16(block, 4), nibbleMask));
+				buckets = _mm_and_si128(buckets, _mm_and_si128(lowBuckets, highBuckets));
+			}
+
+			// positions past the chunk end belong to the next chunk
+			unsigned int candidates = ~_mm_movemask_epi8(_mm_cmpeq_epi8(buckets, _mm_setzero_si128())) & 0xFFFF;
+			if (static_cast<size_t>(chunkEnd - position) < 16) candidates &= (1u << (chunkEnd - position)) - 1;
+			if (!candidates) continue;
+
+			alignas(16) unsigned char bucketBytes[16];
+			_mm_store_si128(reinterpret_cast<__m128i*>(bucketBytes), buckets);
+			while (candidates) {
+				const int i = countTrailingZeros(candidates);
+				candidates &= candidates - 1;
+				verifyBuckets(signatures, bucketBytes[i], position + i, begin, end, matches);
+			}
+		}
+
+		if (position < chunkEnd) scanSetScalar(signatures, position, chunkEnd, begin, end, matches);
+	}
+
+	CPUFEATURES_TARGET_AVX2 static void scanSetAVX2(const SignatureSet& signatures, unsigned char* chunkBegin, unsigned char* chunkEnd, unsigned char* begin, unsigned char* end, std::vector<std::vector<unsigned char*>>& matches)
+	{
+		// the shuffles look up within each 128-bit lane, so the tables are in both lanes
+		const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+		__m256i low[SignatureSet::maxFingerprintSize], high[SignatureSet::maxFingerprintSize];
+		for (size_t k = 0; k < SignatureSet::maxFingerprintSize; k++) {
+			low[k] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(signatures.lowNibbles[k])));
+			high[k] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(signatures.highNibbles[k])));
+		}
+
+		// 32 positions per iteration, the loads for the last fingerprint byte must end within the block
+		const size_t readSize = 31 + signatures.fingerprintSize;
+		unsigned char* position = chunkBegin;
+		for (; position < chunkEnd && static_cast<size_t>(end - position) >= readSize; position += 32) {
+			__m256i buckets = _mm256_set1_epi8(-1);
+			for (size_t k = 0; k < signatures.fingerprintSize; k++) {
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(position + k));
+				const __m256i lowBuckets = _mm256_shuffle_epi8(low[k], _mm256_and_si256(block, nibbleMask));
+				const __m256i highBuckets = _mm256_shuffle_epi8(high[k], _mm256_and_si256(_mm256_srli_epi16(block, 4), nibbleMask));
+				buckets = _mm256_and_si256(buckets, _mm256_and_si256(lowBuckets, highBuckets));
+			}
+
+			// positions past the chunk end belong to the next chunk
+			unsigned int candidates = ~static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(buckets, _mm256_setzero_si256())));
+			if (static_cast<size_t>(chunkEnd - position) < 32) candidates &= (1u << (chunkEnd - position)) - 1;
+			if (!candidates) continue;
+
+			alignas(32) unsigned char bucketBytes[32];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(bucketBytes), buckets);
+			while (candidates) {
+				const int i = countTrailingZeros(candidates);
+				candidates &= candidates - 1;
+				verifyBuckets(signatures, bucketBytes[i], position + i, begin, end, matches);
+			}
+		}
+
+		if (position < chunkEnd) scanSetScalar(signatures, position, chunkEnd, begin, end, matches);
+	}
+
+	static inline const CPUFeatures::Kernel<ScanSetFn> scanSetKernel{ &SignatureScanner::scanSetScalar, &SignatureScanner::scanSetSSE41, &SignatureScanner::scanSetAVX2 };
+};
@@ -6,7 +6,10 @@
 #include <algorithm>
 #include <immintrin.h>
 
-#define is16Aligned(mem) ( reinterpret_cast<uintptr_t>(mem) & 15 == 0 )
+#include "VxDApprox.h"
+#include "CPUFeatures.h"
+
+#define is16Aligned(mem) ( (reinterpret_cast<uintptr_t>(mem) & 15) == 0 )
 
 #define UMTX { { { 1.0f, 0.0f, 0.0f, 0.0f },\
 				 { 0.0f, 1.0f, 0.0f, 0.0f },\
@@ -63,8 +66,7 @@ public:
 
 	V4D(const float f0, const float f1, const float f2)
 	{
-		__m128 v = _mm_set_ps(f2, f2, f1, f0);
-		this->v4 = _mm_insert_ps(v, _mm_setzero_ps(), 0b00110000);
+		this->v4 = _mm_set_ps(0.0f, f2, f1, f0);
 	}
 
 	V4D(const float f)
@@ -76,8 +78,8 @@ public:
 	{
 		const float halfa = angle * 0.5f;
 
-		__m128 v = _mm_mul_ps(axis, _mm_set1_ps(sinf(halfa)));
-		this->v4 = _mm_insert_ps(v, _mm_set_ss(cosf(halfa)), 0b00110000);
+		__m128 v = _mm_mul_ps(axis.flatten<W>(), _mm_set1_ps(sinf(halfa)));
+		this->v4 = _mm_add_ps(v, _mm_set_ps(cosf(halfa), 0.0f, 0.0f, 0.0f));
 	}
 
 	V4D(const V4D v1, const V4D v2)
@@ -173,12 +175,12 @@ public:
 
 	bool iszero() const
 	{
-		return _mm_testz_si128(*this, *this);
+		return _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_castps_si128(*this), _mm_setzero_si128())) == 0xFFFF;
 	}
 
 	__m128 hadd() const // https://stackoverflow.com/questions/6996764/fastest-way-to-do-horizontal-sse-vector-sum-or-other-reduction#:~:text=for%20the%20optimizer.-,SSE3,-float%20hsum_ps_sse3(__m128
 	{
-		__m128 sumsh = _mm_movehdup_ps(*this);
+		__m128 sumsh = _mm_shuffle_ps(*this, *this, _MM_SHUFFLE(3, 3, 1, 1));
 		__m128 shsum = _mm_add_ps(*this, sumsh);
 		sumsh = _mm_movehl_ps(sumsh, shsum);
 		shsum = _mm_add_ss(shsum, sumsh);
@@ -240,7 +242,7 @@ public:
 
 	template <CoordinateAxis A = Z, bool Normalize = false> V4D flatten() const
 	{
-		V4D v = _mm_insert_ps(*this, _mm_setzero_ps(), A << 4);
+		V4D v = _mm_and_ps(*this, _mm_castsi128_ps(_mm_set_epi32(-(A != W), -(A != Y), -(A != Z), -(A != X))));
 
 		if constexpr (Normalize) {
 			return v.normalize();
@@ -280,7 +282,7 @@ public:
 	{
 		const float k = -1.0f;
 
-		if (!_mm_testz_si128(_mm_castps_si128(_mm_mul_ps(*this, v)), _mm_set1_epi32(0x80000000))) {
+		if (_mm_movemask_ps(_mm_mul_ps(*this, v))) {
 			return k;
 		}
 		else {
@@ -293,92 +295,74 @@ public:
 		return _mm_xor_ps(*this, _mm_set_ps(0.0f, -0.0f, -0.0f, -0.0f));
 	}
 
+	// Rotates this vector by the quaternion v. https://fgiesen.wordpress.com/2019/02/09/rotating-a-single-vector-using-a-quaternion/
 	V4D qTransform(const V4D v) const
 	{
-		const float v0 = v[0];
-		const float v1 = v[1];
-		const float v2 = v[2];
-		const float v3 = v[3];
-
-		const float v_0 = (*this)[0];
-		const float v_1 = (*this)[1];
-		const float v_2 = (*this)[2];
+		__m128 t = v.cross(*this);
+		t = _mm_add_ps(t, t);
 
-		const float v3v3_ = v3 * v3 - 0.5f;
+		__m128 result = _mm_add_ps(*this, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), t));
+		result = _mm_add_ps(result, v.cross(t));
 
-		const float v0v1 = v[0] * v[1];
-		const float v0v2 = v[0] * v[2];
-		const float v0v3 = v[0] * v[3];
+		return _mm_and_ps(result, _mm_castsi128_ps(_mm_set_epi32(0x0, -1, -1, -1)));
+	}
 
-		const float v1v2 = v[1] * v[2];
-		const float v1v3 = v[1] * v[3];
+	// Hamilton product, with the conjugate's signs folded into the masks for qDiv.
+	template <bool Conjugate = false> V4D qMulImpl(const V4D v) const
+	{
+		// Make sure the signed zeroes are not optimized away (looking at you MSVC)
+		const __m128 signW = Conjugate ? _mm_castsi128_ps(_mm_set_epi32(0x0, 0x80000000, 0x80000000, 0x80000000)) : _mm_setzero_ps();
+		const __m128 signX = Conjugate ? _mm_castsi128_ps(_mm_set_epi32(0x0, 0x80000000, 0x0, 0x0)) : _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0x0, 0x80000000, 0x0));
+		const __m128 signY = Conjugate ? _mm_castsi128_ps(_mm_set_epi32(0x0, 0x0, 0x0, 0x80000000)) : _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0x80000000, 0x0, 0x0));
+		const __m128 signZ = Conjugate ? _mm_castsi128_ps(_mm_set_epi32(0x0, 0x0, 0x80000000, 0x0)) : _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0x0, 0x0, 0x80000000));
 
-		const float v2v3 = v[2] * v[3];
+		__m128 result = _mm_mul_ps(_mm_shuffle_ps(*this, *this, _MM_SHUFFLE(3, 3, 3, 3)), _mm_xor_ps(v, signW));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(*this, *this, _MM_SHUFFLE(0, 0, 0, 0)), _mm_xor_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3)), signX)));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(*this, *this, _MM_SHUFFLE(1, 1, 1, 1)), _mm_xor_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)), signY)));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(*this, *this, _MM_SHUFFLE(2, 2, 2, 2)), _mm_xor_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), signZ)));
 
-		return V4D(2.0f * (v_0 * (v0 * v0 + v3v3_) + v_1 * (v0v1 - v2v3) + v_2 * (v0v2 + v1v3)),
-			2.0f * (v_0 * (v0v1 + v2v3) + v_1 * (v1 * v1 + v3v3_) + v_2 * (v1v2 - v0v3)),
-			2.0f * (v_0 * (v0v2 - v1v3) + v_1 * (v1v2 + v0v3) + v_2 * (v2 * v2 + v3v3_)));
+		return result;
 	}
 
 	V4D qMul(const V4D v) const
 	{
-		const float v0 = (*this)[0];
-		const float v1 = (*this)[1];
-		const float v2 = (*this)[2];
-		const float v3 = (*this)[3];
-
-		const float v_0 = v[0];
-		const float v_1 = v[1];
-		const float v_2 = v[2];
-		const float v_3 = v[3];
-
-		return V4D(v3 * v_0 + v0 * v_3 + v1 * v_2 - v2 * v_1,
-			v3 * v_1 - v0 * v_2 + v1 * v_3 + v2 * v_0,
-			v3 * v_2 + v0 * v_1 - v1 * v_0 + v2 * v_3,
-			v3 * v_3 - v0 * v_0 - v1 * v_1 - v2 * v_2);
+		return this->qMulImpl<false>(v);
 	}
 
+	// Multiplies by the conjugate of v, equal to this->qMul(v.qConjugate()).
 	V4D qDiv(const V4D v) const
 	{
-		const float v0 = (*this)[0];
-		const float v1 = (*this)[1];
-		const float v2 = (*this)[2];
-		const float v3 = (*this)[3];
-
-		const float v_0 = v[0];
-		const float v_1 = v[1];
-		const float v_2 = v[2];
-		const float v_3 = v[3];
-
-		return V4D(v_3 * v0 - v_0 * v3 + v_1 * v2 - v_2 * v1,
-			v_3 * v1 - v_0 * v2 - v_1 * v3 + v_2 * v0,
-			v_3 * v2 + v_0 * v1 - v_1 * v0 - v_2 * v3,
-			v_3 * v3 + v_0 * v0 + v_1 * v1 + v_2 * v2);
+		return this->qMulImpl<true>(v);
 	}
 
-	V4D qPow(const float pow) const
+	// Fast uses the polynomial approximations in VxD::Approx instead of the C runtime, see VxDApprox.h.
+	template <bool Fast = VXD_FAST_TRANSCENDENTALS_DEFAULT> V4D qPow(const float pow) const
 	{
 		const float logFV = this->dot3(*this);
 		const float logRV = sqrtf(logFV);
 		const float logFR = (*this)[3];
 
-		const float logS = logRV > FLT_EPSILON ? atan2f(logRV, logFR) / logRV : 0.0f;
+		const float logS = logRV > FLT_EPSILON ? (Fast ? VxD::Approx::atan2(logRV, logFR) : atan2f(logRV, logFR)) / logRV : 0.0f;
 		V4D logQ = *this * logS;
-		logQ[3] = logf(logFV + logFR * logFR) / 2.0f;
+		logQ[3] = (Fast ? VxD::Approx::log(logFV + logFR * logFR) : logf(logFV + logFR * logFR)) / 2.0f;
 		logQ *= pow;
 
 		const float expFV = logQ.dot3(logQ);
 		const float expRV = sqrtf(expFV);
-		const float expRR = expf(logQ[3]);
+		const float expRR = Fast ? VxD::Approx::exp(logQ[3]) : expf(logQ[3]);
 
-		const float expS = expRV > FLT_EPSILON ? expRR * sinf(expRV) / expRV : 0.0f;
+		float sinRV, cosRV;
+		if constexpr (Fast) VxD::Approx::sincos(expRV, sinRV, cosRV);
+		else sinRV = sinf(expRV), cosRV = cosf(expRV);
+
+		const float expS = expRV > FLT_EPSILON ? expRR * sinRV / expRV : 0.0f;
 		logQ *= expS;
-		logQ[3] = expRR * cosf(expRV);
+		logQ[3] = expRR * cosRV;
 
 		return logQ;
 	}
 
-	V4D qSlerp(const V4D v, const float t) const // http://number-none.com/product/Understanding%20Slerp,%20Then%20Not%20Using%20It/
+	template <bool Fast = VXD_FAST_TRANSCENDENTALS_DEFAULT> V4D qSlerp(const V4D v, const float t) const // http://number-none.com/product/Understanding%20Slerp,%20Then%20Not%20Using%20It/
 	{
 		float dot = *this * v;
 
@@ -388,12 +372,47 @@ public:
 		}
 
 		dot = std::clamp(dot, -1.0f, 1.0f);
-		float theta_0 = acosf(dot);
+		float theta_0 = Fast ? VxD::Approx::acos(dot) : acosf(dot);
 		float theta = theta_0 * t;
 
 		V4D v_ = v - *this * dot;
 
-		return *this * cosf(theta) + v_.normalize() * sinf(theta);
+		float sinTheta, cosTheta;
+		if constexpr (Fast) VxD::Approx::sincos(theta, sinTheta, cosTheta);
+		else sinTheta = sinf(theta), cosTheta = cosf(theta);
+
+		return *this * cosTheta + v_.normalize() * sinTheta;
+	}
+
+	V4D qNlerp(const V4D v, const float t) const
+	{
+		// Interpolate along the shorter arc, q and -q represent the same rotation.
+		V4D v_ = *this * v < 0.0f ? v.qNegate() : v;
+
+		return (*this + (v_ - *this) * t).normalize();
+	}
+
+	V4D qNegate() const
+	{
+		return _mm_xor_ps(*this, _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+	}
+
+	// The shortest arc rotation from this direction to another, both must be normalized.
+	V4D qFromTo(const V4D v) const
+	{
+		const float dot = this->dot3(v);
+
+		if (dot < -0.9999f) {
+			// Opposite directions, rotate half a turn around any perpendicular axis.
+			V4D axis = this->cross(V4D(1.0f, 0.0f, 0.0f));
+			if (axis.length2() < 1e-6f) axis = this->cross(V4D(0.0f, 1.0f, 0.0f));
+			return V4D(axis.normalize(), 3.14159265f);
+		}
+
+		V4D q = this->cross(v);
+		q[3] = 1.0f + dot;
+
+		return q.normalize();
 	}
 
 	static V4D vmtxToQ(ViewMatrix* vmtx) // https://www.euclideanspace.com/maths/geometry/rotations/conversions/matrixToQuaternion/#:~:text=z%20%3D%200.25f%20*%20s%3B%0A%20%20%20%20%7D%0A%20%20%7D%0A%7D-,Alternative%20Method,-Christian%20has%20suggested
@@ -427,4 +446,562 @@ public:
 
 		return result;
 	}
-};
\ No newline at end of file
+};
+
+// QuatX8 is available when the compiler accepts AVX intrinsics everywhere. MSVC always does, its use must be gated by a runtime CPU check.
+// The AVX2 batch kernels below do not depend on it, they are compiled for AVX2 on their own, see CPUFEATURES_TARGET_AVX2.
+#if defined(__AVX__) || defined(_MSC_VER)
+#define VXD_AVX_PACKETS
+#endif
+
+namespace VxD {
+	namespace Impl {
+		// Lane-generic wrappers so that packet math can be written once for SSE and AVX registers.
+		inline __m128 set1(__m128, const float f) { return _mm_set1_ps(f); }
+		inline __m128 add(const __m128 a, const __m128 b) { return _mm_add_ps(a, b); }
+		inline __m128 sub(const __m128 a, const __m128 b) { return _mm_sub_ps(a, b); }
+		inline __m128 mul(const __m128 a, const __m128 b) { return _mm_mul_ps(a, b); }
+		inline __m128 div(const __m128 a, const __m128 b) { return _mm_div_ps(a, b); }
+		inline __m128 sqrt(const __m128 a) { return _mm_sqrt_ps(a); }
+		inline __m128 bitAnd(const __m128 a, const __m128 b) { return _mm_and_ps(a, b); }
+		inline __m128 bitXor(const __m128 a, const __m128 b) { return _mm_xor_ps(a, b); }
+		inline __m128 signMask(__m128) { return _mm_castsi128_ps(_mm_set1_epi32(0x80000000)); }
+		inline __m128 load(__m128, const float* f) { return _mm_loadu_ps(f); }
+		inline __m128 rsqrt(const __m128 a) { return _mm_rsqrt_ps(a); }
+		inline __m128 cmpgt(const __m128 a, const __m128 b) { return _mm_cmpgt_ps(a, b); }
+		inline __m128 cmplt(const __m128 a, const __m128 b) { return _mm_cmplt_ps(a, b); }
+
+#ifdef VXD_AVX_PACKETS
+		inline __m256 set1(__m256, const float f) { return _mm256_set1_ps(f); }
+		inline __m256 add(const __m256 a, const __m256 b) { return _mm256_add_ps(a, b); }
+		inline __m256 sub(const __m256 a, const __m256 b) { return _mm256_sub_ps(a, b); }
+		inline __m256 mul(const __m256 a, const __m256 b) { return _mm256_mul_ps(a, b); }
+		inline __m256 div(const __m256 a, const __m256 b) { return _mm256_div_ps(a, b); }
+		inline __m256 sqrt(const __m256 a) { return _mm256_sqrt_ps(a); }
+		inline __m256 bitAnd(const __m256 a, const __m256 b) { return _mm256_and_ps(a, b); }
+		inline __m256 bitXor(const __m256 a, const __m256 b) { return _mm256_xor_ps(a, b); }
+		inline __m256 signMask(__m256) { return _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000)); }
+		inline __m256 load(__m256, const float* f) { return _mm256_loadu_ps(f); }
+		inline __m256 rsqrt(const __m256 a) { return _mm256_rsqrt_ps(a); }
+		inline __m256 cmpgt(const __m256 a, const __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		inline __m256 cmplt(const __m256 a, const __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+#endif
+	}
+
+	namespace Impl {
+		// The register type of a packet width. Packets are templated on the width rather than on the register type,
+		// since GCC drops the attributes of vector types used as template arguments.
+		template <int Width> struct PacketRegister;
+		template <> struct PacketRegister<4> { using type = __m128; };
+#ifdef VXD_AVX_PACKETS
+		template <> struct PacketRegister<8> { using type = __m256; };
+#endif
+	}
+
+	// A packet of quaternions or vectors in structure of arrays form: every register holds one component of all elements.
+	// Components follow the V4D lane order (x, z, y, w), vectors have w set to zero.
+	// Use QuatX4 (SSE) or QuatX8 (AVX) rather than this template directly.
+	template <int Width> class QuatPacket {
+	public:
+		using Reg = typename Impl::PacketRegister<Width>::type;
+		static constexpr int width = Width;
+
+		Reg x, z, y, w;
+
+		QuatPacket() : x(), z(), y(), w() {}
+		QuatPacket(const Reg x, const Reg z, const Reg y, const Reg w) : x(x), z(z), y(y), w(w) {}
+
+		// A packet with every element set to the same value.
+		static QuatPacket broadcast(const V4D v)
+		{
+			const Reg r{};
+			return QuatPacket(Impl::set1(r, v[0]), Impl::set1(r, v[1]), Impl::set1(r, v[2]), Impl::set1(r, v[3]));
+		}
+
+		static QuatPacket identity() { return broadcast(V4D(0.0f, 0.0f, 0.0f, 1.0f)); }
+
+		// Gathers elements from an array of pointers, for example into the game's HkBoneData (see HkSkeleton).
+		static QuatPacket gather(const V4D* const* elements);
+
+		// Gathers consecutive elements that are Stride bytes apart, for example the qSpatial of consecutive bones with sizeof(HkBoneData).
+		template <size_t Stride = sizeof(V4D)> static QuatPacket load(const V4D* first)
+		{
+			const V4D* elements[width];
+			for (int i = 0; i < width; i++) {
+				elements[i] = reinterpret_cast<const V4D*>(reinterpret_cast<const unsigned char*>(first) + i * Stride);
+			}
+			return gather(elements);
+		}
+
+		// Scatters the elements back into an array of pointers. Only the first count elements are written.
+		void scatter(V4D* const* elements, const int count = width) const;
+
+		template <size_t Stride = sizeof(V4D)> void store(V4D* first, const int count = width) const
+		{
+			V4D* elements[width];
+			for (int i = 0; i < width; i++) {
+				elements[i] = reinterpret_cast<V4D*>(reinterpret_cast<unsigned char*>(first) + i * Stride);
+			}
+			this->scatter(elements, count);
+		}
+
+		Reg dot(const QuatPacket& q) const
+		{
+			using namespace Impl;
+			return add(add(mul(x, q.x), mul(z, q.z)), add(mul(y, q.y), mul(w, q.w)));
+		}
+
+		QuatPacket qConjugate() const
+		{
+			const Reg sign = Impl::signMask(x);
+			return QuatPacket(Impl::bitXor(x, sign), Impl::bitXor(z, sign), Impl::bitXor(y, sign), w);
+		}
+
+		// Hamilton product of every pair of elements, matching V4D::qMul.
+		QuatPacket qMul(const QuatPacket& q) const
+		{
+			using namespace Impl;
+			return QuatPacket(
+				add(sub(add(mul(w, q.x), mul(x, q.w)), mul(y, q.z)), mul(z, q.y)),
+				add(sub(add(mul(w, q.z), mul(z, q.w)), mul(x, q.y)), mul(y, q.x)),
+				add(sub(add(mul(w, q.y), mul(y, q.w)), mul(z, q.x)), mul(x, q.z)),
+				sub(sub(sub(mul(w, q.w), mul(x, q.x)), mul(z, q.z)), mul(y, q.y)));
+		}
+
+		// Rotates vectors by the quaternions in q, matching V4D::qTransform.
+		QuatPacket qTransform(const QuatPacket& q) const
+		{
+			using namespace Impl;
+			const Reg two = set1(x, 2.0f);
+
+			// t = 2 * cross(q, v), result = v + q.w * t + cross(q, t)
+			const Reg tx = mul(two, sub(mul(q.z, y), mul(q.y, z)));
+			const Reg tz = mul(two, sub(mul(q.y, x), mul(q.x, y)));
+			const Reg ty = mul(two, sub(mul(q.x, z), mul(q.z, x)));
+
+			return QuatPacket(
+				add(add(x, mul(q.w, tx)), sub(mul(q.z, ty), mul(q.y, tz))),
+				add(add(z, mul(q.w, tz)), sub(mul(q.y, tx), mul(q.x, ty))),
+				add(add(y, mul(q.w, ty)), sub(mul(q.x, tz), mul(q.z, tx))),
+				set1(x, 0.0f));
+		}
+
+		QuatPacket normalize() const
+		{
+			using namespace Impl;
+			const Reg invLength = div(set1(x, 1.0f), sqrt(this->dot(*this)));
+			return QuatPacket(mul(x, invLength), mul(z, invLength), mul(y, invLength), mul(w, invLength));
+		}
+
+		// Normalizes with an approximate reciprocal square root refined by one Newton-Raphson step, to within 3e-7 of normalize.
+		// Like V4D::normalize, zero and non-finite elements become zero, and so do elements whose squared length overflows.
+		QuatPacket normalizeFast() const
+		{
+			using namespace Impl;
+			const Reg length2 = this->dot(*this);
+			const Reg r = rsqrt(length2);
+
+			// r * (1.5 - 0.5 * length2 * r * r)
+			const Reg invLength = mul(r, sub(set1(x, 1.5f), mul(mul(set1(x, 0.5f), length2), mul(r, r))));
+
+			// the results are masked rather than the factor, as infinite and NaN components stay NaN when multiplied by zero
+			const Reg valid = bitAnd(cmpgt(length2, set1(x, 0.0f)), cmplt(length2, set1(x, INFINITY)));
+			return QuatPacket(bitAnd(mul(x, invLength), valid), bitAnd(mul(z, invLength), valid), bitAnd(mul(y, invLength), valid), bitAnd(mul(w, invLength), valid));
+		}
+
+		// Normalized linear interpolation along the shorter arc, per element by t.
+		// With SlerpCorrected, t is adjusted so that the result follows slerp to within 0.0004 radians.
+		// https://zeux.io/2015/07/23/approximating-slerp/
+		template <bool SlerpCorrected = false> QuatPacket qNlerp(const QuatPacket& q, Reg t) const
+		{
+			using namespace Impl;
+			const Reg d = this->dot(q);
+			const Reg flip = bitAnd(d, signMask(d));
+
+			if constexpr (SlerpCorrected) {
+				const Reg ad = bitXor(d, flip);
+				const Reg ca = add(set1(d, 1.0904f), mul(ad, add(set1(d, -3.2452f), mul(ad, sub(set1(d, 3.55645f), mul(ad, set1(d, 1.43519f)))))));
+				const Reg cb = add(set1(d, 0.848013f), mul(ad, add(set1(d, -1.06021f), mul(ad, set1(d, 0.215638f)))));
+				const Reg th = sub(t, set1(d, 0.5f));
+				const Reg k = add(mul(ca, mul(th, th)), cb);
+				t = add(t, mul(mul(t, th), mul(sub(t, set1(d, 1.0f)), k)));
+			}
+
+			const Reg s = sub(set1(d, 1.0f), t);
+			return QuatPacket(
+				add(mul(x, s), mul(bitXor(q.x, flip), t)),
+				add(mul(z, s), mul(bitXor(q.z, flip), t)),
+				add(mul(y, s), mul(bitXor(q.y, flip), t)),
+				add(mul(w, s), mul(bitXor(q.w, flip), t))).normalize();
+		}
+	};
+
+	template <> inline QuatPacket<4> QuatPacket<4>::gather(const V4D* const* elements)
+	{
+		__m128 r0 = *elements[0], r1 = *elements[1], r2 = *elements[2], r3 = *elements[3];
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		return QuatPacket(r0, r1, r2, r3);
+	}
+
+	template <> inline void QuatPacket<4>::scatter(V4D* const* elements, const int count) const
+	{
+		__m128 r[4] = { x, z, y, w };
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+		for (int i = 0; i < count && i < width; i++) {
+			*elements[i] = r[i];
+		}
+	}
+
+	using QuatX4 = QuatPacket<4>;
+
+#ifdef VXD_AVX_PACKETS
+	template <> inline QuatPacket<8> QuatPacket<8>::gather(const V4D* const* elements)
+	{
+		const QuatX4 lo = QuatX4::gather(elements);
+		const QuatX4 hi = QuatX4::gather(elements + 4);
+		return QuatPacket(_mm256_set_m128(hi.x, lo.x), _mm256_set_m128(hi.z, lo.z), _mm256_set_m128(hi.y, lo.y), _mm256_set_m128(hi.w, lo.w));
+	}
+
+	template <> inline void QuatPacket<8>::scatter(V4D* const* elements, const int count) const
+	{
+		const QuatX4 lo(_mm256_castps256_ps128(x), _mm256_castps256_ps128(z), _mm256_castps256_ps128(y), _mm256_castps256_ps128(w));
+		const QuatX4 hi(_mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(z, 1), _mm256_extractf128_ps(y, 1), _mm256_extractf128_ps(w, 1));
+		lo.scatter(elements, count < 4 ? count : 4);
+		if (count > 4) hi.scatter(elements + 4, count - 4);
+	}
+
+	using QuatX8 = QuatPacket<8>;
+#endif
+}
+
+// Affine transforms as 4x4 matrices.
+// r[0], r[1] and r[2] are the transformed (rotated and scaled) basis axes in V4D lane order with w set to zero,
+// r[3] is the translation with w set to one. In memory this is a column-major 4x4 matrix, like Havok's hkMatrix4.
+namespace VxD {
+	namespace Impl {
+		template <int Lane> inline __m128 splat(const __m128 v)
+		{
+			return _mm_shuffle_ps(v, v, _MM_SHUFFLE(Lane, Lane, Lane, Lane));
+		}
+	}
+
+	inline m128Matrix mIdentity()
+	{
+		return { { _mm_set_ps(0.0f, 0.0f, 0.0f, 1.0f), _mm_set_ps(0.0f, 0.0f, 1.0f, 0.0f), _mm_set_ps(0.0f, 1.0f, 0.0f, 0.0f), _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f) } };
+	}
+
+	// Transforms v as a 4D vector: a point when its w is one, a direction when it is zero.
+	inline V4D mTransform(const m128Matrix& m, const V4D v)
+	{
+		using namespace Impl;
+		const __m128 xz = _mm_add_ps(_mm_mul_ps(m.r[0], splat<0>(v)), _mm_mul_ps(m.r[1], splat<1>(v)));
+		const __m128 yw = _mm_add_ps(_mm_mul_ps(m.r[2], splat<2>(v)), _mm_mul_ps(m.r[3], splat<3>(v)));
+		return _mm_add_ps(xz, yw);
+	}
+
+	inline V4D mTransformPoint(const m128Matrix& m, const V4D point)
+	{
+		return mTransform(m, _mm_add_ps(point.flatten<V4D::CoordinateAxis::W>(), _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f)));
+	}
+
+	inline V4D mTransformVector(const m128Matrix& m, const V4D vector)
+	{
+		return mTransform(m, vector.flatten<V4D::CoordinateAxis::W>());
+	}
+
+	// The matrix product a * b: transforming by the result is the same as transforming by b, then by a.
+	inline m128Matrix mMul(const m128Matrix& a, const m128Matrix& b)
+	{
+		return { { mTransform(a, b.r[0]), mTransform(a, b.r[1]), mTransform(a, b.r[2]), mTransform(a, b.r[3]) } };
+	}
+
+	inline m128Matrix mTranspose(m128Matrix m)
+	{
+		_MM_TRANSPOSE4_PS(m.r[0], m.r[1], m.r[2], m.r[3]);
+		return m;
+	}
+
+	// Inverts an affine transform, with the 3x3 adjugate. Singular matrices (e.g. with a zero scale) give non-finite results.
+	inline m128Matrix mInverseAffine(const m128Matrix& m)
+	{
+		const V4D c0 = V4D(m.r[0]).flatten<V4D::CoordinateAxis::W>();
+		const V4D c1 = V4D(m.r[1]).flatten<V4D::CoordinateAxis::W>();
+		const V4D c2 = V4D(m.r[2]).flatten<V4D::CoordinateAxis::W>();
+
+		// the rows of the inverse are the cross products of the axes, divided by the determinant
+		const V4D r0 = c1.cross(c2);
+		const V4D r1 = c2.cross(c0);
+		const V4D r2 = c0.cross(c1);
+		const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), _mm_set1_ps(c0 * r0));
+
+		m128Matrix result = { { _mm_mul_ps(r0, invDet), _mm_mul_ps(r1, invDet), _mm_mul_ps(r2, invDet), _mm_setzero_ps() } };
+		result = mTranspose(result);
+		result.r[3] = _mm_add_ps(mTransform(result, _mm_xor_ps(V4D(m.r[3]).flatten<V4D::CoordinateAxis::W>(), _mm_castsi128_ps(_mm_set1_epi32(0x80000000)))),
+			_mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f));
+		return result;
+	}
+
+	// Builds a matrix from a rotation quaternion, a translation and a per-axis scale, applied in the order scale, rotate, translate.
+	inline m128Matrix mFromTransform(const V4D q, const V4D translation, const V4D scale = V4D(1.0f))
+	{
+		alignas(16) float c[4];
+		_mm_store_ps(c, q);
+		const float x = c[0], y = c[1], z = c[2], w = c[3];
+		_mm_store_ps(c, scale);
+
+		return { {
+			_mm_mul_ps(_mm_set_ps(0.0f, 2.0f * (x * z - w * y), 2.0f * (x * y + w * z), 1.0f - 2.0f * (y * y + z * z)), _mm_set1_ps(c[0])),
+			_mm_mul_ps(_mm_set_ps(0.0f, 2.0f * (y * z + w * x), 1.0f - 2.0f * (x * x + z * z), 2.0f * (x * y - w * z)), _mm_set1_ps(c[1])),
+			_mm_mul_ps(_mm_set_ps(0.0f, 1.0f - 2.0f * (x * x + y * y), 2.0f * (y * z - w * x), 2.0f * (x * z + w * y)), _mm_set1_ps(c[2])),
+			_mm_add_ps(translation.flatten<V4D::CoordinateAxis::W>(), _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f))
+		} };
+	}
+
+	// Decomposes an affine matrix without shear into a rotation quaternion, a translation and a per-axis scale.
+	// A mirroring transform is represented by a negative scale on the first axis.
+	inline void mToTransform(const m128Matrix& m, V4D& q, V4D& translation, V4D& scale)
+	{
+		const V4D c0 = V4D(m.r[0]).flatten<V4D::CoordinateAxis::W>();
+		const V4D c1 = V4D(m.r[1]).flatten<V4D::CoordinateAxis::W>();
+		const V4D c2 = V4D(m.r[2]).flatten<V4D::CoordinateAxis::W>();
+		const float det = c0 * c1.cross(c2);
+		const float s0 = det < 0.0f ? -c0.length() : c0.length();
+
+		translation = V4D(m.r[3]).flatten<V4D::CoordinateAxis::W>();
+		scale = V4D(s0, c1.length(), c2.length());
+
+		// https://www.euclideanspace.com/maths/geometry/rotations/conversions/matrixToQuaternion/
+		alignas(16) float r[3][4];
+		_mm_store_ps(r[0], _mm_div_ps(c0, _mm_set1_ps(s0)));
+		_mm_store_ps(r[1], _mm_div_ps(c1, _mm_set1_ps(scale[1])));
+		_mm_store_ps(r[2], _mm_div_ps(c2, _mm_set1_ps(scale[2])));
+
+		// r[column][row] of the rotation matrix
+		const float trace = r[0][0] + r[1][1] + r[2][2];
+		if (trace > 0.0f) {
+			const float k = 0.5f / sqrtf(trace + 1.0f);
+			q = V4D((r[1][2] - r[2][1]) * k, (r[2][0] - r[0][2]) * k, (r[0][1] - r[1][0]) * k, 0.25f / k);
+		}
+		else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+			const float k = 0.5f / sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]);
+			q = V4D(0.25f / k, (r[1][0] + r[0][1]) * k, (r[2][0] + r[0][2]) * k, (r[1][2] - r[2][1]) * k);
+		}
+		else if (r[1][1] > r[2][2]) {
+			const float k = 0.5f / sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]);
+			q = V4D((r[1][0] + r[0][1]) * k, 0.25f / k, (r[2][1] + r[1][2]) * k, (r[2][0] - r[0][2]) * k);
+		}
+		else {
+			const float k = 0.5f / sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]);
+			q = V4D((r[2][0] + r[0][2]) * k, (r[2][1] + r[1][2]) * k, 0.25f / k, (r[0][1] - r[1][0]) * k);
+		}
+	}
+
+	// Builds count matrices from transforms in structure of arrays form, four at a time. See mFromTransform.
+	// q, translation and scale point to arrays of their components in V4D lane order, e.g. the arrays of HkSkeleton::HkPose.
+	inline void mFromTransforms(const float* const q[4], const float* const translation[3], const float* const scale[3], m128Matrix* out, const size_t count)
+	{
+		for (size_t i = 0; i < count; i += 4) {
+			const size_t n = std::min<size_t>(count - i, 4);
+			auto load = [i, n](const float* lane) {
+				if (n == 4) return _mm_loadu_ps(lane + i);
+				float padded[4];
+				for (size_t j = 0; j < 4; j++) padded[j] = lane[i + (j < n ? j : 0)];
+				return _mm_loadu_ps(padded);
+			};
+
+			const __m128 x = load(q[0]), y = load(q[1]), z = load(q[2]), w = load(q[3]);
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 two = _mm_set1_ps(2.0f);
+			const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+			const __m128 s0 = load(scale[0]), s1 = load(scale[1]), s2 = load(scale[2]);
+
+			// every register holds one component of an axis for four transforms
+			__m128 axes[3][4] = {
+				{ _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), s0), _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), s0), _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), s0), _mm_setzero_ps() },
+				{ _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), s1), _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), s1), _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), s1), _mm_setzero_ps() },
+				{ _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), s2), _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), s2), _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), s2), _mm_setzero_ps() }
+			};
+			__m128 t[4] = { load(translation[0]), load(translation[1]), load(translation[2]), one };
+
+			for (auto& axis : axes) _MM_TRANSPOSE4_PS(axis[0], axis[1], axis[2], axis[3]);
+			_MM_TRANSPOSE4_PS(t[0], t[1], t[2], t[3]);
+
+			for (size_t j = 0; j < n; j++) {
+				out[i + j] = { { axes[0][j], axes[1][j], axes[2][j], t[j] } };
+			}
+		}
+	}
+}
+
+// Batch kernels, dispatched by CPU tier (see CPUFeatures.h).
+namespace VxD {
+	namespace Impl {
+		template <typename Packet> void qNlerpIdentityBatch(V4D* q, const float* t, const size_t count, const size_t stride)
+		{
+			constexpr int width = Packet::width;
+
+			for (size_t i = 0; i < count; i += width) {
+				const int n = static_cast<int>(std::min<size_t>(count - i, width));
+				V4D* elements[width];
+				float weights[width];
+
+				for (int j = 0; j < width; j++) {
+					// pad the last packet with the first element, the result is discarded
+					const size_t k = i + (j < n ? j : 0);
+					elements[j] = reinterpret_cast<V4D*>(reinterpret_cast<unsigned char*>(q) + k * stride);
+					weights[j] = *reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(t) + k * stride);
+				}
+
+				const Packet result = Packet::identity().template qNlerp<true>(Packet::gather(elements), Impl::load(Packet().x, weights));
+				result.scatter(elements, n);
+			}
+		}
+
+		template <typename Packet> void qNormalizeBatch(V4D* const* q, const size_t count)
+		{
+			constexpr int width = Packet::width;
+
+			for (size_t i = 0; i < count; i += width) {
+				const int n = static_cast<int>(std::min<size_t>(count - i, width));
+				V4D* elements[width];
+
+				for (int j = 0; j < width; j++) {
+					elements[j] = q[i + (j < n ? j : 0)];
+				}
+
+				Packet::gather(elements).normalizeFast().scatter(elements, n);
+			}
+		}
+
+		inline void qNormalizeSSE2(V4D* const* q, const size_t count)
+		{
+			qNormalizeBatch<QuatX4>(q, count);
+		}
+
+		inline void qNlerpIdentitySSE2(V4D* q, const float* t, const size_t count, const size_t stride)
+		{
+			qNlerpIdentityBatch<QuatX4>(q, t, count, stride);
+		}
+
+		// The AVX2 kernels are written with intrinsics rather than with QuatX8, so that they can be compiled for AVX2
+		// with CPUFEATURES_TARGET_AVX2 without enabling AVX for the whole project. A function target can not be applied to only the AVX instances of the packet templates.
+		// They compute the same operations in the same order as the packet versions, so every tier gives the same results.
+		CPUFEATURES_TARGET_AVX2 inline void gatherAVX2(V4D* const* elements, __m256 (&r)[4])
+		{
+			__m128 lo[4] = { *elements[0], *elements[1], *elements[2], *elements[3] };
+			__m128 hi[4] = { *elements[4], *elements[5], *elements[6], *elements[7] };
+			_MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+			_MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+			for (int i = 0; i < 4; i++) r[i] = _mm256_set_m128(hi[i], lo[i]);
+		}
+
+		CPUFEATURES_TARGET_AVX2 inline void scatterAVX2(V4D* const* elements, const int count, const __m256 (&r)[4])
+		{
+			__m128 lo[4], hi[4];
+			for (int i = 0; i < 4; i++) {
+				lo[i] = _mm256_castps256_ps128(r[i]);
+				hi[i] = _mm256_extractf128_ps(r[i], 1);
+			}
+			_MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+			_MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+			for (int i = 0; i < count && i < 8; i++) {
+				*elements[i] = i < 4 ? lo[i] : hi[i - 4];
+			}
+		}
+
+		CPUFEATURES_TARGET_AVX2 inline __m256 dotAVX2(const __m256 (&a)[4], const __m256 (&b)[4])
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[0]), _mm256_mul_ps(a[1], b[1])), _mm256_add_ps(_mm256_mul_ps(a[2], b[2]), _mm256_mul_ps(a[3], b[3])));
+		}
+
+		// See QuatPacket::normalizeFast.
+		CPUFEATURES_TARGET_AVX2 inline void qNormalizeAVX2(V4D* const* q, const size_t count)
+		{
+			for (size_t i = 0; i < count; i += 8) {
+				const int n = static_cast<int>(std::min<size_t>(count - i, 8));
+				V4D* elements[8];
+
+				for (int j = 0; j < 8; j++) {
+					elements[j] = q[i + (j < n ? j : 0)];
+				}
+
+				__m256 r[4];
+				gatherAVX2(elements, r);
+
+				const __m256 length2 = dotAVX2(r, r);
+				const __m256 rs = _mm256_rsqrt_ps(length2);
+				const __m256 invLength = _mm256_mul_ps(rs, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), length2), _mm256_mul_ps(rs, rs))));
+				const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(length2, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_cmp_ps(length2, _mm256_set1_ps(INFINITY), _CMP_LT_OQ));
+				for (auto& component : r) component = _mm256_and_ps(_mm256_mul_ps(component, invLength), valid);
+
+				scatterAVX2(elements, n, r);
+			}
+		}
+
+		// See QuatPacket::qNlerp, interpolating from identity.
+		CPUFEATURES_TARGET_AVX2 inline void qNlerpIdentityAVX2(V4D* q, const float* t, const size_t count, const size_t stride)
+		{
+			for (size_t i = 0; i < count; i += 8) {
+				const int n = static_cast<int>(std::min<size_t>(count - i, 8));
+				V4D* elements[8];
+				float weights[8];
+
+				for (int j = 0; j < 8; j++) {
+					// pad the last packet with the first element, the result is discarded
+					const size_t k = i + (j < n ? j : 0);
+					elements[j] = reinterpret_cast<V4D*>(reinterpret_cast<unsigned char*>(q) + k * stride);
+					weights[j] = *reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(t) + k * stride);
+				}
+
+				__m256 r[4];
+				gatherAVX2(elements, r);
+
+				const __m256 zero = _mm256_setzero_ps();
+				const __m256 one = _mm256_set1_ps(1.0f);
+				const __m256 identity[4] = { zero, zero, zero, one };
+				const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+
+				const __m256 d = dotAVX2(identity, r);
+				const __m256 flip = _mm256_and_ps(d, signMask);
+				const __m256 ad = _mm256_xor_ps(d, flip);
+				const __m256 ca = _mm256_add_ps(_mm256_set1_ps(1.0904f), _mm256_mul_ps(ad, _mm256_add_ps(_mm256_set1_ps(-3.2452f), _mm256_mul_ps(ad, _mm256_sub_ps(_mm256_set1_ps(3.55645f), _mm256_mul_ps(ad, _mm256_set1_ps(1.43519f)))))));
+				const __m256 cb = _mm256_add_ps(_mm256_set1_ps(0.848013f), _mm256_mul_ps(ad, _mm256_add_ps(_mm256_set1_ps(-1.06021f), _mm256_mul_ps(ad, _mm256_set1_ps(0.215638f)))));
+
+				__m256 w = _mm256_loadu_ps(weights);
+				const __m256 th = _mm256_sub_ps(w, _mm256_set1_ps(0.5f));
+				const __m256 k = _mm256_add_ps(_mm256_mul_ps(ca, _mm256_mul_ps(th, th)), cb);
+				w = _mm256_add_ps(w, _mm256_mul_ps(_mm256_mul_ps(w, th), _mm256_mul_ps(_mm256_sub_ps(w, one), k)));
+
+				const __m256 s = _mm256_sub_ps(one, w);
+				for (int c = 0; c < 4; c++) {
+					r[c] = _mm256_add_ps(_mm256_mul_ps(identity[c], s), _mm256_mul_ps(_mm256_xor_ps(r[c], flip), w));
+				}
+
+				const __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(dotAVX2(r, r)));
+				for (auto& component : r) component = _mm256_mul_ps(component, invLength);
+
+				scatterAVX2(elements, n, r);
+			}
+		}
+	}
+
+	namespace Kernels {
+		// Interpolates count quaternions in place from identity towards themselves by t, along the shorter arc and corrected to follow slerp.
+		// Consecutive quaternions and their weights are stride bytes apart, so that they can be stored in an array of structures.
+		inline const CPUFeatures::Kernel<void(V4D* q, const float* t, size_t count, size_t stride)> qNlerpIdentity{
+			&Impl::qNlerpIdentitySSE2,
+			nullptr,
+			&Impl::qNlerpIdentityAVX2
+		};
+
+		// Normalizes count quaternions in place, see QuatPacket::normalizeFast.
+		// There is no AVX-512 implementation: _mm512_rsqrt14_ps is more precise than rsqrtps, so its results would differ from the other tiers.
+		inline const CPUFeatures::Kernel<void(V4D* const* q, size_t count)> qNormalize{
+			&Impl::qNormalizeSSE2,
+			nullptr,
+			&Impl::qNormalizeAVX2
+		};
+	}
+}
\ No newline at end of file
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <stdint.h>
+#include <immintrin.h>
+
+// Define VXD_FAST_TRANSCENDENTALS to make the approximations below the default for V4D::qPow and V4D::qSlerp.
+// Individual call sites can always choose with the template parameter, e.g. q.qPow<true>(t).
+#ifdef VXD_FAST_TRANSCENDENTALS
+#define VXD_FAST_TRANSCENDENTALS_DEFAULT true
+#else
+#define VXD_FAST_TRANSCENDENTALS_DEFAULT false
+#endif
+
+// Branchless polynomial approximations of transcendental functions, four lanes at a time, SSE2 only.
+// Maximum errors are measured against the C runtime in double precision over the stated domains.
+// Inputs outside of the domains are not checked for, unlike the C runtime there is no errno and no special handling of infinities.
+namespace VxD {
+	namespace Approx {
+		namespace Impl {
+			inline __m128 select(const __m128 mask, const __m128 a, const __m128 b)
+			{
+				return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+			}
+
+			inline __m128 signMask()
+			{
+				return _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+			}
+
+			inline __m128 abs(const __m128 x)
+			{
+				return _mm_andnot_ps(signMask(), x);
+			}
+
+			// Evaluates a polynomial with Horner's method, coefficients are given from the highest power down.
+			template <typename... Rest> inline __m128 horner(const __m128 x, const __m128 acc, const float c, const Rest... rest)
+			{
+				const __m128 next = _mm_add_ps(_mm_mul_ps(acc, x), _mm_set1_ps(c));
+				if constexpr (sizeof...(Rest) == 0) return next;
+				else return horner(x, next, rest...);
+			}
+
+			template <typename... Rest> inline __m128 poly(const __m128 x, const float c0, const Rest... rest)
+			{
+				return horner(x, _mm_set1_ps(c0), rest...);
+			}
+		}
+
+		// Sine and cosine at once. Domain: |x| <= 8192, max absolute error 9.4e-8.
+		inline void sincos(const __m128 x, __m128& s, __m128& c)
+		{
+			using namespace Impl;
+
+			// reduce to [-pi/4, pi/4] and a quadrant, pi/2 is split into three parts to keep the reduction exact
+			const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236758134f)));
+			const __m128 q = _mm_cvtepi32_ps(quadrant);
+			__m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(1.5703125f)));
+			r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(4.837512969970703125e-4f)));
+			r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(7.54978995489188216e-8f)));
+
+			const __m128 r2 = _mm_mul_ps(r, r);
+			const __m128 sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), poly(r2, -1.9515295891e-4f, 8.3321608736e-3f, -1.6666654611e-1f)));
+			const __m128 cosR = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))),
+				_mm_mul_ps(_mm_mul_ps(r2, r2), poly(r2, 2.443315711809948e-5f, -1.388731625493765e-3f, 4.166664568298827e-2f)));
+
+			// odd quadrants swap sine and cosine, quadrants 2 and 3 negate the sine, 1 and 2 negate the cosine
+			const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+			const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+			const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+			s = _mm_xor_ps(select(swap, cosR, sinR), sinSign);
+			c = _mm_xor_ps(select(swap, sinR, cosR), cosSign);
+		}
+
+		inline __m128 sin(const __m128 x)
+		{
+			__m128 s, c;
+			sincos(x, s, c);
+			return s;
+		}
+
+		inline __m128 cos(const __m128 x)
+		{
+			__m128 s, c;
+			sincos(x, s, c);
+			return c;
+		}
+
+		// Four quadrant arctangent of y / x. Domain: finite inputs, returns 0 for (0, 0). Max absolute error 2.8e-7.
+		inline __m128 atan2(const __m128 y, const __m128 x)
+		{
+			using namespace Impl;
+
+			const __m128 ax = abs(x);
+			const __m128 ay = abs(y);
+			const __m128 hi = _mm_max_ps(ax, ay);
+			const __m128 lo = _mm_min_ps(ax, ay);
+			__m128 r = _mm_and_ps(_mm_div_ps(lo, hi), _mm_cmpgt_ps(hi, _mm_setzero_ps()));
+
+			// reduce [tan(pi/8), 1] to [-tan(pi/8), 0] with atan(r) = pi/4 + atan((r - 1) / (r + 1))
+			const __m128 reduce = _mm_cmpgt_ps(r, _mm_set1_ps(0.41421356237f));
+			r = select(reduce, _mm_div_ps(_mm_sub_ps(r, _mm_set1_ps(1.0f)), _mm_add_ps(r, _mm_set1_ps(1.0f))), r);
+
+			const __m128 r2 = _mm_mul_ps(r, r);
+			__m128 a = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), poly(r2, 8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f, -3.33329491539e-1f)));
+			a = _mm_add_ps(a, _mm_and_ps(reduce, _mm_set1_ps(0.78539816340f)));
+
+			// unfold the octant
+			a = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(1.57079632679f), a), a);
+			a = select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(3.14159265359f), a), a);
+			return _mm_or_ps(a, _mm_and_ps(y, signMask()));
+		}
+
+		// Arccosine. Domain: [-1, 1], max absolute error 3.1e-7.
+		inline __m128 acos(const __m128 x)
+		{
+			using namespace Impl;
+
+			// acos(|x|) is 2 * asin(sqrt((1 - |x|) / 2)) above 0.5 and pi/2 - asin(|x|) below
+			const __m128 ax = abs(x);
+			const __m128 large = _mm_cmpgt_ps(ax, _mm_set1_ps(0.5f));
+			const __m128 z = select(large, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), ax), _mm_set1_ps(0.5f)), _mm_mul_ps(ax, ax));
+			const __m128 s = select(large, _mm_sqrt_ps(z), ax);
+
+			const __m128 asinS = _mm_add_ps(s, _mm_mul_ps(_mm_mul_ps(s, z), poly(z, 4.2163199048e-2f, 2.4181311049e-2f, 4.5470025998e-2f, 7.4953002686e-2f, 1.6666752422e-1f)));
+			const __m128 a = select(large, _mm_add_ps(asinS, asinS), _mm_sub_ps(_mm_set1_ps(1.57079632679f), asinS));
+			return select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(3.14159265359f), a), a);
+		}
+
+		// Natural logarithm. Domain: positive normal floats, max relative error 2.3e-7.
+		inline __m128 log(const __m128 x)
+		{
+			using namespace Impl;
+
+			// split into an exponent and a mantissa in [sqrt(0.5), sqrt(2))
+			const __m128i bits = _mm_castps_si128(x);
+			__m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126));
+			__m128 m = _mm_or_ps(_mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x007FFFFF))), _mm_set1_ps(0.5f));
+
+			const __m128 small = _mm_cmplt_ps(m, _mm_set1_ps(0.70710678118f));
+			e = _mm_add_epi32(e, _mm_castps_si128(small));
+			m = _mm_add_ps(m, _mm_and_ps(small, m));
+			const __m128 fe = _mm_cvtepi32_ps(e);
+
+			// log(m) = 2 * atanh(s) with s = (m - 1) / (m + 1), |s| <= 0.1716 so the series converges quickly
+			const __m128 s = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_add_ps(m, _mm_set1_ps(1.0f)));
+			const __m128 s2 = _mm_mul_ps(s, s);
+			const __m128 y = _mm_mul_ps(s, _mm_add_ps(_mm_set1_ps(2.0f), _mm_mul_ps(s2, poly(s2, 2.0f / 9.0f, 2.0f / 7.0f, 2.0f / 5.0f, 2.0f / 3.0f))));
+
+			// ln(2) is split into two parts to keep the sum exact
+			return _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(fe, _mm_set1_ps(-2.12194440e-4f))), _mm_mul_ps(fe, _mm_set1_ps(0.693359375f)));
+		}
+
+		// Natural exponent. Domain: [-87.3, 88.7], inputs outside of it are clamped. Max relative error 8.2e-8.
+		inline __m128 exp(__m128 x)
+		{
+			using namespace Impl;
+
+			x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.3365f)), _mm_set1_ps(88.7228f));
+
+			// x = n * ln(2) + r, ln(2) is split into two parts to keep the reduction exact
+			const __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.44269504089f)));
+			const __m128 fn = _mm_cvtepi32_ps(n);
+			__m128 r = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(0.693359375f)));
+			r = _mm_sub_ps(r, _mm_mul_ps(fn, _mm_set1_ps(-2.12194440e-4f)));
+
+			const __m128 r2 = _mm_mul_ps(r, r);
+			const __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r2, poly(r, 1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+				4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f)), r), _mm_set1_ps(1.0f));
+
+			// 2^n, split in two so that n = 128 does not overflow the exponent
+			const __m128i half = _mm_srai_epi32(n, 1);
+			const __m128 scale0 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(half, _mm_set1_epi32(127)), 23));
+			const __m128 scale1 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_sub_epi32(n, half), _mm_set1_epi32(127)), 23));
+			return _mm_mul_ps(_mm_mul_ps(y, scale0), scale1);
+		}
+
+		// Scalar versions, for when there is only one value to compute.
+		inline void sincos(const float x, float& s, float& c)
+		{
+			__m128 vs, vc;
+			sincos(_mm_set_ss(x), vs, vc);
+			s = _mm_cvtss_f32(vs);
+			c = _mm_cvtss_f32(vc);
+		}
+
+		inline float sin(const float x) { return _mm_cvtss_f32(sin(_mm_set_ss(x))); }
+		inline float cos(const float x) { return _mm_cvtss_f32(cos(_mm_set_ss(x))); }
+		inline float atan2(const float y, const float x) { return _mm_cvtss_f32(atan2(_mm_set_ss(y), _mm_set_ss(x))); }
+		inline float acos(const float x) { return _mm_cvtss_f32(acos(_mm_set_ss(x))); }
+		inline float log(const float x) { return _mm_cvtss_f32(log(_mm_set_ss(x))); }
+		inline float exp(const float x) { return _mm_cvtss_f32(exp(_mm_set_ss(x))); }
+	}
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+// The subset of the Windows API used by PEParser and RTTIScanner, for building them on other platforms.
+// There is no current process image to find outside of Windows: GetModuleInformation fails, and images are loaded from files with PEImage instead.
+#if !defined(_WIN32)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+typedef void* HANDLE;
+typedef void* HMODULE;
+typedef unsigned long DWORD;
+typedef int BOOL;
+typedef long LONG;
+typedef int64_t LONGLONG;
+typedef const char* PCSTR;
+typedef char* PSTR;
+
+typedef union {
+	struct {
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct {
+	void* lpBaseOfDll;
+	DWORD SizeOfImage;
+	void* EntryPoint;
+} MODULEINFO;
+
+#define TRUE 1
+#define FALSE 0
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x1
+#define OPEN_EXISTING 3
+#define CREATE_ALWAYS 2
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define PAGE_READONLY 0x2
+#define FILE_MAP_READ 0x4
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<intptr_t>(-1)))
+
+#define UNDNAME_NO_LEADING_UNDERSCORES 0x1
+#define UNDNAME_NO_MS_KEYWORDS 0x2
+#define UNDNAME_32_BIT_DECODE 0x800
+#define UNDNAME_NAME_ONLY 0x1000
+#define UNDNAME_NO_ARGUMENTS 0x2000
+
+namespace WinCompat {
+	// File handles are file descriptors plus one, so that no valid handle is nullptr.
+	inline int toDescriptor(HANDLE handle) { return static_cast<int>(reinterpret_cast<intptr_t>(handle)) - 1; }
+	inline HANDLE toHandle(int descriptor) { return descriptor < 0 ? INVALID_HANDLE_VALUE : reinterpret_cast<HANDLE>(static_cast<intptr_t>(descriptor) + 1); }
+
+	// munmap needs the size of a view, which UnmapViewOfFile is not given.
+	inline std::mutex viewMutex{};
+	inline std::unordered_map<const void*, size_t> viewSizes{};
+}
+
+inline HANDLE GetCurrentProcess() { return nullptr; }
+inline HMODULE GetModuleHandleA(const char*) { return nullptr; }
+inline BOOL GetModuleInformation(HANDLE, HMODULE, MODULEINFO*, DWORD) { return FALSE; }
+
+inline HANDLE CreateFileA(const char* path, DWORD access, DWORD, void*, DWORD disposition, DWORD, HANDLE)
+{
+	const int flags = (access & GENERIC_WRITE) ? O_WRONLY | O_CREAT | (disposition == CREATE_ALWAYS ? O_TRUNC : 0) : O_RDONLY;
+	return WinCompat::toHandle(open(path, flags, 0644));
+}
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+	return close(WinCompat::toDescriptor(handle)) == 0;
+}
+
+inline BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size)
+{
+	struct stat status;
+	if (fstat(WinCompat::toDescriptor(file), &status) != 0) return FALSE;
+
+	size->QuadPart = static_cast<LONGLONG>(status.st_size);
+	return TRUE;
+}
+
+inline BOOL WriteFile(HANDLE file, const void* buffer, DWORD size, DWORD* written, void*)
+{
+	const ssize_t result = write(WinCompat::toDescriptor(file), buffer, size);
+	*written = result > 0 ? static_cast<DWORD>(result) : 0;
+	return result == static_cast<ssize_t>(size);
+}
+
+// rename replaces an existing file, as MOVEFILE_REPLACE_EXISTING does.
+inline BOOL MoveFileExA(const char* existingPath, const char* newPath, DWORD)
+{
+	return rename(existingPath, newPath) == 0;
+}
+
+inline BOOL DeleteFileA(const char* path)
+{
+	return unlink(path) == 0;
+}
+
+// A mapping is a duplicate of the file descriptor, the whole file is mapped by MapViewOfFile.
+inline HANDLE CreateFileMappingA(HANDLE file, void*, DWORD, DWORD, DWORD, const char*)
+{
+	const int descriptor = dup(WinCompat::toDescriptor(file));
+	return descriptor < 0 ? nullptr : WinCompat::toHandle(descriptor);
+}
+
+inline void* MapViewOfFile(HANDLE mapping, DWORD, DWORD, DWORD, size_t)
+{
+	const int descriptor = WinCompat::toDescriptor(mapping);
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size <= 0) return nullptr;
+
+	void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if (view == MAP_FAILED) return nullptr;
+
+	std::lock_guard<std::mutex> lock(WinCompat::viewMutex);
+	WinCompat::viewSizes[view] = static_cast<size_t>(status.st_size);
+	return view;
+}
+
+inline BOOL UnmapViewOfFile(const void* view)
+{
+	std::lock_guard<std::mutex> lock(WinCompat::viewMutex);
+	auto iter = WinCompat::viewSizes.find(view);
+	if (iter == WinCompat::viewSizes.end()) return FALSE;
+
+	munmap(const_cast<void*>(view), iter->second);
+	WinCompat::viewSizes.erase(iter);
+	return TRUE;
+}
+
+// Only demangles plain, possibly nested class and struct names (e.g. "?AVPlayerIns@CS@@" to "CS::PlayerIns"), the only kind RTTIScanner::mangleClassName produces.
+// Fails on anything else, like template instances or back references.
+inline DWORD UnDecorateSymbolName(PCSTR name, PSTR output, DWORD size, DWORD)
+{
+	if (strncmp(name, "?AV", 3) != 0 && strncmp(name, "?AU", 3) != 0) return 0;
+
+	std::string demangled;
+	const char* part = name + 3;
+	while (*part != '@') {
+		const char* end = strchr(part, '@');
+		if (!end || end == part || *part == '?' || *part == '$' || (*part >= '0' && *part <= '9')) return 0;
+
+		// the innermost name comes first
+		std::string scope(part, end);
+		demangled = demangled.empty() ? scope : scope + "::" + demangled;
+		part = end + 1;
+	}
+
+	if (part[1] != '\0' || demangled.size() + 1 > size) return 0;
+
+	memcpy(output, demangled.c_str(), demangled.size() + 1);
+	return static_cast<DWORD>(demangled.size());
+}
+
+#endif
@@ -1,16 +1,22 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string_view>
 #include <immintrin.h>
 
+#include "CPUFeatures.h"
+
 // https://meghprkh.github.io/blog/posts/c++-force-inline/
 // Local always inline macro.
 // Makes the compiler less likely to turn what should be a compile time calculation into a runtime function call.
 // (mostly applies to MSVC)
 #if defined(__clang__)
-#define POINTERCHAIN_FORCE_INLINE [[gnu::always_inline]] [[gnu::gnu_inline]] extern inline
+#define FASTSTRING_FORCE_INLINE [[gnu::always_inline]] [[gnu::gnu_inline]] extern inline
 
 #elif defined(__GNUC__)
-#define POINTERCHAIN_FORCE_INLINE [[gnu::always_inline]] inline
+#define FASTSTRING_FORCE_INLINE [[gnu::always_inline]] inline
 
 #elif defined(_MSC_VER)
 #pragma warning(error: 4714)
@@ -20,21 +26,67 @@
 #error Unsupported compiler
 #endif
 
+namespace faststring {
+	namespace Impl {
+		// Whether size bytes starting at mem are all in the same page. Such a read can not fault if mem itself is readable.
+		inline bool withinPage(const void* mem, const size_t size)
+		{
+			return (reinterpret_cast<uintptr_t>(mem) & 4095) <= 4096 - size;
+		}
+
+		// Loads up to 16 bytes into the low bytes of a register and zeroes the rest.
+		// Bytes past size are only read if they are in the same page, otherwise the bytes are copied instead.
+		inline __m128i loadPartial(const void* mem, const size_t size)
+		{
+			if (size >= 16) return _mm_loadu_si128(reinterpret_cast<const __m128i*>(mem));
+			if (withinPage(mem, 16)) {
+				const __m128i index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+				const __m128i keep = _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(size)), index);
+				return _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mem)), keep);
+			}
+			alignas(16) char buffer[16] = {};
+			memcpy(buffer, mem, size);
+			return _mm_load_si128(reinterpret_cast<const __m128i*>(buffer));
+		}
+
+		inline bool memeqBytewise(const void* mem1, const void* mem2, const size_t size)
+		{
+			const char* str1 = reinterpret_cast<const char*>(mem1);
+			const char* str2 = reinterpret_cast<const char*>(mem2);
+			for (size_t i = 0; i < size; i++) {
+				if (str1[i] != str2[i]) return false;
+			}
+			return true;
+		}
+	}
+}
+
+// Compares memory with a literal of a compile time size, including its null terminator.
+// The compared string may be shorter than the literal, so reads never cross into a page the string might not reach:
+// near the end of a page the bytes are compared one at a time, stopping at the first difference (at the latest, the string's terminator).
 template <size_t N, typename T> FASTSTRING_FORCE_INLINE bool strcmp_fast(char* mem, const T(&str)[N])
 {
 	constexpr size_t size = N * sizeof(T);
 
 	if constexpr (size == 0) return true;
 	else if constexpr (size == 1) return *mem == *reinterpret_cast<const char*>(str);
-	else if constexpr (size == 2) return *reinterpret_cast<const short*>(mem) == *reinterpret_cast<const short*>(str);
-	else if constexpr (size <= 4) return !((*reinterpret_cast<const int*>(mem) ^ *reinterpret_cast<const int*>(str)) << (4 - size));
-	else if constexpr (size <= 8) return !((*reinterpret_cast<const long long*>(mem) ^ *reinterpret_cast<const long long*>(str)) << (8 - size));
 	else if constexpr (size <= 16) {
-		__m128i str1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mem));
-		__m128i str2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
-		__m128i result = _mm_xor_si128(str1, str2);
-		if constexpr (size != 16) result = _mm_slli_si128(result, 16 - size);
-		return _mm_testz_si128(result, result);
+		if (!faststring::Impl::withinPage(mem, size)) return faststring::Impl::memeqBytewise(mem, str, size);
+
+		if constexpr (size <= 8) {
+			// both sides are copied into zero padded values, a constant size copy compiles to plain loads
+			unsigned long long memory = 0, literal = 0;
+			memcpy(&memory, mem, size);
+			memcpy(&literal, str, size);
+			return memory == literal;
+		}
+		else {
+			alignas(16) char literal[16] = {};
+			memcpy(literal, str, size);
+			__m128i str1 = faststring::Impl::loadPartial(mem, size);
+			__m128i str2 = _mm_load_si128(reinterpret_cast<const __m128i*>(literal));
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(str1, str2)) == 0xFFFF;
+		}
 	}
 	else return strcmp_fast(mem, *reinterpret_cast<const T(*)[16 / sizeof(T)]>(reinterpret_cast<const T*>(str)))
 		&& strcmp_fast(mem + 16, *reinterpret_cast<const T(*)[N - 16 / sizeof(T)]>(reinterpret_cast<const T*>(str) + 16 / sizeof(T)));
@@ -42,4 +94,173 @@ template <size_t N, typename T> FASTSTRING_FORCE_INLINE bool strcmp_fast(char* m
 
 #ifdef FASTSTRING_FORCE_INLINE
 #undef FASTSTRING_FORCE_INLINE
-#endif
\ No newline at end of file
+#endif
+
+namespace faststring {
+	namespace Impl {
+		inline bool memeqSSE2(const void* mem1, const void* mem2, const size_t size)
+		{
+			const char* str1 = reinterpret_cast<const char*>(mem1);
+			const char* str2 = reinterpret_cast<const char*>(mem2);
+			size_t i = 0;
+
+			for (; i + 16 <= size; i += 16) {
+				__m128i cmp = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(str1 + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(str2 + i)));
+				if (_mm_movemask_epi8(cmp) != 0xFFFF) return false;
+			}
+
+			if (i == size) return true;
+
+			// the tail is loaded so that nothing past the end is read from another page
+			__m128i cmp = _mm_cmpeq_epi8(loadPartial(str1 + i, size - i), loadPartial(str2 + i, size - i));
+			return _mm_movemask_epi8(cmp) == 0xFFFF;
+		}
+
+		CPUFEATURES_TARGET_AVX2 inline bool memeqAVX2(const void* mem1, const void* mem2, const size_t size)
+		{
+			const char* str1 = reinterpret_cast<const char*>(mem1);
+			const char* str2 = reinterpret_cast<const char*>(mem2);
+			size_t i = 0;
+
+			for (; i + 32 <= size; i += 32) {
+				__m256i cmp = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(str1 + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str2 + i)));
+				if (_mm256_movemask_epi8(cmp) != -1) return false;
+			}
+
+			return memeqSSE2(str1 + i, str2 + i, size - i);
+		}
+	}
+
+	// Compares two blocks of memory of a length only known at runtime, using the widest instructions the CPU supports.
+	inline const CPUFeatures::Kernel<bool(const void* mem1, const void* mem2, size_t size)> memeq_fast{ &Impl::memeqSSE2, nullptr, &Impl::memeqAVX2 };
+
+	// Runtime length string functions, for narrow (char) and UTF-16 (wchar_t on Windows, char16_t) strings.
+	// Lengths are in characters. Nothing is read past the end of a string, except within the page it ends in.
+	namespace Impl {
+		template <typename T> constexpr void checkCharType()
+		{
+			static_assert(sizeof(T) == 1 || sizeof(T) == 2, "Only narrow and UTF-16 strings are supported.");
+		}
+
+		// A bit per byte of a 16 byte block that is part of a null character.
+		template <typename T> inline unsigned int zeroMask(const __m128i block)
+		{
+			if constexpr (sizeof(T) == 1) return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_setzero_si128()));
+			else return _mm_movemask_epi8(_mm_cmpeq_epi16(block, _mm_setzero_si128()));
+		}
+
+		inline int countTrailingZeros(const unsigned int x)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, x);
+			return static_cast<int>(index);
+#else
+			return __builtin_ctz(x);
+#endif
+		}
+
+		inline uint64_t mix(const uint64_t h, const uint64_t word)
+		{
+			const uint64_t x = (h ^ word) * 0x9E3779B97F4A7C15ull;
+			return x ^ (x >> 32);
+		}
+	}
+
+	// The length of a null terminated string. Uses aligned loads, which never cross a page boundary.
+	// UTF-16 strings must be aligned to 2 bytes.
+	template <typename T> inline size_t length(const T* str)
+	{
+		Impl::checkCharType<T>();
+
+		const uintptr_t address = reinterpret_cast<uintptr_t>(str);
+		const char* block = reinterpret_cast<const char*>(address & ~static_cast<uintptr_t>(15));
+
+		// the bytes of the first block before the string are masked off
+		unsigned int mask = Impl::zeroMask<T>(_mm_load_si128(reinterpret_cast<const __m128i*>(block))) >> (address & 15) << (address & 15);
+		while (!mask) {
+			block += 16;
+			mask = Impl::zeroMask<T>(_mm_load_si128(reinterpret_cast<const __m128i*>(block)));
+		}
+
+		return static_cast<size_t>(block + Impl::countTrailingZeros(mask) - reinterpret_cast<const char*>(str)) / sizeof(T);
+	}
+
+	// Whether two strings of the same runtime length are equal.
+	template <typename T> inline bool equals(const T* str1, const T* str2, const size_t length)
+	{
+		Impl::checkCharType<T>();
+		return memeq_fast(str1, str2, length * sizeof(T));
+	}
+
+	// Whether a string is equal to a literal, including its null terminator. Resolved at compile time, see strcmp_fast.
+	template <typename T, size_t N> inline bool equals(const T* str, const T(&literal)[N])
+	{
+		return strcmp_fast(reinterpret_cast<char*>(const_cast<T*>(str)), literal);
+	}
+
+	// Whether a string of a runtime length starts with a prefix.
+	template <typename T> inline bool startsWith(const T* str, const size_t length, const T* prefix, const size_t prefixLength)
+	{
+		return prefixLength <= length && equals(str, prefix, prefixLength);
+	}
+
+	// Whether a string starts with a literal, not including its null terminator. The string must be at least as long as the literal.
+	template <typename T, size_t N> inline bool startsWith(const T* str, const T(&prefix)[N])
+	{
+		if constexpr (N <= 1) return true;
+		else return strcmp_fast(reinterpret_cast<char*>(const_cast<T*>(str)), *reinterpret_cast<const T(*)[N - 1]>(prefix));
+	}
+
+	// A 64-bit hash of a string, 8 bytes at a time. Not cryptographic, meant for hash maps.
+	// Narrow and UTF-16 strings with the same bytes hash the same.
+	inline uint64_t hashBytes(const void* mem, const size_t size)
+	{
+		const char* bytes = reinterpret_cast<const char*>(mem);
+		uint64_t h = 0xCBF29CE484222325ull ^ size;
+		size_t i = 0;
+
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);
+			h = Impl::mix(h, word);
+		}
+
+		if (i < size) {
+			uint64_t word = 0;
+			if (Impl::withinPage(bytes + i, 8)) {
+				// reading past the end of the string is intended, GCC diagnoses it when a literal is hashed inline
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+#endif
+				memcpy(&word, bytes + i, 8);
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+				word &= ~0ull >> 8 * (8 - (size - i));
+			}
+			else {
+				memcpy(&word, bytes + i, size - i);
+			}
+			h = Impl::mix(h, word);
+		}
+
+		// final avalanche, so that every bit of the input affects the low bits used for bucketing
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	template <typename T> inline uint64_t hash(const T* str, const size_t length)
+	{
+		Impl::checkCharType<T>();
+		return hashBytes(str, length * sizeof(T));
+	}
+
+	// A hasher for unordered containers with std::string or std::string_view keys.
+	struct Hash {
+		size_t operator () (const std::string_view str) const { return static_cast<size_t>(faststring::hash(str.data(), str.size())); }
+	};
+}
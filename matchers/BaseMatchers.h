@@ -39,8 +39,8 @@ namespace ChrMatcher {
 	private:
 		virtual bool onMatch(void* ChrIns) 
 		{
-			char* pMapName = PointerChain::make<char>(ChrIns, 0x190, 0x0, 0x60, 0x18u, 0x0u).get();
-			return !!pMapName && strcmp_fast(pMapName, this->name);
+			wchar_t* pMapName = PointerChain::make<wchar_t>(ChrIns, 0x190, 0x0, 0x60, 0x18u, 0x0u).get();
+			return !!pMapName && faststring::equals(pMapName, this->name);
 		}
 	};
 
@@ -52,8 +52,8 @@ namespace ChrMatcher {
 	private:
 		virtual bool onMatch(void* ChrIns)
 		{
-			char* pChrName = PointerChain::make<char>(ChrIns, 0x190, 0x0, 0x28, 0x0u, 0x0u).get();
-			return !!pChrName && strcmp_fast(pChrName, this->name);
+			wchar_t* pChrName = PointerChain::make<wchar_t>(ChrIns, 0x190, 0x0, 0x28, 0x0u, 0x0u).get();
+			return !!pChrName && faststring::equals(pChrName, this->name);
 		}
 	};
 
@@ -65,8 +65,8 @@ namespace ChrMatcher {
 	private:
 		virtual bool onMatch(void* ChrIns)
 		{
-			char* pModelName = PointerChain::make<char>(ChrIns, 0x28, 0xA8u).get();
-			return !!pModelName && strcmp_fast(pModelName, this->name);
+			wchar_t* pModelName = PointerChain::make<wchar_t>(ChrIns, 0x28, 0xA8u).get();
+			return !!pModelName && faststring::equals(pModelName, this->name);
 		}
 	};
 
@@ -101,7 +101,7 @@ namespace ChrMatcher {
 			second = _mm_cmpeq_epi32(second, ID);
 			first = _mm_or_si128(first, second);
 
-			return !_mm_testz_si128(first, first);
+			return _mm_movemask_epi8(first) != 0;
 		}
 	};
 
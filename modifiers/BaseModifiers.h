@@ -5,7 +5,7 @@ namespace HkModifier {
 	class SetLength : public Modifier {
 	public:
 		SetLength(float length) : length(length) {}
-		virtual SetLength* clone() { return new SetLength(*this); }
+		virtual SetLength* clone() const { return new SetLength(*this); }
 
 		virtual bool onApply(Bone* bone, BoneData& bData) { if (std::isfinite(length)) bData.xzyVec = bData.xzyVec.scaleTo(this->length); return false; }
 
@@ -16,7 +16,7 @@ namespace HkModifier {
 	class ScaleLength : public Modifier {
 	public:
 		ScaleLength(float scale) : scale(std::isfinite(scale) ? scale : 1.0f) {}
-		virtual ScaleLength* clone() { return new ScaleLength(*this); }
+		virtual ScaleLength* clone() const { return new ScaleLength(*this); }
 
 	private:
 		virtual bool onApply(Bone* bone, BoneData& bData) { bData.xzyVec *= this->scale; return false; }
@@ -28,7 +28,7 @@ namespace HkModifier {
 	class SetSize : public Modifier {
 	public:
 		SetSize(V4D scale) : scale(scale) {}
-		virtual SetSize* clone() { return new SetSize(*this); }
+		virtual SetSize* clone() const { return new SetSize(*this); }
 
 		virtual bool onApply(Bone* bone, BoneData& bData) { if (scale.isfinite()) bData.xzyScale = this->scale; return true; }
 
@@ -39,7 +39,7 @@ namespace HkModifier {
 	class ScaleSize : public Modifier {
 	public:
 		ScaleSize(V4D scale) : scale(scale.isfinite() ? scale : V4D(1.0f)) {}
-		virtual ScaleSize* clone() { return new ScaleSize(*this); }
+		virtual ScaleSize* clone() const { return new ScaleSize(*this); }
 
 		virtual bool onApply(Bone* bone, BoneData& bData) { bData.xzyScale = _mm_mul_ps(bData.xzyScale, this->scale); return true; }
 
@@ -50,7 +50,7 @@ namespace HkModifier {
 	class Offset : public Modifier {
 	public:
 		Offset(V4D offset) : offset(offset.isfinite() ? offset.flatten<V4D::CoordinateAxis::W>() : V4D(0.0f)) {}
-		virtual Offset* clone() { return new Offset(*this); }
+		virtual Offset* clone() const { return new Offset(*this); }
 
 		virtual bool onApply(Bone* bone, BoneData& bData) { bData.xzyVec += offset.qTransform(bone->getWorldQ()); return false; }
 
@@ -62,9 +62,9 @@ namespace HkModifier {
 	class Rotate : public Modifier {
 	public:
 		Rotate(V4D q) : q(q.isfinite() && !q.iszero() ? q.normalize() : V4D(0.0f, 0.0f, 0.0f, 1.0f)) {}
-		virtual Rotate* clone() { return new Rotate(*this); }
+		virtual Rotate* clone() const { return new Rotate(*this); }
 
-		virtual bool onApply(Bone* bone, BoneData& bData) { bData.qSpatial = bData.qSpatial.qMul(q).normalize(); return false; }
+		virtual bool onApply(Bone* bone, BoneData& bData) { bData.qSpatial = bData.qSpatial.qMul(q); return false; }
 
 		V4D q;
 	};
@@ -74,7 +74,7 @@ namespace HkModifier {
 	class DisableClothPhysics : public Modifier {
 	public:
 		DisableClothPhysics() {}
-		virtual DisableClothPhysics* clone() { return new DisableClothPhysics(*this); }
+		virtual DisableClothPhysics* clone() const { return new DisableClothPhysics(*this); }
 
 		virtual bool onApply(Bone* bone, BoneData& bData) { *PointerChain::make<int>(bone->getSkeleton()->getChrIns(), 0x548) = 1; return true; } //, 0x190, 0xE8, 0x163
 	};
@@ -85,12 +85,13 @@ namespace HkModifier {
 		class DisableClothPhysics : public Modifier {
 		public:
 			DisableClothPhysics() {}
-			virtual DisableClothPhysics* clone() { return new DisableClothPhysics(*this); }
+			virtual DisableClothPhysics* clone() const { return new DisableClothPhysics(*this); }
 
 			virtual bool onApply(Bone* bone, BoneData& bData) 
 			{ 
 				auto clothState = PointerChain::make<int>(bone->getSkeleton()->getChrIns(), 0x548);
-				if (PointerChain::make<bool>(bone->getSkeleton()->getChrIns(), 0x190, 0xE8u, 0x163u).dereference(false)) {
+				uint8_t* ride = bone->getSkeleton()->getModules().ride;
+				if (!!ride && *PointerChain::make<bool>(ride, 0x163)) {
 					*clothState = 1;
 				}
 				else {
@@ -0,0 +1,94 @@
+#pragma once
+
+namespace HkModifier {
+	namespace Impl {
+		// The shared logic of blended modifiers: an eased weight that moves towards 1 while the blend is active and towards 0 while it is not,
+		// over a given duration. While the weight is between 0 and 1, the wrapped modifier's effect is scaled by it in place,
+		// so the blend keeps its position among the bone's modifiers.
+		// Pose modifiers can not be blended, they have their own weights instead.
+		class BlendBase : public Modifier {
+		protected:
+			template <typename T> static constexpr bool isBlendable = std::is_base_of_v<Modifier, T> && !std::is_base_of_v<PoseModifier, T>;
+
+			BlendBase(const Modifier& modifier, float duration, float progress) : modifier(modifier.clone()),
+				duration(std::isfinite(duration) ? (std::max)(duration, 0.0f) : 0.0f), progress(progress)
+			{
+				if (modifier.isPoseModifier()) throw std::runtime_error("Pose modifiers can not be blended.");
+			}
+			BlendBase(const BlendBase& other) : Modifier(), modifier(other.modifier->clone()),
+				duration(other.duration), progress(other.progress), frame(other.frame) {}
+
+			// Whether the blend should be moving towards its full weight.
+			virtual bool isActive(Bone* bone) = 0;
+
+		public:
+			virtual bool onApply(Bone* bone, BoneData& bData)
+			{
+				HkSkeleton* skeleton = bone->getSkeleton();
+
+				// skeleton modifiers are applied to every bone, only advance once per frame
+				if (skeleton->getFrameCount() != this->frame) {
+					this->frame = skeleton->getFrameCount();
+					const float step = this->duration > 0.0f ? Impl::getDeltaTime(skeleton->getChrIns()) / this->duration : 1.0f;
+					this->progress = std::clamp(this->progress + (this->isActive(bone) ? step : -step), 0.0f, 1.0f);
+				}
+
+				if (this->progress <= 0.0f) return false;
+				if (this->progress >= 1.0f) return this->modifier->onApply(bone, bData);
+
+				// apply the wrapped modifier, then scale its effect by the weight: the rotation delta is interpolated from identity,
+				// corrected so that nlerp closely follows slerp, https://zeux.io/2015/07/23/approximating-slerp/
+				const BoneData before = bData;
+				const bool result = this->modifier->onApply(bone, bData);
+
+				const float p = this->progress;
+				const float weight = p * p * (3.0f - 2.0f * p);
+				V4D dq = before.qSpatial.qConjugate().qMul(bData.qSpatial);
+				VxD::Kernels::qNlerpIdentity(&dq, &weight, 1, sizeof(V4D));
+
+				bData.qSpatial = before.qSpatial.qMul(dq);
+				bData.xzyVec = before.xzyVec + (bData.xzyVec - before.xzyVec) * weight;
+				bData.xzyScale = before.xzyScale + (bData.xzyScale - before.xzyScale) * weight;
+
+				return result;
+			}
+
+			std::unique_ptr<Modifier> modifier;
+			float duration;
+			float progress;
+			uint64_t frame = 0;
+		};
+	}
+
+	// Fades a modifier in over a duration in seconds, starting when the character is loaded.
+	// Example: target.addBoneModifier(HkModifier::Blend(HkModifier::ScaleLength(1.5f), 2.0f), "Head");
+	class Blend : public Impl::BlendBase {
+	public:
+		template <typename T> Blend(const T& modifier, float duration) : BlendBase(modifier, duration, 0.0f)
+		{
+			static_assert(isBlendable<T>, "Pose modifiers (e.g. IK) can not be blended.");
+		}
+		virtual Blend* clone() const { return new Blend(*this); }
+
+	private:
+		virtual bool isActive(Bone*) { return true; }
+	};
+
+	namespace SpEffect {
+		// Fades a modifier in over a duration in seconds while a chosen SpEffect is applied to the character, and back out once it is gone.
+		// Example: target.addBoneModifier(HkModifier::SpEffect::Blend(HkModifier::Rotate(q), 3245, 0.5f), "RootPos");
+		class Blend : public Impl::BlendBase {
+		public:
+			template <typename T> Blend(const T& modifier, int spEffectID, float duration) : BlendBase(modifier, duration, 0.0f), ID(spEffectID)
+			{
+				static_assert(isBlendable<T>, "Pose modifiers (e.g. IK) can not be blended.");
+			}
+			virtual Blend* clone() const { return new Blend(*this); }
+
+			int ID;
+
+		private:
+			virtual bool isActive(Bone* bone) { return Impl::checkSpEffectID(bone->getSkeleton()->getChrIns(), ID); }
+		};
+	}
+}
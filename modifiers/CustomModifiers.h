@@ -10,16 +10,18 @@ namespace HkModifier {
 		// however here I added an additional check that prevents abnormal parameters from being applied.
 		CapriSun(V4D q) : q(q.isfinite() && !q.iszero() ? q.normalize() : V4D(0.0f, 0.0f, 0.0f, 1.0f)), qAdd(this->q) {}
 		// A polymorphic copy method, it must be defined for every custom modifier.
-		virtual CapriSun* clone() { return new CapriSun(*this); }
+		virtual CapriSun* clone() const { return new CapriSun(*this); }
 
 		// Any custom modifier must have this function defined with this exact signature.
 		virtual bool onApply(Bone* bone, BoneData& bData)
 		{
-			bData.qSpatial = bData.qSpatial.qMul(qAdd).normalize();
+			bData.qSpatial = bData.qSpatial.qMul(qAdd);
 			qAdd = qAdd.qMul(q).normalize();
 
-			this->t += *PointerChain::make<float>(bone->getSkeleton()->getChrIns(), 0xB0) * 1.75f;
-			bData.xzyVec += V4D(sinf(this->t), 0.0f, cosf(this->t)) * 0.75f;
+			this->t += Impl::getDeltaTime(bone->getSkeleton()->getChrIns()) * 1.75f;
+			float sinT, cosT;
+			VxD::Approx::sincos(this->t, sinT, cosT);
+			bData.xzyVec += V4D(sinT, 0.0f, cosT) * 0.75f;
 
 			return true;
 		}
@@ -33,12 +35,12 @@ namespace HkModifier {
 	class Floss : public Modifier {
 	public:
 		Floss() {}
-		virtual Floss* clone() { return new Floss(*this); }
+		virtual Floss* clone() const { return new Floss(*this); }
 
 		virtual bool onApply(Bone* bone, BoneData& bData)
 		{
-			bData.qSpatial = bData.qSpatial.qMul(V4D(0.0f, -0.1961161f, 0.0f, 0.9805807f)).qMul(V4D(0.0f, 0.0f, 0.5144958f, 0.8574929f).qPow(sinf(this->t)));
-			this->t += *PointerChain::make<float>(bone->getSkeleton()->getChrIns(), 0xB0) * 8.0f;
+			bData.qSpatial = bData.qSpatial.qMul(V4D(0.0f, -0.1961161f, 0.0f, 0.9805807f)).qMul(V4D(0.0f, 0.0f, 0.5144958f, 0.8574929f).qPow<true>(VxD::Approx::sin(this->t)));
+			this->t += Impl::getDeltaTime(bone->getSkeleton()->getChrIns()) * 8.0f;
 
 			return false;
 		}
@@ -49,7 +51,7 @@ namespace HkModifier {
 	class RotateGlobal : public Modifier {
 	public:
 		RotateGlobal(V4D q) : q(q) {}
-		virtual RotateGlobal* clone() { return new RotateGlobal(*this); }
+		virtual RotateGlobal* clone() const { return new RotateGlobal(*this); }
 
 		virtual bool onApply(Bone* bone, BoneData& bData)
 		{
@@ -63,7 +65,7 @@ namespace HkModifier {
 	class Constraint : public Modifier {
 	public:
 		Constraint(float maxSwingAngle) : maxMagSwing(sinf(maxSwingAngle * 0.5f)), maxMagW(cosf(maxSwingAngle * 0.5f)) {}
-		virtual Constraint* clone() { return new Constraint(*this); }
+		virtual Constraint* clone() const { return new Constraint(*this); }
 
 		virtual bool onApply(Bone* bone, BoneData& bData)
 		{
@@ -71,9 +73,9 @@ namespace HkModifier {
 			V4D q = bData.qSpatial.qDiv(defq);
 			V4D vec = q.flatten<V4D::CoordinateAxis::W>();
 			if (vec.length2() > this->maxMagSwing * this->maxMagSwing) {
-				int w = *reinterpret_cast<int*>(&q[3]) & 0x80000000 | *reinterpret_cast<int*>(&this->maxMagW);
+				const float w = copysignf(this->maxMagW, q[3]);
 				q = vec.normalize() * this->maxMagSwing;
-				q[3] = *reinterpret_cast<float*>(&w);
+				q[3] = w;
 			}
 			bData.qSpatial = q.qMul(defq);
 			return false;
@@ -88,7 +90,7 @@ namespace HkModifier {
 		class ScaleLength : public Modifier {
 		public:
 			ScaleLength(float scale, int spEffectID) : scale(std::isfinite(scale) ? scale : 1.0f), ID(spEffectID) {}
-			virtual ScaleLength* clone() { return new ScaleLength(*this); }
+			virtual ScaleLength* clone() const { return new ScaleLength(*this); }
 
 		private:
 			virtual bool onApply(Bone* bone, BoneData& bData) {
@@ -104,7 +106,7 @@ namespace HkModifier {
 		class ScaleSize : public Modifier {
 		public:
 			ScaleSize(V4D scale, int spEffectID) : scale(scale.isfinite() ? scale : V4D(1.0f)), ID(spEffectID) {}
-			virtual ScaleSize* clone() { return new ScaleSize(*this); }
+			virtual ScaleSize* clone() const { return new ScaleSize(*this); }
 
 			virtual bool onApply(Bone* bone, BoneData& bData) 
 			{ 
@@ -122,7 +124,7 @@ namespace HkModifier {
 		class Offset : public Modifier {
 		public:
 			Offset(V4D offset, int spEffectID) : offset(offset.isfinite() ? offset.flatten<V4D::CoordinateAxis::W>() : V4D(0.0f)), ID(spEffectID) {}
-			virtual Offset* clone() { return new Offset(*this); }
+			virtual Offset* clone() const { return new Offset(*this); }
 
 			virtual bool onApply(Bone* bone, BoneData& bData) 
 			{ 
@@ -141,12 +143,12 @@ namespace HkModifier {
 		class Rotate : public Modifier {
 		public:
 			Rotate(V4D q, int spEffectID) : q(q.isfinite() && !q.iszero() ? q.normalize() : V4D(0.0f, 0.0f, 0.0f, 1.0f)), ID(spEffectID) {}
-			virtual Rotate* clone() { return new Rotate(*this); }
+			virtual Rotate* clone() const { return new Rotate(*this); }
 
 			virtual bool onApply(Bone* bone, BoneData& bData) 
 			{ 
 				if (Impl::checkSpEffectID(bone->getSkeleton()->getChrIns(), ID)) {
-					bData.qSpatial = bData.qSpatial.qMul(q).normalize();
+					bData.qSpatial = bData.qSpatial.qMul(q);
 				}
 				return false;
 			}
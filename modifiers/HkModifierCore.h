@@ -10,16 +10,39 @@ namespace HkModifier {
 		Modifier() {}
 		using Bone = HkSkeleton::HkBone;
 		using BoneData = Bone::HkBoneData;
+		using Pose = HkSkeleton::HkPose;
 
 	public:
 		virtual ~Modifier() {};
 
 		bool apply(Bone* bone) { return onApply(bone, bone->getBoneData()); }
+		void applyPose(Bone* bone, Pose& pose) { onApplyPose(bone, pose); }
 
 		// These two functions must be defined in a derived modifier class for it to be valid.
-		virtual Modifier* clone() = 0;
+		virtual Modifier* clone() const = 0;
 		// The return value signfies whether the modifier should be only applied once when applied as a skeleton modifier.
+		// There is no need to normalize qSpatial, the skeleton renormalizes every rotation that modifiers changed afterwards.
 		virtual bool onApply(Bone*, BoneData&) = 0;
+
+		// Pose modifiers are applied after all other modifiers, see HkModifier::PoseModifier.
+		virtual bool isPoseModifier() const { return false; }
+		virtual void onApplyPose(Bone*, Pose&) {}
+	};
+
+	// The base class for modifiers that work on the world space pose of the skeleton, like IK.
+	// Pose modifiers run after all other modifiers of a skeleton, in bone order.
+	// They may read the world space transforms of any bone from the pose, but must call HkSkeleton::updatePose
+	// on every bone whose local transform they modify, so that the following pose modifiers see the result.
+	class PoseModifier : public Modifier {
+	protected:
+		PoseModifier() {}
+
+	public:
+		virtual bool isPoseModifier() const final { return true; }
+		virtual bool onApply(Bone*, BoneData&) final { return false; }
+
+		// Must be defined in a derived pose modifier class for it to be valid.
+		virtual void onApplyPose(Bone*, Pose&) = 0;
 	};
 
 	namespace Impl {
@@ -37,6 +60,12 @@ namespace HkModifier {
 			int unk02;
 		};
 
+		// The time elapsed since the last frame of a character, in seconds.
+		inline float getDeltaTime(void* ChrIns)
+		{
+			return *PointerChain::make<float>(ChrIns, 0xB0);
+		}
+
 		// Iterate over all SpEffect entries in the linked list to match ours.
 		inline bool checkSpEffectID(void* ChrIns, int spEffectID)
 		{
@@ -51,4 +80,6 @@ namespace HkModifier {
 }
 
 #include "BaseModifiers.h"
-#include "CustomModifiers.h"
\ No newline at end of file
+#include "CustomModifiers.h"
+#include "IKModifiers.h"
+#include "BlendModifiers.h"
\ No newline at end of file
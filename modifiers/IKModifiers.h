@@ -0,0 +1,207 @@
+#pragma once
+
+namespace HkModifier {
+	// Inverse kinematics modifiers. These are pose modifiers: they run after all other modifiers,
+	// against the world space pose of the skeleton, and must be applied as bone modifiers.
+	namespace IK {
+		// A position for an IK modifier to reach for or look at.
+		// Either a fixed point in character space (relative to the character's position and orientation),
+		// or a pointer to a world space position that is read every frame and can be updated externally.
+		struct Target {
+			Target(V4D chrSpacePos) : pos(chrSpacePos.isfinite() ? chrSpacePos.flatten<V4D::CoordinateAxis::W>() : V4D(0.0f)) {}
+			Target(const V4D* worldPos) : worldPos(worldPos) {}
+
+			V4D get(HkSkeleton* skeleton) const
+			{
+				if (!!this->worldPos) return this->worldPos->flatten<V4D::CoordinateAxis::W>();
+				return (skeleton->getChrPos() + this->pos.qTransform(skeleton->getChrQ())).flatten<V4D::CoordinateAxis::W>();
+			}
+
+			V4D pos{ 0.0f };
+			const V4D* worldPos = nullptr;
+		};
+
+		namespace Impl {
+			// Applies a world space rotation to a bone by modifying its local orientation.
+			inline void rotateBone(HkSkeleton::HkBone* bone, HkSkeleton::HkPose& pose, const V4D rotation)
+			{
+				const V4D worldQ = pose.getQ(bone->getIndex());
+				auto& bData = bone->getBoneData();
+				bData.qSpatial = bData.qSpatial.qMul(worldQ.qConjugate().qMul(rotation).qMul(worldQ)).normalize();
+				bone->getSkeleton()->updatePose(bone);
+			}
+
+			inline float safeAcos(const float x)
+			{
+				return acosf(std::clamp(x, -1.0f, 1.0f));
+			}
+		}
+
+		// Analytic two bone IK, for limbs. Apply to the end bone of the limb (e.g. "L_Foot" or "R_Hand"),
+		// its parent and grandparent are rotated so that it reaches the target.
+		// The limb bends in the plane it is currently bent in, or towards the bend hint (in character space) when it is straight.
+		class TwoBone : public PoseModifier {
+		public:
+			TwoBone(Target target, V4D bendHint = V4D(0.0f, 0.0f, 1.0f), float weight = 1.0f) : target(target),
+				bendHint(bendHint.isfinite() && !bendHint.iszero() ? bendHint.flatten<V4D::CoordinateAxis::W>() : V4D(0.0f, 0.0f, 1.0f)),
+				weight(std::isfinite(weight) ? std::clamp(weight, 0.0f, 1.0f) : 1.0f) {}
+			virtual TwoBone* clone() const { return new TwoBone(*this); }
+
+			virtual void onApplyPose(Bone* bone, Pose& pose)
+			{
+				Bone* mid = bone->getParent();
+				Bone* root = !!mid ? mid->getParent() : nullptr;
+				if (!root) return;
+
+				HkSkeleton* skeleton = bone->getSkeleton();
+				const V4D a = pose.getPos(root->getIndex());
+				const V4D b = pose.getPos(mid->getIndex());
+				const V4D c = pose.getPos(bone->getIndex());
+				const V4D t = c + (this->target.get(skeleton) - c) * this->weight;
+
+				const float lab = (b - a).length();
+				const float lcb = (c - b).length();
+				if (lab < FLT_EPSILON || lcb < FLT_EPSILON) return;
+
+				const float eps = 1e-4f;
+				const float lat = std::clamp((t - a).length(), eps, lab + lcb - eps);
+
+				const V4D ac = (c - a).normalize();
+				const V4D ab = (b - a).normalize();
+				const V4D cb = (c - b).normalize();
+
+				// current and desired interior angles of the triangle formed by the limb
+				const float ac_ab_0 = Impl::safeAcos(ac.dot3(ab));
+				const float ba_bc_0 = Impl::safeAcos(ab.qNegate().dot3(cb));
+				const float ac_ab_1 = Impl::safeAcos((lcb * lcb - lab * lab - lat * lat) / (-2.0f * lab * lat));
+				const float ba_bc_1 = Impl::safeAcos((lat * lat - lab * lab - lcb * lcb) / (-2.0f * lab * lcb));
+
+				V4D bendAxis = ac.cross(ab);
+				if (bendAxis.length2() < 1e-6f) bendAxis = ac.cross(this->bendHint.qTransform(skeleton->getChrQ()));
+				if (bendAxis.length2() < 1e-6f) return;
+				bendAxis = bendAxis.normalize();
+
+				// bend the limb in its plane to match the distance to the target, then swing it towards the target
+				Impl::rotateBone(root, pose, V4D(bendAxis, ac_ab_1 - ac_ab_0));
+				Impl::rotateBone(mid, pose, V4D(bendAxis, ba_bc_1 - ba_bc_0));
+
+				const V4D reached = (pose.getPos(bone->getIndex()) - a).normalize();
+				Impl::rotateBone(root, pose, reached.qFromTo((t - a).normalize()));
+			}
+
+			Target target;
+			V4D bendHint;
+			float weight;
+		};
+
+		// Rotates a bone so that its forward axis (in bone space) points at the target, up to a maximum angle in radians.
+		// To distribute the rotation, apply it to the neck with a partial weight and to the head with the full weight.
+		class LookAt : public PoseModifier {
+		public:
+			LookAt(Target target, V4D forward = V4D(0.0f, 0.0f, 1.0f), float maxAngle = 1.5707964f, float weight = 1.0f) : target(target),
+				forward(forward.isfinite() && !forward.iszero() ? forward.flatten<V4D::CoordinateAxis::W>().normalize() : V4D(0.0f, 0.0f, 1.0f)),
+				maxAngle(std::isfinite(maxAngle) ? (std::max)(maxAngle, 0.0f) : 1.5707964f),
+				weight(std::isfinite(weight) ? std::clamp(weight, 0.0f, 1.0f) : 1.0f) {}
+			virtual LookAt* clone() const { return new LookAt(*this); }
+
+			virtual void onApplyPose(Bone* bone, Pose& pose)
+			{
+				const int16_t index = bone->getIndex();
+				const V4D toTarget = this->target.get(bone->getSkeleton()) - pose.getPos(index);
+				if (toTarget.length2() < 1e-6f) return;
+
+				const V4D facing = this->forward.qTransform(pose.getQ(index));
+				V4D rotation = facing.qFromTo(toTarget.normalize());
+
+				V4D axis = rotation.flatten<V4D::CoordinateAxis::W>();
+				if (axis.length2() < 1e-12f) return;
+
+				const float angle = 2.0f * Impl::safeAcos(rotation[3]);
+				Impl::rotateBone(bone, pose, V4D(axis.normalize(), (std::min)(angle, this->maxAngle) * this->weight));
+			}
+
+			Target target;
+			V4D forward;
+			float maxAngle;
+			float weight;
+		};
+
+		// Iterative FABRIK solver for chains of any length. Apply to the end bone of the chain,
+		// it and chainLength of its ancestors are rotated so that the end bone reaches the target.
+		class FABRIK : public PoseModifier {
+		public:
+			static constexpr int maxChainLength = 15;
+
+			FABRIK(Target target, int chainLength, int maxIterations = 8, float tolerance = 0.001f, float weight = 1.0f) : target(target),
+				chainLength(std::clamp(chainLength, 1, maxChainLength)), maxIterations((std::max)(maxIterations, 1)),
+				tolerance(std::isfinite(tolerance) ? (std::max)(tolerance, 0.0f) : 0.001f),
+				weight(std::isfinite(weight) ? std::clamp(weight, 0.0f, 1.0f) : 1.0f) {}
+			virtual FABRIK* clone() const { return new FABRIK(*this); }
+
+			virtual void onApplyPose(Bone* bone, Pose& pose)
+			{
+				// gather the chain from its root to the end bone, on the stack
+				Bone* chain[maxChainLength + 1];
+				int count = 0;
+				for (Bone* current = bone; !!current && count <= this->chainLength; current = current->getParent()) {
+					chain[count++] = current;
+				}
+				if (count < 2) return;
+				std::reverse(chain, chain + count);
+
+				V4D positions[maxChainLength + 1];
+				float lengths[maxChainLength];
+				float totalLength = 0.0f;
+				for (int i = 0; i < count; i++) {
+					positions[i] = pose.getPos(chain[i]->getIndex());
+					if (i == 0) continue;
+					lengths[i - 1] = (positions[i] - positions[i - 1]).length();
+					totalLength += lengths[i - 1];
+				}
+
+				const V4D origin = positions[0];
+				const V4D end = positions[count - 1];
+				const V4D t = end + (this->target.get(bone->getSkeleton()) - end) * this->weight;
+
+				if ((t - origin).length() >= totalLength) {
+					// out of reach, stretch the chain towards the target
+					const V4D direction = (t - origin).normalize();
+					for (int i = 1; i < count; i++) {
+						positions[i] = positions[i - 1] + direction * lengths[i - 1];
+					}
+				}
+				else {
+					for (int iteration = 0; iteration < this->maxIterations; iteration++) {
+						if ((positions[count - 1] - t).length() <= this->tolerance) break;
+
+						positions[count - 1] = t;
+						for (int i = count - 2; i >= 0; i--) {
+							positions[i] = positions[i + 1] + (positions[i] - positions[i + 1]).scaleTo(lengths[i]);
+						}
+
+						positions[0] = origin;
+						for (int i = 1; i < count; i++) {
+							positions[i] = positions[i - 1] + (positions[i] - positions[i - 1]).scaleTo(lengths[i - 1]);
+						}
+					}
+				}
+
+				// turn the solved positions back into rotations, from the root down
+				for (int i = 0; i < count - 1; i++) {
+					const V4D jointPos = pose.getPos(chain[i]->getIndex());
+					const V4D from = pose.getPos(chain[i + 1]->getIndex()) - jointPos;
+					const V4D to = positions[i + 1] - jointPos;
+					if (from.length2() < 1e-12f || to.length2() < 1e-12f) continue;
+
+					Impl::rotateBone(chain[i], pose, from.normalize().qFromTo(to.normalize()));
+				}
+			}
+
+			Target target;
+			int chainLength;
+			int maxIterations;
+			float tolerance;
+			float weight;
+		};
+	}
+}
@@ -3,10 +3,12 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <unordered_map>
 
 #include "../include/VxD.h"
+#include "../include/faststring.h"
 #include "../include/PointerChain.h"
 
 namespace HkModifier { class Modifier; };
@@ -17,21 +19,24 @@ public:
 	virtual ~HkObj() {}
 
 	// Adds a modifier to the object which will be applied when HkSkeleton::updateAll is called.
-	inline int addModifier(HkModifier::Modifier* modifier);
+	// Returns the modifier's index, or -1 if the modifier can not be added to this object.
+	virtual inline int addModifier(HkModifier::Modifier* modifier);
 
 	// Returns a modifier by its index, which can be gotten from HkObj::addModifier.
-	HkModifier::Modifier* getModifier(const int modifierID) { return this->modifiers.size() > modifierID ? this->modifiers[modifierID].get() : nullptr; }
+	HkModifier::Modifier* getModifier(const int modifierID) { return this->isModifierIndex(modifierID) ? this->modifiers[modifierID].get() : nullptr; }
 	// Check if a modifier exists by its index.
-	bool hasModifier(const int modifierID) { return this->modifiers.size() > modifierID && !!this->modifiers[modifierID]; }
+	bool hasModifier(const int modifierID) { return this->isModifierIndex(modifierID) && !!this->modifiers[modifierID]; }
 	// Returns a reference to the vector that holds pointers to all of the modifiers.
 	auto& getAllModifiers() { return this->modifiers; }
 	// Removes a modifier by its index.
-	void removeModifier(const int modifierID) { if (this->modifiers.size() > modifierID) this->modifiers[modifierID] = nullptr; }
+	void removeModifier(const int modifierID) { if (this->isModifierIndex(modifierID)) this->modifiers[modifierID] = nullptr; }
 	// Removes all modifiers.
 	void clearAllModifiers() { this->modifiers.clear(); }
 
 protected:
 	std::vector<std::unique_ptr<HkModifier::Modifier>> modifiers{};
+
+	bool isModifierIndex(const int modifierID) const { return modifierID >= 0 && static_cast<size_t>(modifierID) < this->modifiers.size(); }
 };
 
 class HkSkeleton : public HkObj {
@@ -163,17 +168,74 @@ public:
 		HkBone::HkBoneData* defaultBoneData;
 	};
 
+	// The world space transforms of every bone in a skeleton, stored as a structure of arrays indexed by bone index.
+	// Lanes follow the game's xzy layout. Populated by HkSkeleton::updatePose after all modifiers have been applied.
+	// Orientations are composed as in HkBone::getWorldQ<false>, not as in HkBone::getWorldQ, which is relative to the default pose:
+	// root bones are placed at the character's position and rotated by the character's orientation,
+	// child translations are rotated by the parent's world orientation without inheriting the parent's scale.
+	struct HkPose {
+		std::vector<float> posX, posZ, posY;
+		std::vector<float> qX, qZ, qY, qW;
+		std::vector<float> scaleX, scaleZ, scaleY;
+		// Incremented every time the pose is recomputed, can be used to detect stale reads.
+		uint64_t frame = 0;
+
+		void resize(int boneCount)
+		{
+			for (auto* lane : { &posX, &posZ, &posY, &qX, &qZ, &qY, &qW, &scaleX, &scaleZ, &scaleY }) {
+				lane->assign(boneCount, 0.0f);
+			}
+		}
+
+		int size() const { return static_cast<int>(this->qW.size()); }
+		V4D getPos(int16_t index) const { return V4D(posX[index], posZ[index], posY[index]); }
+		V4D getQ(int16_t index) const { return V4D(qX[index], qZ[index], qY[index], qW[index]); }
+		V4D getScale(int16_t index) const { return V4D(scaleX[index], scaleZ[index], scaleY[index]); }
+
+		// Converts the whole pose into world space matrices, one per bone. See VxD::mFromTransforms.
+		void toMatrices(m128Matrix* out) const
+		{
+			const float* q[4] = { qX.data(), qZ.data(), qY.data(), qW.data() };
+			const float* pos[3] = { posX.data(), posZ.data(), posY.data() };
+			const float* scale[3] = { scaleX.data(), scaleZ.data(), scaleY.data() };
+			VxD::mFromTransforms(q, pos, scale, out, this->size());
+		}
+
+		void set(int16_t index, const V4D pos, const V4D q, const V4D scale)
+		{
+			alignas(16) float p[4], r[4], sc[4];
+			_mm_store_ps(p, pos);
+			_mm_store_ps(r, q);
+			_mm_store_ps(sc, scale);
+			posX[index] = p[0]; posZ[index] = p[1]; posY[index] = p[2];
+			qX[index] = r[0]; qZ[index] = r[1]; qY[index] = r[2]; qW[index] = r[3];
+			scaleX[index] = sc[0]; scaleZ[index] = sc[1]; scaleY[index] = sc[2];
+		}
+	};
+
+	// Intermediate objects of the character instance that most pointer chains go through.
+	// They are resolved by HkSkeleton::refreshModules once per frame, so that hot chains can start from them instead of from the character instance.
+	// The sub-block pointers are read again every frame, and the character transform is only resolved again when one of them changed.
+	struct HkModules {
+		uint8_t* module = nullptr;   // ChrIns, 0x190
+		uint8_t* behavior = nullptr; // module, 0x28
+		uint8_t* physics = nullptr;  // module, 0x68
+		uint8_t* ride = nullptr;     // module, 0xE8
+	};
+
 	// Maps a character's skeleton and all its bones.
 	// Will throw if a character instance misses necessary data.
-	HkSkeleton(void* ChrIns) : HkObj(), ChrIns(ChrIns),
-		chrPos(*PointerChain::make<V4D>(ChrIns, 0x190, 0x68, 0x70)),
-		chrQ(*PointerChain::make<V4D>(ChrIns, 0x190, 0x68, 0x50))
+	HkSkeleton(void* ChrIns) : HkObj(), ChrIns(ChrIns)
 	{
 		if (!ChrIns) {
 			throw std::runtime_error("ChrIns is nullptr.");
 		}
 
-		uint8_t** pHkbCharacter = PointerChain::make<uint8_t*>(ChrIns, 0x190, 0x28, 0x10u, 0x30u).get();
+		if (!this->refreshModules()) {
+			throw std::runtime_error(!this->modules.module ? "Character modules not found." : "Character transform not found.");
+		}
+
+		uint8_t** pHkbCharacter = PointerChain::make<uint8_t*>(this->modules.behavior, 0x10u, 0x30u).get();
 		if (!pHkbCharacter) {
 			throw std::runtime_error("hkbCharacter not found.");
 		}
@@ -207,9 +269,9 @@ public:
 		// Iterate over each bone and create a HkBone instance.
 		for (int i = 0; i < boneCount; i++) {
 			const char* name = hkaSkeleton->boneNameLayout[i * 2];
-			bones[i] = std::make_unique<HkBone>(this, name, i);
+			bones[i] = std::make_unique<HkBone>(this, std::string(name, faststring::length(name)), i);
 			HkBone* bone = bones[i].get();
-			this->skeletonMap[name] = bone;
+			this->skeletonMap[bone->getName()] = bone;
 		}
 
 		// Iterate over every HkBone instance and assign the parents and children.
@@ -227,32 +289,142 @@ public:
 				}
 			}
 		}
+
+		// Order the bones so that every parent comes before its children, for single pass hierarchical updates.
+		this->hierarchyOrder.reserve(boneCount);
+		for (auto& bone : bones) {
+			if (!!bone && !bone->getParent()) this->hierarchyOrder.push_back(bone->getIndex());
+		}
+		for (size_t i = 0; i < this->hierarchyOrder.size(); i++) {
+			for (HkBone* child : bones[this->hierarchyOrder[i]]->getChildren()) {
+				this->hierarchyOrder.push_back(child->getIndex());
+			}
+		}
 	}
 
 	~HkSkeleton() {};
+	// Adds a modifier to every bone of the skeleton. Pose modifiers can not be skeleton modifiers, they are rejected with -1.
+	virtual inline int addModifier(HkModifier::Modifier* modifier);
 	void* getChrIns() { return ChrIns; }
 	HkBone::HkBoneData* getBoneData() { return this->boneData; }
 	HkBone::HkBoneData* getDefaultBoneData() { return this->defaultBoneData; }
-	const V4D& getChrPos() { return this->chrPos; }
-	const V4D& getChrQ() { return this->chrQ; }
+	// The character's position and orientation. While the character has no transform (see HkSkeleton::refreshModules), the origin and identity.
+	const V4D& getChrPos() { return !!this->chrPos ? *this->chrPos : HkSkeleton::noChrPos; }
+	const V4D& getChrQ() { return !!this->chrQ ? *this->chrQ : HkSkeleton::noChrQ; }
 	int getBoneCount() const { return this->hkBones.size(); }
 	// Retrieve a bone by its index (not id!), as it is in the skeleton.
 	HkBone* getBone(int16_t boneIndex) { return this->getBoneCount() > boneIndex ? hkBones[boneIndex].get() : nullptr; }
 	// Attempt to match a name with all of the names of the bones in the skeleton, returns a pointer to the matched bone on success or nullptr on failure.
-	HkBone* getBone(const std::string& name) { auto iter = this->skeletonMap.find(name); return iter != this->skeletonMap.end() ? iter->second : nullptr; }
+	HkBone* getBone(const std::string_view name) { auto iter = this->skeletonMap.find(name); return iter != this->skeletonMap.end() ? iter->second : nullptr; }
 	auto& getBones() { return this->hkBones; }
 
+	// Enables or disables publishing the world space pose after modifiers are applied each frame.
+	void setPoseExport(bool enabled)
+	{
+		this->poseExport = enabled;
+		if (enabled) {
+			this->pose.resize(this->getBoneCount());
+		}
+		else {
+			this->pose = HkPose{};
+		}
+	}
+
+	bool isPoseExported() const { return this->poseExport; }
+	// Returns the world space pose published by the last HkSkeleton::updateAll, or nullptr if pose export is disabled.
+	// Only valid on the thread that updates the skeleton.
+	const HkPose* getPose() const { return this->poseExport && this->pose.frame ? &this->pose : nullptr; }
+
+	// Computes the world space transform of every bone in a single pass over the hierarchy.
+	void updatePose()
+	{
+		if (this->pose.size() != this->getBoneCount()) this->pose.resize(this->getBoneCount());
+
+		for (int16_t index : this->hierarchyOrder) {
+			this->updateBonePose(index);
+		}
+
+		this->pose.frame++;
+	}
+
+	// Recomputes the world space transform of a bone and all of its descendants after its local transform was modified.
+	// Used by pose modifiers, see HkModifier::PoseModifier.
+	void updatePose(HkBone* bone)
+	{
+		this->updateBonePose(bone->getIndex());
+		for (HkBone* child : bone->getChildren()) {
+			this->updatePose(child);
+		}
+	}
+
+	// The number of HkSkeleton::updateAll calls so far, used by modifiers to advance their state once per frame.
+	uint64_t getFrameCount() const { return this->frameCount; }
+
+	// The cached module block pointers of the character, see HkSkeleton::HkModules.
+	const HkModules& getModules() const { return this->modules; }
+
+	// Validates the cached module blocks against the character instance and resolves the character transform again if they changed.
+	// Returns false if the character has no module block or no transform, the skeleton must not be updated then.
+	bool refreshModules()
+	{
+		return this->refreshModules(*PointerChain::make<uint8_t*>(this->ChrIns, 0x190));
+	}
+
+	// Same as above, with the module block pointer already read from the character instance, see SkeletonMan::hkHookFn.
+	bool refreshModules(uint8_t* module)
+	{
+		if (!module) {
+			this->modules = {};
+			this->chrPos = nullptr;
+			this->chrQ = nullptr;
+			return false;
+		}
+
+		// the sub-blocks can be replaced without the module block changing, they are compared too
+		const HkModules current = { module, *PointerChain::make<uint8_t*>(module, 0x28), *PointerChain::make<uint8_t*>(module, 0x68), *PointerChain::make<uint8_t*>(module, 0xE8) };
+		if (current.module != this->modules.module || current.behavior != this->modules.behavior
+			|| current.physics != this->modules.physics || current.ride != this->modules.ride) {
+			this->modules = current;
+
+			// The character's position and orientation live in the physics module, they move with it.
+			std::tie(this->chrPos, this->chrQ) = ChrTransformChains::resolve(this->ChrIns);
+		}
+
+		return !!this->chrPos && !!this->chrQ;
+	}
+
+	// The pose the pose modifiers of this skeleton work on. Only up to date while they are being applied.
+	HkPose& getWorkingPose() { return this->pose; }
+
 	// Updates all bones and applies all modifiers.
 	void updateAll()
 	{
-		auto& modifiers = this->getAllModifiers();
-		auto skeletonModifiers = std::vector<HkModifier::Modifier*>(modifiers.size());
-		for (auto& modifier : modifiers) {
+		this->updateAll(*PointerChain::make<uint8_t*>(this->ChrIns, 0x190));
+	}
+
+	// Same as above, with the module block pointer already read from the character instance, see SkeletonMan::hkHookFn.
+	void updateAll(uint8_t* module)
+	{
+		// the character is being loaded or unloaded, skip the frame
+		if (!this->refreshModules(module)) return;
+
+		this->frameCount++;
+
+		// The scratch vectors keep their capacity between frames, so this does not allocate in steady state.
+		auto& skeletonModifiers = this->skeletonModifierScratch;
+		skeletonModifiers.clear();
+		this->poseModifierScratch.clear();
+		this->renormalizeScratch.clear();
+		for (auto& modifier : this->getAllModifiers()) {
 			skeletonModifiers.push_back(modifier.get());
 		}
 		for (auto& bone : this->hkBones) {
 			if (!bone) continue;
 
+			// Only rotations that a modifier wrote to are renormalized, the ones written by the game are left alone.
+			V4D& qSpatial = bone->getBoneData().qSpatial;
+			const __m128i rotation = qSpatial;
+
 			// Get and apply all skeleton modifiers to every bone.
 			for (auto& modifier : skeletonModifiers) {
 				if (!modifier) continue;
@@ -260,17 +432,68 @@ public:
 			}
 
 			bone->applyAllModifiers();
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(rotation, qSpatial)) != 0xFFFF) this->renormalizeScratch.push_back(&qSpatial);
+		}
+
+		// Modifiers do not normalize the rotations they write, it is done here once per bone with a written rotation, in batches.
+		VxD::Kernels::qNormalize(this->renormalizeScratch.data(), this->renormalizeScratch.size());
+
+		// Pose modifiers queued while applying the other modifiers run last, against the world space pose.
+		if (this->poseExport || !this->poseModifierScratch.empty()) {
+			this->updatePose();
+			this->applyPoseModifiers();
 		}
 	}
 
 private:
+	// The character's position and orientation share the physics module prefix, it is only resolved once.
+	using ChrTransformChains = PointerChain::Bundle<PointerChain::Chain<V4D, 0x190u, 0x68u, 0x70u>, PointerChain::Chain<V4D, 0x190u, 0x68u, 0x50u>>;
+
+	static inline const V4D noChrPos{ 0.0f };
+	static inline const V4D noChrQ{ 0.0f, 0.0f, 0.0f, 1.0f };
+
 	void* ChrIns;
-	const V4D& chrPos;
-	const V4D& chrQ;
+	const V4D* chrPos = nullptr;
+	const V4D* chrQ = nullptr;
+	HkModules modules = {};
 	HkBone::HkBoneData* boneData = nullptr;
 	HkBone::HkBoneData* defaultBoneData = nullptr;
 	std::vector<std::unique_ptr<HkBone>> hkBones = {};
-	std::unordered_map<std::string, HkBone*> skeletonMap = {};
+	// The keys view the names owned by the bones, so lookups by std::string_view do not build a std::string.
+	std::unordered_map<std::string_view, HkBone*, faststring::Hash> skeletonMap = {};
+	std::vector<int16_t> hierarchyOrder = {};
+	HkPose pose = {};
+	bool poseExport = false;
+	// Per-frame scratch storage, reused by HkSkeleton::updateAll.
+	std::vector<HkModifier::Modifier*> skeletonModifierScratch = {};
+	std::vector<std::pair<HkBone*, HkModifier::Modifier*>> poseModifierScratch = {};
+	std::vector<V4D*> renormalizeScratch = {};
+	uint64_t frameCount = 0;
+
+	inline void applyPoseModifiers();
+
+	void updateBonePose(int16_t index)
+	{
+		HkPose& pose = this->pose;
+		const HkBone::HkBoneData& bData = this->boneData[index];
+		HkBone* parent = this->hkBones[index]->getParent();
+
+		V4D pos, q, scale;
+		if (!parent) {
+			pos = this->getChrPos();
+			q = this->getChrQ().qMul(bData.qSpatial);
+			scale = bData.xzyScale;
+		}
+		else {
+			const int16_t parentIndex = parent->getIndex();
+			const V4D parentQ = pose.getQ(parentIndex);
+			pos = pose.getPos(parentIndex) + bData.xzyVec.qTransform(parentQ);
+			q = parentQ.qMul(bData.qSpatial);
+			scale = _mm_mul_ps(pose.getScale(parentIndex), bData.xzyScale);
+		}
+
+		pose.set(index, pos, q, scale);
+	}
 };
 
 #include "../modifiers/HkModifierCore.h"
@@ -281,9 +504,24 @@ inline int HkObj::addModifier(HkModifier::Modifier* modifier)
 	return this->modifiers.size() - 1;
 }
 
+inline int HkSkeleton::addModifier(HkModifier::Modifier* modifier)
+{
+	// a pose modifier applied to every bone would run once per bone, each time with a different bone as the end of its chain
+	if (modifier->isPoseModifier()) return -1;
+	return HkObj::addModifier(modifier);
+}
+
 inline bool HkSkeleton::HkBone::applyModifier(HkModifier::Modifier* modifier)
 {
-	if (!!modifier) return modifier->apply(this);
+	if (!modifier) return false;
+
+	// Pose modifiers are deferred until the world space pose of the skeleton is available.
+	if (modifier->isPoseModifier()) {
+		this->getSkeleton()->poseModifierScratch.emplace_back(this, modifier);
+		return false;
+	}
+
+	return modifier->apply(this);
 }
 
 inline void HkSkeleton::HkBone::applyAllModifiers()
@@ -294,3 +532,10 @@ inline void HkSkeleton::HkBone::applyAllModifiers()
 		this->applyModifier(modifier.get());
 	}
 }
+
+inline void HkSkeleton::applyPoseModifiers()
+{
+	for (auto& [bone, modifier] : this->poseModifierScratch) {
+		modifier->applyPose(bone, this->pose);
+	}
+}
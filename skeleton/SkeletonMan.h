@@ -1,6 +1,7 @@
 #pragma once
 
 #include <tuple>
+#include <algorithm>
 #include <string>
 #include <memory>
 #include <string_view>
@@ -37,6 +38,7 @@ public:
 		// Add a modifier to all bones in the skeleton.
 		template <typename T> void addSkeletonModifier(const T& modifier)
 		{
+			static_assert(!std::is_base_of_v<HkModifier::PoseModifier, T>, "Pose modifiers (e.g. IK) must be added with addBoneModifier.");
 			this->skeletonModifiers.emplace_back(std::make_unique<T>(modifier));
 		}
 
@@ -55,7 +57,11 @@ public:
 			}
 		}
 
+		// Publish the world space pose of matched characters every frame, see SkeletonMan::getSkeleton and HkSkeleton::getPose.
+		void setPoseExport(bool enabled = true) { this->poseExport = enabled; }
+
 	private:
+		bool poseExport = false;
 		std::vector<std::vector<std::unique_ptr<ChrMatcher::Matcher>>> conditions{};
 		std::vector<std::tuple<std::unique_ptr<HkModifier::Modifier>, std::vector<int16_t>, std::vector<std::string>>> boneModifiers{};
 		std::vector<std::unique_ptr<HkModifier::Modifier>> skeletonModifiers{};
@@ -99,10 +105,25 @@ public:
 		return *SkeletonMan::targets.back().get(); 
 	}
 
-	// Initializes the hooks by scanning for RTTI data. Can be provided a pointer to a custom scanner instance.
+	// Returns the skeleton managed for a character instance, or nullptr if the character did not match any target.
+	// Must be called from the thread that updates the skeletons.
+	static HkSkeleton* getSkeleton(void* ChrIns)
+	{
+		auto iter = SkeletonMan::skeletons.find(ChrIns);
+		return iter != SkeletonMan::skeletons.end() ? iter->second.get() : nullptr;
+	}
+
+	// Initializes the hooks by scanning for the RTTI data of the hooked classes. Can be provided a pointer to a custom scanner instance.
+	// The scan results can be cached in a file, rttiCachePath, to skip the scan on later launches of the same executable (see RTTIScanner::scanFor).
+	// The cache holds every class of the executable, so the first launch with a cache does a full scan instead of stopping at the hooked classes.
+	// The cache is off by default. A relative path is relative to the working directory of the game, not to the dll or the executable.
+	// Fails, without hooking anything, if any of the hooked classes is not found.
 	// Only call this after you are done editing the SkeletonMan targets.
-	bool initialize(RTTIScanner* scanner = nullptr)
+	bool initialize(RTTIScanner* scanner = nullptr, const char* rttiCachePath = nullptr)
 	{
+		// Select the SIMD kernels for this CPU.
+		CPUFeatures::initialize();
+
 		if (this->scanner && isScannerOwner) delete this->scanner;
 
 		if (scanner) {
@@ -113,7 +134,9 @@ public:
 			this->scanner = new RTTIScanner();
 		}
 
-		if (!this->scanner->scan()) return false;
+		// only the hooked classes are needed, without a cache the scan stops once all of them are found
+		auto classes = this->scanner->scanFor({ "CS::PlayerIns", "CS::EnemyIns", "CS::NoUpdateInterface" }, nullptr, rttiCachePath);
+		if (std::find(classes.begin(), classes.end(), nullptr) != classes.end()) return false;
 
 		// We hook:
 		// - the final character instance initialization function
@@ -150,6 +173,9 @@ private:
 
 	static inline std::vector<std::unique_ptr<Target>> targets{};
 	static inline std::unordered_map<void*, std::unique_ptr<HkSkeleton>> skeletons{};
+	// Per-frame scratch storage, reused by SkeletonMan::hkHookFn.
+	static inline std::vector<void*> chrInsScratch{};
+	static inline std::vector<uint8_t*> moduleScratch{};
 
 	// Attempts to create a new HkSkeleton instance with a given ChrIns.
 	// Used inside the constructor hook.
@@ -177,6 +203,7 @@ private:
 					skeleton = SkeletonMan::makeSkeleton(ChrIns);
 					if (!skeleton) return;
 				}
+				if (target->poseExport) skeleton->setPoseExport(true);
 				for (auto& modifier : target->skeletonModifiers) {
 					skeleton->addModifier(modifier.get());
 				}
@@ -196,16 +223,30 @@ private:
 	}
 
 	// Removes the managed skeleton once its character instance has been unloaded or destroyed.
+	// The character's memory is decommitted with it, so the readable ranges used by range safe pointer chains are refreshed.
 	static void dtorHookFn(void* ChrIns)
 	{
 		SkeletonMan::skeletons.erase(ChrIns);
+		MemoryRanges::invalidate();
 	}
 
 	// Iterates over and updates all skeletons.
+	// The module blocks of all characters are read first, in one batch, so that their cache misses overlap.
 	static void hkHookFn()
 	{
+		auto& chrInses = SkeletonMan::chrInsScratch;
+		auto& modules = SkeletonMan::moduleScratch;
+		chrInses.clear();
+		for (auto& iter : SkeletonMan::skeletons) {
+			chrInses.push_back(iter.first);
+		}
+		modules.resize(chrInses.size());
+		PointerChain::resolveBatch<PointerChain::Chain<uint8_t, 0x190, 0x0>>(chrInses.data(), modules.data(), chrInses.size());
+
+		// the map is not modified in between, so it is iterated in the same order
+		size_t i = 0;
 		for (auto& iter : SkeletonMan::skeletons) {
-			iter.second->updateAll();
+			iter.second->updateAll(modules[i++]);
 		}
 	}
 };
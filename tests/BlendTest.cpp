@@ -0,0 +1,131 @@
+#include <math.h>
+
+#include "FakeCharacter.h"
+#include "Test.h"
+
+// The blend modifiers move an eased weight over a duration, one step of the character's frame time per frame.
+// A blended ScaleSize of 2 shows the weight directly: the bone's scale is 1 + weight.
+
+namespace {
+	using Fake::deltaTime;
+	using Fake::spEffectID;
+
+	constexpr float duration = 0.25f;
+
+	float smoothstep(const float p)
+	{
+		return p * p * (3.0f - 2.0f * p);
+	}
+
+	// The weight of a blend that has been moving towards 1 for a number of frames.
+	float expectedWeight(const int frames)
+	{
+		return smoothstep(std::clamp(frames * deltaTime / duration, 0.0f, 1.0f));
+	}
+
+	float frame(Fake::Character& character, HkSkeleton& skeleton, const char* bone = "Pelvis")
+	{
+		character.resetPose();
+		skeleton.updateAll();
+		return skeleton.getBone(bone)->getBoneData().xzyScale[0] - 1.0f;
+	}
+}
+
+TEST(BlendWeightProgression)
+{
+	Fake::Character character;
+	HkSkeleton skeleton(character.chrIns);
+	HkModifier::Blend blend(HkModifier::ScaleSize(V4D(2.0f)), duration);
+	skeleton.getBone("Pelvis")->addModifier(&blend);
+
+	// 15 frames to the full weight, then it stays there
+	float previous = 0.0f;
+	for (int i = 1; i <= 20; i++) {
+		const float weight = frame(character, skeleton);
+		if (!CHECK(fabsf(weight - expectedWeight(i)) < 1e-5f)) printf("  frame %d: weight %f, expected %f\n", i, weight, expectedWeight(i));
+		CHECK(weight >= previous);
+		previous = weight;
+	}
+	CHECK(previous == 1.0f);
+
+	// a duration of 0 is applied at the full weight from the first frame
+	Fake::Character other;
+	HkSkeleton instant(other.chrIns);
+	HkModifier::Blend instantBlend(HkModifier::ScaleSize(V4D(2.0f)), 0.0f);
+	instant.getBone("Pelvis")->addModifier(&instantBlend);
+	CHECK(frame(other, instant) == 1.0f);
+}
+
+// A blend applied to the whole skeleton advances once per frame, not once per bone. ScaleSize stops at the first bone,
+// so a blended ScaleLength is used instead: every bone offset of 0.4 becomes 0.4 * (1 + weight).
+TEST(SkeletonBlendAdvancesOncePerFrame)
+{
+	Fake::Character character;
+	HkSkeleton skeleton(character.chrIns);
+	HkModifier::Blend blend(HkModifier::ScaleLength(2.0f), duration);
+	skeleton.addModifier(&blend);
+
+	for (int i = 1; i <= 5; i++) {
+		frame(character, skeleton);
+		for (int16_t bone = 1; bone < Fake::boneCount; bone++) {
+			CHECK(fabsf(skeleton.getBone(bone)->getBoneData().xzyVec[1] - 0.4f * (1.0f + expectedWeight(i))) < 1e-5f);
+		}
+	}
+}
+
+TEST(SpEffectBlendFadesInAndOut)
+{
+	Fake::Character character;
+	HkSkeleton skeleton(character.chrIns);
+	HkModifier::SpEffect::Blend blend(HkModifier::ScaleSize(V4D(2.0f)), spEffectID, duration);
+	skeleton.getBone("Neck")->addModifier(&blend);
+
+	// without the SpEffect, nothing happens
+	for (int i = 0; i < 5; i++) CHECK(frame(character, skeleton, "Neck") == 0.0f);
+
+	character.setSpEffect(true);
+	for (int i = 1; i <= 20; i++) CHECK(fabsf(frame(character, skeleton, "Neck") - expectedWeight(i)) < 1e-5f);
+
+	// once the SpEffect is gone, the weight goes back down the same curve and the bone is left alone
+	character.setSpEffect(false);
+	float previous = 1.0f;
+	for (int i = 1; i <= 20; i++) {
+		const float weight = frame(character, skeleton, "Neck");
+		if (!CHECK(fabsf(weight - expectedWeight(15 - i)) < 1e-5f)) printf("  frame %d after removal: weight %f\n", i, weight);
+		CHECK(weight <= previous);
+		previous = weight;
+	}
+	CHECK(previous == 0.0f);
+
+	// applied again in the middle of the fade out, it turns back from where it was
+	character.setSpEffect(true);
+	for (int i = 0; i < 20; i++) frame(character, skeleton, "Neck");
+	character.setSpEffect(false);
+	for (int i = 0; i < 5; i++) frame(character, skeleton, "Neck");
+	character.setSpEffect(true);
+	CHECK(fabsf(frame(character, skeleton, "Neck") - expectedWeight(11)) < 1e-5f);
+}
+
+// A blended rotation turns by the weighted angle around the same axis.
+TEST(BlendedRotation)
+{
+	Fake::Character character;
+	HkSkeleton skeleton(character.chrIns);
+	const float angle = 1.2f;
+	HkModifier::Blend blend(HkModifier::Rotate(V4D(V4D(0.0f, 0.0f, 1.0f), angle)), duration);
+	skeleton.getBone("Spine")->addModifier(&blend);
+
+	for (int i = 1; i <= 16; i++) {
+		character.resetPose();
+		skeleton.updateAll();
+		const V4D q = skeleton.getBone("Spine")->getBoneData().qSpatial;
+		const float rotated = 2.0f * atan2f(V4D(q[0], q[1], q[2]).length(), q[3]);
+		if (!CHECK(fabsf(rotated - angle * expectedWeight(i)) < 2e-3f)) printf("  frame %d: %f radians, expected %f\n", i, rotated, angle * expectedWeight(i));
+		CHECK(fabsf(q[0]) < 1e-6f && fabsf(q[1]) < 1e-6f);
+	}
+}
+
+int main()
+{
+	return Test::run();
+}
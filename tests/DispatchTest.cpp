@@ -0,0 +1,286 @@
+#include <math.h>
+#include <float.h>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <string_view>
+
+#include "include/VxD.h"
+#include "include/faststring.h"
+#include "include/SignatureScanner.h"
+#include "include/RTTIScanner.h"
+#include "Test.h"
+
+// Every dispatched kernel must give the same results at every tier the CPU supports.
+// Each test forces every supported tier in turn and compares the results with the ones of the SSE2 implementation, bitwise.
+
+namespace {
+	const char* tierNames[] = { "SSE2", "SSE4.1", "AVX2", "AVX-512" };
+
+	// The tiers that can be forced on this CPU, SSE2 first.
+	std::vector<CPUFeatures::Tier> supportedTiers()
+	{
+		std::vector<CPUFeatures::Tier> tiers;
+		for (int tier = 0; tier <= static_cast<int>(CPUFeatures::detect()); tier++) {
+			tiers.push_back(static_cast<CPUFeatures::Tier>(tier));
+		}
+		return tiers;
+	}
+
+	// Runs fn at every supported tier, fn returns the results to compare. Reports the tiers whose results differ from SSE2.
+	template <typename Fn> bool sameAtEveryTier(Fn fn)
+	{
+		bool same = true;
+		decltype(fn()) reference{};
+		for (const CPUFeatures::Tier tier : supportedTiers()) {
+			if (!CHECK(CPUFeatures::force(tier) == tier)) continue;
+
+			auto result = fn();
+			if (tier == CPUFeatures::Tier::SSE2) {
+				reference = std::move(result);
+			}
+			else if (result != reference) {
+				printf("  %s differs from SSE2\n", tierNames[static_cast<int>(tier)]);
+				same = false;
+			}
+		}
+		CPUFeatures::initialize();
+		return same;
+	}
+
+	// Bitwise images of quaternion arrays, so that NaN results compare equal when their bits are.
+	std::vector<uint32_t> bits(const std::vector<V4D>& v)
+	{
+		std::vector<uint32_t> result(v.size() * 4);
+		if (!v.empty()) memcpy(result.data(), v.data(), result.size() * sizeof(uint32_t));
+		return result;
+	}
+
+	// Random quaternions with the values the kernels treat specially mixed in.
+	std::vector<V4D> makeQuaternions(std::mt19937& rng, const size_t count)
+	{
+		std::uniform_real_distribution<float> component(-2.0f, 2.0f);
+		const V4D specials[] = {
+			V4D(0.0f), V4D(NAN), V4D(INFINITY, 1.0f, 0.0f, 0.0f), V4D(0.0f, -INFINITY, 0.0f, 1.0f), V4D(1e30f, 1e30f, 0.0f, 0.0f),
+			V4D(FLT_MIN, 0.0f, 0.0f, 0.0f), V4D(1e-40f, 0.0f, 0.0f, 0.0f), V4D(-0.0f, -0.0f, -0.0f, -0.0f), V4D(0.0f, 0.0f, 0.0f, 1.0f)
+		};
+
+		std::vector<V4D> q(count);
+		for (size_t i = 0; i < count; i++) {
+			q[i] = rng() % 4 ? V4D(component(rng), component(rng), component(rng), component(rng)) : specials[rng() % std::size(specials)];
+		}
+		return q;
+	}
+}
+
+TEST(AllTiersCanBeForced)
+{
+	const CPUFeatures::Tier detected = CPUFeatures::detect();
+	printf("  detected tier: %s\n", tierNames[static_cast<int>(detected)]);
+
+	for (const CPUFeatures::Tier tier : supportedTiers()) {
+		CHECK(CPUFeatures::force(tier) == tier);
+		CHECK(CPUFeatures::get() == tier);
+	}
+
+	// tiers above the detected one fall back to it
+	CHECK(CPUFeatures::force(CPUFeatures::Tier::AVX512) == detected);
+	CHECK(CPUFeatures::initialize() == detected);
+}
+
+TEST(QNormalizeMatchesAtEveryTier)
+{
+	std::mt19937 rng(33);
+	for (size_t count = 0; count <= 67; count++) {
+		const std::vector<V4D> input = makeQuaternions(rng, count);
+
+		const bool same = sameAtEveryTier([&]() {
+			std::vector<V4D> q = input;
+			std::vector<V4D*> pointers;
+			// every other element, so that gathers do not see consecutive memory
+			for (size_t i = 0; i < count; i += 2) pointers.push_back(&q[i]);
+			for (size_t i = 1; i < count; i += 2) pointers.push_back(&q[i]);
+			VxD::Kernels::qNormalize(pointers.data(), pointers.size());
+			return bits(q);
+		});
+		if (!CHECK(same)) printf("  count %zu\n", count);
+	}
+}
+
+TEST(QNlerpIdentityMatchesAtEveryTier)
+{
+	using BoneData = struct { V4D a, q, b; };
+
+	std::mt19937 rng(34);
+	std::uniform_real_distribution<float> weight(0.0f, 1.0f);
+	for (size_t count = 0; count <= 67; count++) {
+		const std::vector<V4D> input = makeQuaternions(rng, count);
+		std::vector<float> weights(count * 4);
+		for (size_t i = 0; i < count; i++) weights[i * 4] = i % 7 == 0 ? 0.0f : i % 7 == 1 ? 1.0f : weight(rng);
+
+		// consecutive quaternions
+		bool same = sameAtEveryTier([&]() {
+			std::vector<V4D> q = input;
+			VxD::Kernels::qNlerpIdentity(q.data(), weights.data(), count, sizeof(V4D));
+			return bits(q);
+		});
+
+		// quaternions in an array of structures, the way HkBoneData stores them, with the weights in the structures
+		same &= sameAtEveryTier([&]() {
+			std::vector<BoneData> bones(count);
+			for (size_t i = 0; i < count; i++) {
+				bones[i].q = input[i];
+				bones[i].b = V4D(weights[i * 4], 0.0f, 0.0f, 0.0f);
+			}
+			if (count) VxD::Kernels::qNlerpIdentity(&bones[0].q, reinterpret_cast<const float*>(&bones[0].b), count, sizeof(BoneData));
+
+			std::vector<V4D> q(count);
+			for (size_t i = 0; i < count; i++) q[i] = bones[i].q;
+			return bits(q);
+		});
+
+		if (!CHECK(same)) printf("  count %zu\n", count);
+	}
+}
+
+TEST(MemeqMatchesAtEveryTier)
+{
+	std::mt19937 rng(35);
+	std::vector<unsigned char> a(300), b;
+	for (auto& byte : a) byte = static_cast<unsigned char>(rng());
+
+	for (size_t size = 0; size <= 160; size++) {
+		const bool same = sameAtEveryTier([&]() {
+			std::vector<bool> results;
+			for (size_t offset = 0; offset < 4; offset++) {
+				b = a;
+				results.push_back(faststring::memeq_fast(a.data() + offset, b.data() + offset, size));
+				// a difference at every position, and just past the end
+				for (size_t i = 0; i <= size; i++) {
+					b[offset + i] ^= 0x80;
+					results.push_back(faststring::memeq_fast(a.data() + offset, b.data() + offset, size));
+					b[offset + i] ^= 0x80;
+				}
+			}
+			return results;
+		});
+		if (!CHECK(same)) printf("  size %zu\n", size);
+
+		// and the results are right, not just the same
+		b = a;
+		CHECK(faststring::memeq_fast(a.data(), b.data(), size));
+		if (size) {
+			b[size - 1]++;
+			CHECK(!faststring::memeq_fast(a.data(), b.data(), size));
+		}
+	}
+}
+
+TEST(SignatureScanMatchesAtEveryTier)
+{
+	// few distinct byte values, so that the anchors find many candidates that fail verification
+	std::mt19937 rng(36);
+	std::vector<unsigned char> memory(1 << 16);
+	for (auto& byte : memory) byte = static_cast<unsigned char>(rng() % 4);
+
+	const char* patterns[] = { "01", "02 03", "00 ? 01", "03 02 01 00 ?? 03", "01 01 01 01 01", "00 01 02 03 00 01 02 03 00 01 02 03 00 01 02 03 00 01 02 03 00 01 02 03 00 01 02 03 00 01 02 03 00" };
+	for (const char* pattern : patterns) {
+		const SignatureScanner::Signature signature(pattern);
+
+		// different alignments and lengths, so that the SIMD loops and the tail both find matches
+		for (size_t trim = 0; trim < 40; trim += 13) {
+			unsigned char* begin = memory.data() + trim;
+			unsigned char* end = memory.data() + memory.size() - trim * 3;
+
+			const bool same = sameAtEveryTier([&]() {
+				auto all = SignatureScanner::scan(signature, begin, end);
+				auto first = SignatureScanner::scan(signature, begin, end, SignatureScanner::Mode::First);
+				all.insert(all.end(), first.begin(), first.end());
+				return all;
+			});
+			if (!CHECK(same)) printf("  %s, trim %zu\n", pattern, trim);
+		}
+	}
+}
+
+TEST(SignatureSetScanMatchesAtEveryTier)
+{
+	// large enough to be split into chunks when scanning with several threads
+	std::mt19937 rng(37);
+	std::vector<unsigned char> memory(3 << 20);
+	for (auto& byte : memory) byte = static_cast<unsigned char>(rng() % 8);
+
+	std::vector<SignatureScanner::Signature> signatures;
+	for (const char* pattern : { "01", "07 06", "00 ? 01", "03 02 01 ?? 03", "05 05 05", "04 ? ? 04 01 02", "02 03 04 05 06 07 00 01" }) {
+		signatures.emplace_back(pattern);
+	}
+	// a nibble wildcard, as in instructions with a register field
+	const unsigned char bytes[] = { 0x00, 0x03, 0x01 };
+	const unsigned char ignore[] = { 0x00, 0x04, 0x00 };
+	signatures.emplace_back(bytes, ignore, sizeof(bytes));
+	const SignatureScanner::SignatureSet set(signatures);
+
+	for (size_t trim = 0; trim < 40; trim += 13) {
+		unsigned char* begin = memory.data() + trim;
+		unsigned char* end = memory.data() + memory.size() - trim * 3;
+
+		for (const unsigned int threads : { 1u, 4u }) {
+			const bool same = sameAtEveryTier([&]() { return SignatureScanner::scan(set, begin, end, threads); });
+			if (!CHECK(same)) printf("  trim %zu, %u threads\n", trim, threads);
+		}
+	}
+}
+
+TEST(RTTIFilterMatchesAtEveryTier)
+{
+	// the bounds are the sections of an imaginary image, the slots point into them, just outside of them, or nowhere
+	const uintptr_t base = 0x140000000;
+	RTTIScanner::Filter filter;
+	filter.text = { base + 0x1000, base + 0x80000 };
+	filter.rdata = { base + 0x80000, base + 0xA0000 };
+
+	const uintptr_t interesting[] = {
+		filter.text.start - 1, filter.text.start, filter.text.end - 1, filter.text.end,
+		filter.rdata.start - 1, filter.rdata.start, filter.rdata.end - 1, filter.rdata.end,
+		0, UINTPTR_MAX, uintptr_t(1) << 63, (uintptr_t(1) << 63) + filter.rdata.start
+	};
+
+	std::mt19937_64 rng(38);
+	for (size_t count = 0; count <= 67; count++) {
+		std::vector<uintptr_t> slots(count + 1);
+		for (auto& slot : slots) {
+			switch (rng() % 4) {
+			case 0: slot = interesting[rng() % std::size(interesting)]; break;
+			case 1: slot = filter.text.start + rng() % (filter.text.end - filter.text.start); break;
+			case 2: slot = filter.rdata.start + rng() % (filter.rdata.end - filter.rdata.start); break;
+			default: slot = rng(); break;
+			}
+		}
+
+		const bool same = sameAtEveryTier([&]() {
+			std::vector<uint32_t> candidates(count);
+			const size_t found = RTTIScanner::filterKernel(slots.data(), count, filter, candidates.data());
+			candidates.resize(found);
+			return candidates;
+		});
+		if (!CHECK(same)) printf("  count %zu\n", count);
+
+		// and the scalar kernel keeps the slots that point into .rdata and are followed by a pointer into .text
+		std::vector<uint32_t> expected, candidates(count);
+		for (size_t i = 0; i < count; i++) {
+			const bool inRdata = slots[i] >= filter.rdata.start && slots[i] < filter.rdata.end;
+			const bool inText = slots[i + 1] >= filter.text.start && slots[i + 1] < filter.text.end;
+			if (inRdata && inText) expected.push_back(static_cast<uint32_t>(i));
+		}
+		candidates.resize(RTTIScanner::filterScalar(slots.data(), count, filter, candidates.data()));
+		CHECK(candidates == expected);
+	}
+}
+
+int main()
+{
+	CPUFeatures::initialize();
+	return Test::run();
+}
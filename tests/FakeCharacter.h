@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string.h>
+
+#include "skeleton/HkSkeleton.h"
+
+// A fake character instance with the same layout as the game's (see the pointer chains in HkSkeleton.h and HkModifierCore.h),
+// for building HkSkeleton and the modifiers without the game.
+
+namespace Fake {
+	using BoneData = HkSkeleton::HkBone::HkBoneData;
+
+	constexpr int boneCount = 8;
+	constexpr int spEffectID = 3245;
+	constexpr float deltaTime = 1.0f / 60.0f;
+	inline const char* boneNames[boneCount] = { "Master", "Pelvis", "L_Thigh", "L_Calf", "L_Foot", "Spine", "Neck", "Head" };
+	inline int16_t boneParents[boneCount] = { -1, 0, 1, 2, 3, 1, 5, 6 };
+
+	template <typename T> void put(uint8_t* block, const size_t offset, const T value)
+	{
+		memcpy(block + offset, &value, sizeof(T));
+	}
+
+	// The parts of a character instance that HkSkeleton and the modifiers read, laid out as in the game.
+	// Every bone but the root is 0.4 along the second lane from its parent, so each chain is straight in the default pose.
+	struct Character {
+		alignas(16) uint8_t chrIns[0x200] = {};
+		alignas(16) uint8_t module[0x100] = {};
+		alignas(16) uint8_t behavior[0x20] = {};
+		alignas(16) uint8_t physics[0x80] = {};
+		alignas(16) uint8_t ride[0x10] = {};
+		alignas(16) uint8_t behaviorData[0x40] = {};
+		alignas(16) uint8_t hkbCharacter[0x40] = {};
+		alignas(16) uint8_t hkbCharacterData[0x30] = {};
+		alignas(16) uint8_t spEffects[0x10] = {};
+		alignas(16) uint8_t boneDataLayout[0x10] = {};
+		alignas(16) uint8_t pose[0x60 + sizeof(BoneData) * boneCount] = {};
+		HkSkeleton::HkaSkeleton hkaSkeleton = {};
+		char* boneNameLayout[boneCount * 2] = {};
+		BoneData defaultBoneData[boneCount];
+		HkModifier::Impl::SpEffectNode spEffect = {};
+
+		Character()
+		{
+			put(chrIns, 0x190, module);
+			put(chrIns, 0xB0, deltaTime);
+			put(chrIns, 0x178, spEffects);
+			put(module, 0x28, behavior);
+			put(module, 0x68, physics);
+			put(module, 0xE8, ride);
+			this->setTransform(V4D(10.0f, 0.0f, -5.0f), V4D(V4D(0.0f, 1.0f, 0.0f), 0.5f));
+
+			// behavior, 0x10 -> hkbCharacter block, whose 0x30 field is the pointer that both skeleton chains start from
+			put(behavior, 0x10, behaviorData);
+			put(behaviorData, 0x30, hkbCharacter);
+			put(hkbCharacter, 0x90, hkbCharacterData);
+			put(hkbCharacterData, 0x28, &hkaSkeleton);
+			put(hkbCharacter, 0x38, boneDataLayout);
+			put(boneDataLayout, 0x0, pose);
+			put(pose, 0x54, 0x60);
+
+			for (int i = 0; i < boneCount; i++) {
+				boneNameLayout[i * 2] = const_cast<char*>(boneNames[i]);
+				defaultBoneData[i] = { V4D(0.0f, i ? 0.4f : 0.0f, i == 5 ? 0.1f : 0.0f), V4D(0.0f, 0.0f, 0.0f, 1.0f), V4D(1.0f) };
+			}
+			hkaSkeleton.boneIDs = boneParents;
+			hkaSkeleton.boneCount = boneCount;
+			hkaSkeleton.boneNameLayout = boneNameLayout;
+			hkaSkeleton.defaultBoneData = defaultBoneData;
+
+			spEffect.id = spEffectID;
+			this->resetPose();
+		}
+
+		BoneData* boneData() { return reinterpret_cast<BoneData*>(pose + 0x60); }
+
+		// The game writes the animated pose every frame before the skeleton is updated.
+		void resetPose()
+		{
+			for (int i = 0; i < boneCount; i++) this->boneData()[i] = this->defaultBoneData[i];
+		}
+
+		// The character's position and orientation, in the physics module.
+		void setTransform(const V4D pos, const V4D q)
+		{
+			put(physics, 0x70, pos);
+			put(physics, 0x50, q);
+		}
+
+		void setSpEffect(const bool applied)
+		{
+			put(spEffects, 0x8, applied ? &spEffect : nullptr);
+		}
+	};
+}
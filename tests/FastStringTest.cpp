@@ -0,0 +1,251 @@
+#include <random>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "include/faststring.h"
+#include "Test.h"
+
+// Fuzzes the faststring functions against naive references, with the strings placed so that they end right before an unreadable page.
+// A load that reaches past the page a string ends in faults, the handler reports the case that was running.
+
+namespace {
+	const char* currentCase = "";
+
+	void onFault(int)
+	{
+		const char message[] = "  read past the end of a string into the guard page: ";
+		(void)!write(STDOUT_FILENO, message, sizeof(message) - 1);
+		(void)!write(STDOUT_FILENO, currentCase, strlen(currentCase));
+		(void)!write(STDOUT_FILENO, "\n", 1);
+		_exit(1);
+	}
+
+	// A readable page followed by a PROT_NONE page.
+	class GuardedPage {
+	public:
+		GuardedPage()
+		{
+			this->pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			void* mapping = mmap(nullptr, this->pageSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapping == MAP_FAILED) return;
+			this->page = static_cast<unsigned char*>(mapping);
+			mprotect(this->page + this->pageSize, this->pageSize, PROT_NONE);
+		}
+
+		~GuardedPage()
+		{
+			if (!!this->page) munmap(this->page, this->pageSize * 2);
+		}
+
+		bool valid() const { return !!this->page; }
+
+		// Copies a string and its terminator so that slack characters of garbage are left between it and the guard page.
+		template <typename T> T* place(const std::vector<T>& str, const size_t slack, std::mt19937& rng)
+		{
+			unsigned char* end = this->page + this->pageSize;
+			for (unsigned char* p = this->page; p < end; p++) *p = static_cast<unsigned char>(rng() | 1);
+
+			T* placed = reinterpret_cast<T*>(end) - slack - str.size() - 1;
+			memcpy(placed, str.data(), str.size() * sizeof(T));
+			placed[str.size()] = 0;
+			return placed;
+		}
+
+	private:
+		unsigned char* page = nullptr;
+		size_t pageSize = 0;
+	};
+
+	// Non-null characters, from a small alphabet so that random strings often share prefixes.
+	template <typename T> std::vector<T> randomString(std::mt19937& rng, const size_t length)
+	{
+		std::vector<T> str(length);
+		for (auto& c : str) c = static_cast<T>(sizeof(T) == 1 || rng() % 2 ? 'a' + rng() % 3 : 0x100 + rng() % 3);
+		return str;
+	}
+
+	template <typename T> size_t naiveLength(const T* str)
+	{
+		size_t length = 0;
+		while (str[length]) length++;
+		return length;
+	}
+
+	template <typename T> bool naiveEquals(const T* str1, const T* str2, const size_t length)
+	{
+		for (size_t i = 0; i < length; i++) {
+			if (str1[i] != str2[i]) return false;
+		}
+		return true;
+	}
+
+	std::vector<CPUFeatures::Tier> supportedTiers()
+	{
+		std::vector<CPUFeatures::Tier> tiers;
+		for (int tier = 0; tier <= static_cast<int>(CPUFeatures::detect()); tier++) tiers.push_back(static_cast<CPUFeatures::Tier>(tier));
+		return tiers;
+	}
+
+	constexpr size_t slacks[] = { 0, 1, 2, 3, 7, 8, 15, 16, 17 };
+
+	// Runtime length functions, for every length up to maxLength.
+	template <typename T> void fuzzRuntime(const char* name)
+	{
+		GuardedPage guarded;
+		if (!CHECK(guarded.valid())) return;
+		currentCase = name;
+
+		std::mt19937 rng(41);
+		constexpr size_t maxLength = 100;
+		for (const CPUFeatures::Tier tier : supportedTiers()) {
+			CPUFeatures::force(tier);
+
+			for (size_t length = 0; length <= maxLength; length++) {
+				for (const size_t slack : slacks) {
+					const std::vector<T> str = randomString<T>(rng, length);
+					const T* placed = guarded.place(str, slack, rng);
+
+					if (!CHECK(faststring::length(placed) == length && naiveLength(placed) == length)) printf("  length %zu, slack %zu\n", length, slack);
+
+					// a copy in ordinary memory, then with one difference at every position
+					std::vector<T> copy = str;
+					CHECK(faststring::equals(placed, copy.data(), length));
+					CHECK(faststring::equals(copy.data(), placed, length));
+					for (size_t i = 0; i < length; i++) {
+						copy[i] ^= 1;
+						if (!CHECK(!faststring::equals(placed, copy.data(), length))) printf("  length %zu, difference at %zu\n", length, i);
+						copy[i] ^= 1;
+					}
+
+					// prefixes of every length, and a longer string
+					for (size_t prefix = 0; prefix <= length; prefix++) {
+						CHECK(faststring::startsWith(placed, length, copy.data(), prefix));
+					}
+					const std::vector<T> longer = randomString<T>(rng, length + 1);
+					CHECK(faststring::startsWith(placed, length, longer.data(), length + 1) == false);
+					CHECK(faststring::startsWith(placed, length, longer.data(), length) == naiveEquals(placed, longer.data(), length));
+
+					// the garbage after the terminator must not affect the hash
+					CHECK(faststring::hash(placed, length) == faststring::hash(copy.data(), length));
+				}
+			}
+		}
+		CPUFeatures::initialize();
+	}
+
+	// Strings compared with a literal: the literal itself, every prefix of it, versions with a difference at every character, and longer strings.
+	template <typename T, size_t N> void fuzzLiteral(GuardedPage& guarded, std::mt19937& rng, const T(&literal)[N])
+	{
+		std::vector<std::vector<T>> strings;
+		for (size_t length = 0; length < N - 1; length++) strings.emplace_back(literal, literal + length);
+		strings.emplace_back(literal, literal + N - 1);
+		for (size_t i = 0; i < N - 1; i++) {
+			strings.emplace_back(literal, literal + N - 1);
+			strings.back()[i] = static_cast<T>(strings.back()[i] == 'z' ? 'y' : 'z');
+		}
+		for (size_t extra = 1; extra <= 3; extra++) {
+			strings.emplace_back(literal, literal + N - 1);
+			strings.back().insert(strings.back().end(), extra, static_cast<T>('x'));
+		}
+
+		for (const std::vector<T>& str : strings) {
+			for (const size_t slack : slacks) {
+				const T* placed = guarded.place(str, slack, rng);
+
+				const bool equal = str.size() == N - 1 && naiveEquals(str.data(), literal, N - 1);
+				const bool prefixed = str.size() >= N - 1 && naiveEquals(str.data(), literal, N - 1);
+				if (!CHECK(faststring::equals(placed, literal) == equal)) printf("  literal of %zu characters, string of %zu, slack %zu\n", N - 1, str.size(), slack);
+				// startsWith is only defined for strings at least as long as the literal, but must not read past a shorter one either
+				const bool startsWith = faststring::startsWith(placed, literal);
+				if (str.size() >= N - 1 && !CHECK(startsWith == prefixed)) printf("  prefix of %zu characters, string of %zu, slack %zu\n", N - 1, str.size(), slack);
+			}
+		}
+	}
+
+	// Literals around the sizes where strcmp_fast changes strategy: 1, 8 and 16 bytes, and the 16 byte halves of longer ones.
+	template <typename T> void fuzzLiterals(const char* name)
+	{
+		GuardedPage guarded;
+		if (!CHECK(guarded.valid())) return;
+		currentCase = name;
+		std::mt19937 rng(42);
+
+		if constexpr (sizeof(T) == 1) {
+			fuzzLiteral(guarded, rng, "");
+			fuzzLiteral(guarded, rng, "a");
+			fuzzLiteral(guarded, rng, "abcdef");
+			fuzzLiteral(guarded, rng, "abcdefg");
+			fuzzLiteral(guarded, rng, "abcdefgh");
+			fuzzLiteral(guarded, rng, "abcdefghijklmn");
+			fuzzLiteral(guarded, rng, "abcdefghijklmno");
+			fuzzLiteral(guarded, rng, "abcdefghijklmnop");
+			fuzzLiteral(guarded, rng, "abcdefghijklmnopqrstuvwxyzabcde");
+			fuzzLiteral(guarded, rng, "abcdefghijklmnopqrstuvwxyzabcdef");
+			fuzzLiteral(guarded, rng, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+		}
+		else {
+			fuzzLiteral(guarded, rng, u"");
+			fuzzLiteral(guarded, rng, u"a");
+			fuzzLiteral(guarded, rng, u"abc");
+			fuzzLiteral(guarded, rng, u"abcd");
+			fuzzLiteral(guarded, rng, u"abcdefg");
+			fuzzLiteral(guarded, rng, u"abcdefgh");
+			fuzzLiteral(guarded, rng, u"abcdefghijklmno");
+			fuzzLiteral(guarded, rng, u"abcdefghijklmnop");
+			fuzzLiteral(guarded, rng, u"c0000_a00_lo");
+			fuzzLiteral(guarded, rng, u"abcdefghijklmnopqrstuvwxyz");
+		}
+	}
+}
+
+TEST(NarrowRuntimeFunctions)
+{
+	fuzzRuntime<char>("narrow runtime functions");
+}
+
+TEST(WideRuntimeFunctions)
+{
+	fuzzRuntime<char16_t>("UTF-16 runtime functions");
+}
+
+TEST(NarrowLiteralFunctions)
+{
+	fuzzLiterals<char>("narrow literal functions");
+}
+
+TEST(WideLiteralFunctions)
+{
+	fuzzLiterals<char16_t>("UTF-16 literal functions");
+}
+
+// Strings of the same bytes hash the same, whatever their character type, and strings that differ hash differently.
+TEST(HashIsConsistent)
+{
+	const char narrow[] = "c0000_a00_lo";
+	const char16_t wide[] = u"c0000";
+	CHECK(faststring::hash(wide, 5) == faststring::hash(reinterpret_cast<const char*>(wide), 10));
+	CHECK(faststring::hash(wide, 5) == faststring::hashBytes(wide, 10));
+	CHECK(faststring::hash(narrow, 5) != faststring::hash(narrow, 6));
+	CHECK(faststring::Hash()(std::string_view("Head")) == faststring::hash("Head", 4));
+
+	std::mt19937 rng(43);
+	std::vector<uint64_t> hashes;
+	for (size_t length = 0; length < 64; length++) {
+		const std::vector<char> str = randomString<char>(rng, length);
+		hashes.push_back(faststring::hash(str.data(), length));
+	}
+	std::sort(hashes.begin(), hashes.end());
+	CHECK(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+}
+
+int main()
+{
+	CPUFeatures::initialize();
+	signal(SIGSEGV, onFault);
+	signal(SIGBUS, onFault);
+	return Test::run();
+}
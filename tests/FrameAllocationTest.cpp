@@ -0,0 +1,141 @@
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FakeCharacter.h"
+#include "Test.h"
+
+// HkSkeleton::updateAll runs for every character every frame, it must not allocate once its scratch storage has grown.
+// The global allocation functions are replaced with counting ones, and a skeleton is built on a fake character instance.
+
+namespace {
+	size_t allocations = 0;
+}
+
+void* operator new(size_t size)
+{
+	allocations++;
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	allocations++;
+	const size_t align = static_cast<size_t>(alignment);
+	if (void* p = aligned_alloc(align, (size + align - 1) / align * align)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { free(p); }
+
+namespace {
+	using Fake::boneCount;
+	using Fake::spEffectID;
+	using FakeCharacter = Fake::Character;
+
+	void addModifiers(HkSkeleton& skeleton, const V4D* lookAtTarget)
+	{
+		auto addTo = [&](HkObj* object, HkModifier::Modifier&& modifier) { return object->addModifier(&modifier); };
+		auto bone = [&](const char* name) { return skeleton.getBone(name); };
+
+		addTo(&skeleton, HkModifier::ScaleSize(V4D(1.1f)));
+		addTo(&skeleton, HkModifier::Blend(HkModifier::ScaleLength(1.2f), 0.5f));
+		addTo(bone("Pelvis"), HkModifier::Offset(V4D(0.0f, 0.1f, 0.0f)));
+		addTo(bone("Spine"), HkModifier::Rotate(V4D(0.1f, 0.0f, 0.0f, 1.0f)));
+		addTo(bone("Neck"), HkModifier::SpEffect::Blend(HkModifier::Rotate(V4D(0.0f, 0.3f, 0.0f, 1.0f)), spEffectID, 0.25f));
+		addTo(bone("Head"), HkModifier::ScaleLength(1.3f));
+		addTo(bone("L_Foot"), HkModifier::IK::TwoBone(V4D(0.2f, 0.3f, 0.4f)));
+		addTo(bone("Head"), HkModifier::IK::LookAt(lookAtTarget));
+		addTo(bone("L_Calf"), HkModifier::IK::FABRIK(V4D(0.0f, 0.6f, 0.5f), 2));
+	}
+}
+
+TEST(FakeCharacterIsMapped)
+{
+	FakeCharacter character;
+	HkSkeleton skeleton(character.chrIns);
+
+	CHECK(skeleton.getBoneCount() == boneCount);
+	CHECK(skeleton.getBoneData() == character.boneData());
+	CHECK(skeleton.getBone("Head") == skeleton.getBone(7));
+	CHECK(skeleton.getBone("Head")->getParent() == skeleton.getBone("Neck"));
+	CHECK(skeleton.getModules().ride == character.ride);
+}
+
+TEST(UpdateAllDoesNotAllocate)
+{
+	FakeCharacter character;
+	HkSkeleton skeleton(character.chrIns);
+	V4D lookAtTarget(12.0f, 2.0f, -4.0f);
+	addModifiers(skeleton, &lookAtTarget);
+	skeleton.setPoseExport(true);
+
+	std::vector<m128Matrix> matrices(boneCount);
+
+	auto frame = [&](const int i) {
+		character.resetPose();
+		character.setSpEffect(i % 40 < 20);
+		lookAtTarget = V4D(12.0f, 2.0f + 0.01f * (i % 50), -4.0f);
+		skeleton.updateAll();
+		skeleton.getPose()->toMatrices(matrices.data());
+	};
+
+	// the first frames grow the scratch storage
+	for (int i = 0; i < 4; i++) frame(i);
+
+	const size_t before = allocations;
+	for (int i = 4; i < 1000; i++) frame(i);
+	const size_t frameAllocations = allocations - before;
+
+	CHECK(frameAllocations == 0);
+	if (frameAllocations) printf("  %zu allocations in 996 frames\n", frameAllocations);
+
+	const HkSkeleton::HkPose* pose = skeleton.getPose();
+	if (!CHECK(!!pose)) return;
+	CHECK(pose->frame == 1000);
+	for (int16_t i = 0; i < boneCount; i++) {
+		CHECK(pose->getPos(i).isfinite() && pose->getQ(i).isfinite());
+	}
+}
+
+// The module blocks can be replaced while the character is loaded, which resolves the character transform again.
+TEST(ModuleChangeDoesNotAllocate)
+{
+	FakeCharacter character;
+	HkSkeleton skeleton(character.chrIns);
+	V4D lookAtTarget(0.0f, 1.0f, 1.0f);
+	addModifiers(skeleton, &lookAtTarget);
+
+	using Fake::put;
+	alignas(16) uint8_t otherPhysics[0x80] = {};
+	put(otherPhysics, 0x70, V4D(0.0f));
+	put(otherPhysics, 0x50, V4D(0.0f, 0.0f, 0.0f, 1.0f));
+
+	for (int i = 0; i < 4; i++) skeleton.updateAll();
+
+	const size_t before = allocations;
+	for (int i = 0; i < 100; i++) {
+		character.resetPose();
+		put(character.module, 0x68, i & 1 ? otherPhysics : character.physics);
+		skeleton.updateAll();
+	}
+	CHECK(allocations == before);
+	// the last frame used the other physics module
+	CHECK(skeleton.getModules().physics == otherPhysics);
+	CHECK(&skeleton.getChrPos() == reinterpret_cast<V4D*>(otherPhysics + 0x70));
+}
+
+int main()
+{
+	return Test::run();
+}
@@ -0,0 +1,121 @@
+#include <math.h>
+#include <random>
+
+#include "FakeCharacter.h"
+#include "Test.h"
+
+// HkSkeleton::updatePose computes every bone's world transform in one pass over the hierarchy. It is checked against
+// the recursive composition of HkBone::getWorldQ<false> and a recursive position, on a fake character with random local transforms.
+
+namespace {
+	using Fake::boneCount;
+
+	// The world position as updatePose composes it: a child's offset is rotated by its parent's world orientation.
+	V4D recursiveWorldPos(HkSkeleton::HkBone* bone)
+	{
+		HkSkeleton::HkBone* parent = bone->getParent();
+		if (!parent) return bone->getSkeleton()->getChrPos();
+		return recursiveWorldPos(parent) + bone->getBoneData().xzyVec.qTransform(parent->getWorldQ<false>());
+	}
+
+	V4D recursiveWorldScale(HkSkeleton::HkBone* bone)
+	{
+		HkSkeleton::HkBone* parent = bone->getParent();
+		if (!parent) return bone->getBoneData().xzyScale;
+		return _mm_mul_ps(recursiveWorldScale(parent), bone->getBoneData().xzyScale);
+	}
+
+	bool near3(const V4D a, const V4D b, const float tolerance)
+	{
+		return (a - b).flatten<V4D::CoordinateAxis::W>().length() <= tolerance;
+	}
+
+	// q and -q are the same rotation
+	bool nearQ(const V4D a, const V4D b, const float tolerance)
+	{
+		return (a - b).length() <= tolerance || (a + b).length() <= tolerance;
+	}
+
+	V4D randomQ(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+		return V4D(component(rng), component(rng), component(rng), component(rng)).normalize();
+	}
+
+	void randomizePose(Fake::Character& character, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> offset(-0.5f, 0.5f), scale(0.5f, 1.5f);
+		for (int i = 0; i < boneCount; i++) {
+			Fake::BoneData& data = character.boneData()[i];
+			data.xzyVec = V4D(offset(rng), offset(rng), offset(rng));
+			data.qSpatial = randomQ(rng);
+			data.xzyScale = V4D(scale(rng), scale(rng), scale(rng));
+		}
+	}
+}
+
+TEST(PoseMatchesRecursiveComposition)
+{
+	Fake::Character character;
+	HkSkeleton skeleton(character.chrIns);
+	skeleton.setPoseExport(true);
+
+	std::mt19937 rng(27);
+	for (int trial = 0; trial < 50; trial++) {
+		randomizePose(character, rng);
+		character.setTransform(V4D(10.0f, 1.0f, -5.0f) * (trial * 0.1f), randomQ(rng));
+		skeleton.updateAll();
+
+		const HkSkeleton::HkPose* pose = skeleton.getPose();
+		if (!CHECK(!!pose)) return;
+		for (int16_t i = 0; i < boneCount; i++) {
+			HkSkeleton::HkBone* bone = skeleton.getBone(i);
+			const bool matches = CHECK(nearQ(pose->getQ(i), bone->getWorldQ<false>(), 1e-5f))
+				&& CHECK(near3(pose->getPos(i), recursiveWorldPos(bone), 1e-4f))
+				&& CHECK(near3(pose->getScale(i), recursiveWorldScale(bone), 1e-5f));
+			if (!matches) {
+				printf("  trial %d, bone %s\n", trial, bone->getName().c_str());
+				return;
+			}
+		}
+	}
+}
+
+// A bone's subtree is recomputed from the bone's new local transform, the rest of the pose is left as it was.
+TEST(SubtreeUpdate)
+{
+	Fake::Character character;
+	HkSkeleton skeleton(character.chrIns);
+	skeleton.setPoseExport(true);
+
+	std::mt19937 rng(28);
+	randomizePose(character, rng);
+	skeleton.updateAll();
+	const HkSkeleton::HkPose before = *skeleton.getPose();
+
+	HkSkeleton::HkBone* spine = skeleton.getBone("Spine");
+	spine->getBoneData().qSpatial = randomQ(rng);
+	skeleton.updatePose(spine);
+
+	HkSkeleton::HkPose& pose = skeleton.getWorkingPose();
+	for (int16_t i = 0; i < boneCount; i++) {
+		HkSkeleton::HkBone* bone = skeleton.getBone(i);
+		bool inSubtree = false;
+		for (HkSkeleton::HkBone* b = bone; !!b; b = b->getParent()) inSubtree |= b == spine;
+
+		if (inSubtree) {
+			CHECK(nearQ(pose.getQ(i), bone->getWorldQ<false>(), 1e-5f));
+			CHECK(near3(pose.getPos(i), recursiveWorldPos(bone), 1e-4f));
+		}
+		else {
+			CHECK(pose.qW[i] == before.qW[i] && pose.posX[i] == before.posX[i]);
+		}
+	}
+	// the spine's orientation changed, the neck moved with it
+	CHECK(!near3(pose.getPos(6), before.getPos(6), 1e-4f));
+}
+
+int main()
+{
+	return Test::run();
+}
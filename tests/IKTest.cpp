@@ -0,0 +1,120 @@
+#include <random>
+
+#include "FakeCharacter.h"
+#include "Test.h"
+
+// The IK modifiers must bring the end of a chain to a reachable target. They are applied to the leg and the spine of
+// a fake character, from the straight default pose and from randomly bent poses, and the solved pose is checked.
+
+namespace {
+	using Fake::boneCount;
+
+	// The leg, L_Thigh -> L_Calf -> L_Foot, is two bones of 0.4 starting 0.8 above the character's position.
+	// The spine chain, Pelvis -> Spine -> Neck -> Head, is about 1.2 long and starts 0.4 above it.
+	const V4D thigh(0.0f, 0.8f, 0.0f);
+	const V4D pelvis(0.0f, 0.4f, 0.0f);
+
+	// A random point within a ball around a chain's root, in character space.
+	V4D randomTarget(std::mt19937& rng, const V4D root, const float minDistance, const float maxDistance)
+	{
+		std::uniform_real_distribution<float> component(-1.0f, 1.0f), distance(minDistance, maxDistance);
+		V4D direction;
+		do direction = V4D(component(rng), component(rng), component(rng)); while (direction.length() < 0.1f);
+		return root + direction.normalize() * distance(rng);
+	}
+
+	// Bends the chain's root and its descendants by small random rotations, so that the chain does not start straight.
+	// The root itself stays in place.
+	void bendPose(Fake::Character& character, const int16_t root, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> component(-0.3f, 0.3f);
+		for (int16_t i = 0; i < boneCount; i++) {
+			int16_t ancestor = i;
+			while (ancestor != -1 && ancestor != root) ancestor = Fake::boneParents[ancestor];
+			if (ancestor == root) character.boneData()[i].qSpatial = V4D(component(rng), component(rng), component(rng), 1.0f).normalize();
+		}
+	}
+
+	// Solves a chain for a series of targets and returns the largest distance between the end bone and its target.
+	template <typename Modifier> float solve(const char* endBone, const int16_t rootIndex, const V4D root, const float minDistance, const float maxDistance, const bool bent, const int seed)
+	{
+		Fake::Character character;
+		const V4D chrPos(3.0f, 0.5f, -2.0f);
+		const V4D chrQ = V4D(0.2f, 0.9f, -0.1f, 0.4f).normalize();
+		character.setTransform(chrPos, chrQ);
+
+		std::mt19937 rng(seed);
+		float maxError = 0.0f;
+		for (int trial = 0; trial < 50; trial++) {
+			const V4D target = randomTarget(rng, root, minDistance, maxDistance);
+			character.resetPose();
+			if (bent) bendPose(character, rootIndex, rng);
+
+			HkSkeleton skeleton(character.chrIns);
+			skeleton.setPoseExport(true);
+			HkSkeleton::HkBone* bone = skeleton.getBone(endBone);
+			auto modifier = Modifier::make(target);
+			bone->addModifier(&modifier);
+			skeleton.updateAll();
+
+			const V4D worldTarget = chrPos + target.qTransform(chrQ);
+			const float error = (skeleton.getPose()->getPos(bone->getIndex()) - worldTarget).flatten<V4D::CoordinateAxis::W>().length();
+			maxError = (std::max)(maxError, error);
+		}
+		return maxError;
+	}
+
+	struct TwoBone {
+		static HkModifier::IK::TwoBone make(const V4D target) { return HkModifier::IK::TwoBone(target); }
+	};
+
+	struct FABRIK {
+		static HkModifier::IK::FABRIK make(const V4D target) { return HkModifier::IK::FABRIK(target, 3, 32, 0.0005f); }
+	};
+}
+
+TEST(TwoBoneReachesTarget)
+{
+	// between almost folded and almost straight, the solver keeps 1e-4 away from both
+	for (const bool bent : { false, true }) {
+		const float error = solve<TwoBone>("L_Foot", 2, thigh, 0.1f, 0.75f, bent, bent ? 1 : 0);
+		if (!CHECK(error < 1e-3f)) printf("  %s leg, %f from the target\n", bent ? "bent" : "straight", error);
+	}
+}
+
+TEST(FABRIKReachesTarget)
+{
+	for (const bool bent : { false, true }) {
+		const float error = solve<FABRIK>("Head", 1, pelvis, 0.3f, 1.1f, bent, bent ? 3 : 2);
+		if (!CHECK(error < 2e-3f)) printf("  %s spine, %f from the target\n", bent ? "bent" : "straight", error);
+	}
+}
+
+// A target out of reach stretches the chain straight towards it.
+TEST(UnreachableTargetStretchesChain)
+{
+	const V4D target(2.0f, 0.8f, 1.0f);
+
+	// each chain on its own character, FABRIK rotates the pelvis, which would move the leg
+	auto solveOnce = [&](const char* endBone, HkModifier::Modifier&& modifier) {
+		Fake::Character character;
+		character.setTransform(V4D(0.0f), V4D(0.0f, 0.0f, 0.0f, 1.0f));
+		HkSkeleton skeleton(character.chrIns);
+		skeleton.setPoseExport(true);
+		HkSkeleton::HkBone* bone = skeleton.getBone(endBone);
+		bone->addModifier(&modifier);
+		skeleton.updateAll();
+		return skeleton.getPose()->getPos(bone->getIndex());
+	};
+
+	const V4D foot = solveOnce("L_Foot", HkModifier::IK::TwoBone(target));
+	const V4D head = solveOnce("Head", HkModifier::IK::FABRIK(target, 3));
+	CHECK((foot - thigh).normalize().dot3((target - thigh).normalize()) > 0.9999f);
+	CHECK((foot - thigh).length() > 0.799f);
+	CHECK((head - pelvis).normalize().dot3((target - pelvis).normalize()) > 0.9999f);
+}
+
+int main()
+{
+	return Test::run();
+}
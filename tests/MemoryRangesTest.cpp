@@ -0,0 +1,260 @@
+#include <random>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "include/PointerChain.h"
+#include "include/MemoryRanges.h"
+#include "Test.h"
+
+// The readable range table against a linear reference, its miss cache and invalidation, and range safe pointer chains
+// on pages whose protection the test changes. A PROT_NONE page is mapped but not readable, so it stays unreadable
+// without another mapping taking its place.
+
+namespace {
+	using MemoryRanges::Range;
+
+	// Ranges from a vector. Only the first listed ranges are enumerated, all of them can be queried.
+	class FakeSource : public MemoryRanges::Source {
+	public:
+		FakeSource(std::vector<Range> ranges, const size_t listed) : ranges(std::move(ranges)), listed(listed) {}
+
+		virtual bool enumerate(std::vector<Range>& ranges)
+		{
+			ranges.insert(ranges.end(), this->ranges.begin(), this->ranges.begin() + this->listed);
+			return true;
+		}
+
+		virtual bool query(const uintptr_t address, Range& range)
+		{
+			this->queries++;
+			for (const Range& r : this->ranges) {
+				if (r.begin <= address && address < r.end) {
+					range = r;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		int queries = 0;
+
+	private:
+		std::vector<Range> ranges;
+		size_t listed;
+	};
+
+	constexpr uintptr_t domain = 1 << 17;
+
+	// Random ranges that overlap, touch and repeat each other, and the bytes they cover.
+	std::vector<Range> makeRanges(std::mt19937& rng, std::vector<bool>& covered)
+	{
+		std::uniform_int_distribution<uintptr_t> begin(0, domain - 1024), length(0, 600);
+		std::vector<Range> ranges;
+		for (int i = 0; i < 300; i++) {
+			const uintptr_t b = begin(rng);
+			ranges.push_back({ b, b + length(rng) });
+			if (i % 10 == 0) ranges.push_back({ ranges.back().end, ranges.back().end + length(rng) });
+			if (i % 25 == 0) ranges.push_back(ranges.back());
+		}
+
+		covered.assign(domain, false);
+		for (const Range& r : ranges) {
+			for (uintptr_t a = r.begin; a < r.end; a++) covered[a] = true;
+		}
+		return ranges;
+	}
+
+	bool coveredAll(const std::vector<bool>& covered, const uintptr_t address, const size_t size)
+	{
+		for (uintptr_t a = address; a < address + size; a++) {
+			if (a >= domain || !covered[a]) return false;
+		}
+		return true;
+	}
+
+	size_t pageSize()
+	{
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	}
+
+	struct Node {
+		uint64_t value;
+		void* next;
+	};
+}
+
+TEST(LookupMatchesLinearSearch)
+{
+	std::mt19937 rng(39);
+	for (int trial = 0; trial < 4; trial++) {
+		std::vector<bool> covered;
+		const std::vector<Range> ranges = makeRanges(rng, covered);
+		MemoryRanges::Table table(std::make_unique<FakeSource>(ranges, ranges.size()));
+		CHECK(table.refresh());
+
+		// every address in order, then at random so that the last hit is mostly of no use
+		int mismatches = 0;
+		std::uniform_int_distribution<uintptr_t> address(0, domain - 1);
+		for (const size_t size : { 1, 8, 64 }) {
+			for (uintptr_t a = 0; a < domain; a++) mismatches += table.contains(a, size) != coveredAll(covered, a, size);
+			for (int i = 0; i < 100000; i++) {
+				const uintptr_t a = address(rng);
+				mismatches += table.contains(a, size) != coveredAll(covered, a, size);
+			}
+		}
+		if (!CHECK(mismatches == 0)) printf("  trial %d: %d mismatches\n", trial, mismatches);
+		CHECK(!table.contains(domain + 4096));
+	}
+
+	// an empty table contains nothing
+	MemoryRanges::Table empty(std::make_unique<FakeSource>(std::vector<Range>{}, 0));
+	CHECK(empty.refresh() && empty.size() == 0 && !empty.contains(0) && !empty.contains(12345));
+}
+
+// Ranges that were not enumerated are added one at a time by Table::update, through the pending list and its folds.
+TEST(UpdatedLookupMatchesLinearSearch)
+{
+	std::mt19937 rng(390);
+	std::vector<bool> covered;
+	const std::vector<Range> ranges = makeRanges(rng, covered);
+	MemoryRanges::Table table(std::make_unique<FakeSource>(ranges, ranges.size() / 4));
+	CHECK(table.refresh());
+
+	int updates = 0;
+	for (uintptr_t a = 0; a < domain; a++) {
+		if (!table.contains(a) && table.update(a)) updates++;
+	}
+	CHECK(updates > 16);
+
+	int mismatches = 0;
+	for (uintptr_t a = 0; a < domain; a++) mismatches += table.contains(a) != covered[a];
+	if (!CHECK(mismatches == 0)) printf("  %d mismatches after %d updates\n", mismatches, updates);
+
+	// a refresh drops the updated ranges that the source does not enumerate
+	CHECK(table.refresh());
+	std::vector<bool> listed(domain, false);
+	for (size_t i = 0; i < ranges.size() / 4; i++) {
+		for (uintptr_t a = ranges[i].begin; a < ranges[i].end; a++) listed[a] = true;
+	}
+	mismatches = 0;
+	for (uintptr_t a = 0; a < domain; a++) mismatches += table.contains(a) != listed[a];
+	CHECK(mismatches == 0);
+}
+
+TEST(MissCache)
+{
+	auto source = std::make_unique<FakeSource>(std::vector<Range>{ { 0x10000, 0x20000 }, { 0x40000, 0x50000 } }, 1);
+	FakeSource& fake = *source;
+	MemoryRanges::Table table(std::move(source));
+	CHECK(table.refresh());
+
+	const uintptr_t miss = 0x30010;
+	CHECK(!table.isKnownMiss(miss));
+	CHECK(!table.update(miss) && fake.queries == 1);
+	table.addMiss(miss);
+	CHECK(table.isKnownMiss(miss) && table.isKnownMiss(miss + 0x100));
+	CHECK(!table.isKnownMiss(miss + 0x1000));
+
+	// a change of the table forgets the misses, the new range may contain them
+	CHECK(table.update(0x40000));
+	CHECK(!table.isKnownMiss(miss));
+
+	table.addMiss(miss);
+	table.invalidate();
+	CHECK(table.isStale() && !table.isKnownMiss(miss));
+	CHECK(table.refresh() && !table.isStale());
+
+	// and so does time
+	table.addMiss(miss);
+	CHECK(table.isKnownMiss(miss));
+	std::this_thread::sleep_for(std::chrono::milliseconds(110));
+	CHECK(!table.isKnownMiss(miss));
+}
+
+// A range safe chain returns nullptr instead of reading through a pointer to an unreadable page.
+TEST(RangeSafetyRejectsUnreadableHop)
+{
+	const size_t size = pageSize();
+	void* mapping = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (!CHECK(mapping != MAP_FAILED)) return;
+
+	uint64_t value = 39;
+	Node last = { 0, &value };
+	Node node = { 0, &last };
+	auto chain = [&node]() { return PointerChain::make<uint64_t, PointerChain::Safety::Range>(reinterpret_cast<uint8_t*>(&node), 0x8u, 0x8u, 0x0u).get(); };
+	CHECK(chain() == &value && *chain() == 39);
+
+	// the last hop, and the one before it
+	last.next = mapping;
+	CHECK(chain() == nullptr);
+	node.next = static_cast<uint8_t*>(mapping) + 0x10;
+	CHECK(chain() == nullptr);
+
+	// a garbage pointer into no mapping at all
+	node.next = reinterpret_cast<void*>(0x10);
+	CHECK(chain() == nullptr);
+
+	node.next = &last;
+	last.next = &value;
+	CHECK(chain() == &value);
+	munmap(mapping, size);
+}
+
+// A page found unreadable stays so until the table is invalidated, then the new protection is picked up.
+TEST(InvalidateRefreshesGlobalTable)
+{
+	const size_t size = pageSize();
+	void* mapping = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (!CHECK(mapping != MAP_FAILED)) return;
+
+	CHECK(!MemoryRanges::isReadable(mapping));
+	mprotect(mapping, size, PROT_READ);
+	CHECK(!MemoryRanges::isReadable(mapping));
+	MemoryRanges::invalidate();
+	CHECK(MemoryRanges::isReadable(mapping, size));
+
+	// and the other way around, freed memory is not trusted once invalidated
+	mprotect(mapping, size, PROT_NONE);
+	CHECK(MemoryRanges::isReadable(mapping));
+	MemoryRanges::invalidate();
+	CHECK(!MemoryRanges::isReadable(mapping));
+	munmap(mapping, size);
+}
+
+// Every thread has its own table, MemoryRanges::invalidate on one thread reaches the tables of all of them.
+TEST(InvalidateReachesOtherThreads)
+{
+	const size_t size = pageSize();
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (!CHECK(mapping != MAP_FAILED)) return;
+	// the page may be where the last test cached a miss
+	MemoryRanges::invalidate();
+
+	std::atomic<int> step(0);
+	bool before = false, after = true;
+	std::thread other([&]() {
+		before = MemoryRanges::isReadable(mapping);
+		step = 1;
+		while (step != 2) std::this_thread::yield();
+		after = MemoryRanges::isReadable(mapping);
+	});
+
+	while (step != 1) std::this_thread::yield();
+	CHECK(MemoryRanges::isReadable(mapping));
+	mprotect(mapping, size, PROT_NONE);
+	MemoryRanges::invalidate();
+	step = 2;
+	other.join();
+
+	CHECK(before && !after);
+	CHECK(!MemoryRanges::isReadable(mapping));
+	munmap(mapping, size);
+}
+
+int main()
+{
+	return Test::run();
+}
@@ -0,0 +1,102 @@
+#include <new>
+#include <vector>
+
+#include "include/PEImage.h"
+#include "SyntheticPE.h"
+#include "Test.h"
+
+// PEImage against the layout the loader would produce for a synthetic image (see SyntheticPE.h): the headers and every section
+// at its virtual address, zero where the file stores nothing, and every absolute pointer relocated to the new base.
+
+namespace {
+	// The image as the loader would place it at base, built from the file and the builder's own description of it.
+	std::vector<unsigned char> expectedImage(const SyntheticPE::Image& image, const unsigned char* base)
+	{
+		std::vector<unsigned char> expected(image.sizeOfImage, 0);
+		std::copy(image.file.begin(), image.file.begin() + SyntheticPE::sizeOfHeaders, expected.begin());
+		for (const SyntheticPE::Section& section : image.sections) {
+			const size_t size = (std::min)(section.virtualSize, section.rawSize);
+			std::copy(image.file.begin() + section.rawOffset, image.file.begin() + section.rawOffset + size, expected.begin() + section.virtualAddress);
+		}
+		for (const auto& [rva, value] : image.pointers) {
+			const uint64_t relocated = reinterpret_cast<uintptr_t>(base) + (value - SyntheticPE::imageBase);
+			memcpy(expected.data() + rva, &relocated, sizeof(relocated));
+		}
+		return expected;
+	}
+
+	size_t firstMismatch(const std::vector<unsigned char>& expected, const unsigned char* loaded)
+	{
+		for (size_t i = 0; i < expected.size(); i++) {
+			if (expected[i] != loaded[i]) return i;
+		}
+		return expected.size();
+	}
+}
+
+TEST(SectionsArePlacedAndRelocated)
+{
+	SyntheticPE::Options options;
+	options.rdataSections = 3;
+	const SyntheticPE::Image image = SyntheticPE::build(options);
+	const SyntheticPE::TempFile file(image.file);
+	const PEImage loaded(file.getPath());
+	const unsigned char* base = loaded.getBase();
+
+	if (!CHECK(loaded.getSize() == image.sizeOfImage)) return;
+	CHECK(reinterpret_cast<uintptr_t>(base) % SyntheticPE::sectionAlignment == 0);
+
+	const std::vector<unsigned char> expected = expectedImage(image, base);
+	const size_t mismatch = firstMismatch(expected, base);
+	if (!CHECK(mismatch == expected.size())) printf("  RVA %#zx: %#x, expected %#x\n", mismatch, base[mismatch], expected[mismatch]);
+
+	// the file pads .text beyond its virtual size, which must not be loaded, and .data is longer in memory than in the file
+	const SyntheticPE::Section& text = image.sections[0];
+	CHECK(image.file[text.rawOffset + text.virtualSize] == 0xAB);
+	CHECK(std::all_of(base + text.virtualAddress + text.virtualSize, base + image.sections[1].virtualAddress, [](unsigned char b) { return b == 0; }));
+
+	const SyntheticPE::Section& data = image.sections[options.rdataSections + 1];
+	CHECK(data.name == ".data" && data.virtualSize > data.rawSize);
+	CHECK(std::all_of(base + data.virtualAddress + data.rawSize, base + data.virtualAddress + data.virtualSize, [](unsigned char b) { return b == 0; }));
+
+	// every pointer points into the loaded image
+	size_t relocated = 0;
+	for (const auto& [rva, value] : image.pointers) {
+		uint64_t pointer = 0;
+		memcpy(&pointer, base + rva, sizeof(pointer));
+		relocated += pointer == reinterpret_cast<uintptr_t>(base) + (value - SyntheticPE::imageBase);
+	}
+	CHECK(!image.pointers.empty() && relocated == image.pointers.size());
+}
+
+// A SizeOfImage that is not a multiple of the section alignment still gets a whole number of pages, all of them cleared.
+// Freed allocations of the same size are dirtied first, so that the image is likely to reuse one.
+TEST(UnalignedSizeOfImageIsCleared)
+{
+	SyntheticPE::Options options;
+	options.alignSizeOfImage = false;
+	const SyntheticPE::Image image = SyntheticPE::build(options);
+	const SyntheticPE::TempFile file(image.file);
+
+	const size_t allocationSize = (image.sizeOfImage + SyntheticPE::sectionAlignment - 1) & ~(SyntheticPE::sectionAlignment - 1);
+	if (!CHECK(allocationSize > image.sizeOfImage)) return;
+
+	for (int i = 0; i < 8; i++) {
+		void* dirty = ::operator new(allocationSize, std::align_val_t(SyntheticPE::sectionAlignment));
+		memset(dirty, 0xEE, allocationSize);
+		::operator delete(dirty, std::align_val_t(SyntheticPE::sectionAlignment));
+
+		const PEImage loaded(file.getPath());
+		const unsigned char* base = loaded.getBase();
+		CHECK(loaded.getSize() == image.sizeOfImage);
+		if (!CHECK(std::all_of(base + image.sizeOfImage, base + allocationSize, [](unsigned char b) { return b == 0; }))) return;
+
+		const std::vector<unsigned char> expected = expectedImage(image, base);
+		if (!CHECK(firstMismatch(expected, base) == expected.size())) return;
+	}
+}
+
+int main()
+{
+	return Test::run();
+}
@@ -0,0 +1,104 @@
+#include <random>
+#include <memory>
+#include <vector>
+
+#include "FakeCharacter.h"
+#include "Test.h"
+
+// PointerChain::resolveBatch must resolve every base to the same pointer as the chain resolved on its own,
+// on fake characters some of which have a nullptr where a chain checks for one.
+
+namespace {
+	using Module = PointerChain::Chain<uint8_t, 0x190, 0x0>;
+	using Position = PointerChain::Chain<V4D, 0x190u, 0x68u, 0x70u>;
+	// only the physics module is checked, the module block is always there
+	using Orientation = PointerChain::Chain<V4D, 0x190, 0x68, 0x50u>;
+	using Behavior = PointerChain::Chain<uint8_t, 0x190u, 0x28u, 0x10u, 0x30u>;
+
+	struct Characters {
+		std::vector<std::unique_ptr<Fake::Character>> owned;
+		std::vector<uint8_t*> chrInses;
+
+		// Every third character has no physics module, every fifth no module block at all, every seventh no behavior data.
+		Characters(const size_t count, const bool withNulls)
+		{
+			for (size_t i = 0; i < count; i++) {
+				this->owned.push_back(std::make_unique<Fake::Character>());
+				Fake::Character& character = *this->owned.back();
+				character.setTransform(V4D(static_cast<float>(i), 1.0f, 2.0f), V4D(0.0f, 0.0f, 0.0f, 1.0f));
+				if (withNulls && i % 3 == 1) Fake::put<void*>(character.module, 0x68, nullptr);
+				if (withNulls && i % 7 == 2) Fake::put<void*>(character.behavior, 0x10, nullptr);
+				this->chrInses.push_back(character.chrIns);
+			}
+
+			// in a random order, as the characters are in the map of SkeletonMan
+			std::shuffle(this->chrInses.begin(), this->chrInses.end(), std::mt19937(40));
+			if (!withNulls) return;
+			for (size_t i = 0; i < count; i++) {
+				if (i % 5 == 3) Fake::put<void*>(this->chrInses[i], 0x190, nullptr);
+			}
+		}
+	};
+
+	template <typename Chain> bool batchMatchesSerial(const Characters& characters, size_t& nulls)
+	{
+		const size_t count = characters.chrInses.size();
+		std::vector<typename Chain::PointerType*> results(count, reinterpret_cast<typename Chain::PointerType*>(1));
+		PointerChain::resolveBatch<Chain>(characters.chrInses.data(), results.data(), count);
+
+		for (size_t i = 0; i < count; i++) {
+			typename Chain::PointerType* serial = std::get<0>(PointerChain::Bundle<Chain>::resolve(characters.chrInses[i]));
+			if (results[i] != serial) {
+				printf("  character %zu of %zu: %p, %p on its own\n", i, count, static_cast<void*>(results[i]), static_cast<void*>(serial));
+				return false;
+			}
+			nulls += !serial;
+		}
+		return true;
+	}
+}
+
+TEST(BatchMatchesSerial)
+{
+	for (const size_t count : { 0, 1, 7, 64 }) {
+		const Characters characters(count, false);
+		size_t nulls = 0;
+		CHECK(batchMatchesSerial<Module>(characters, nulls));
+		CHECK(batchMatchesSerial<Position>(characters, nulls));
+		CHECK(batchMatchesSerial<Orientation>(characters, nulls));
+		CHECK(batchMatchesSerial<Behavior>(characters, nulls));
+		CHECK(nulls == 0);
+	}
+
+	// the module block is found for every character, whatever its order
+	const Characters characters(16, false);
+	std::vector<uint8_t*> modules(16);
+	PointerChain::resolveBatch<Module>(characters.chrInses.data(), modules.data(), 16);
+	for (size_t i = 0; i < 16; i++) CHECK(modules[i] == *reinterpret_cast<uint8_t**>(characters.chrInses[i] + 0x190));
+}
+
+// A failed nullptr check resolves to nullptr, and the walk is not continued from it.
+TEST(BatchMatchesSerialWithNullHops)
+{
+	for (const size_t count : { 1, 5, 64, 105 }) {
+		const Characters characters(count, true);
+
+		// the first hop of Position, the second hop of Orientation and the third hop of Behavior
+		size_t positionNulls = 0, orientationNulls = 0, behaviorNulls = 0;
+		CHECK(batchMatchesSerial<Position>(characters, positionNulls));
+		CHECK(batchMatchesSerial<Behavior>(characters, behaviorNulls));
+
+		Characters withModules(count, false);
+		for (size_t i = 0; i < count; i++) {
+			if (i % 3 == 1) Fake::put<void*>(withModules.owned[i]->module, 0x68, nullptr);
+		}
+		CHECK(batchMatchesSerial<Orientation>(withModules, orientationNulls));
+
+		if (count >= 64) CHECK(positionNulls > 0 && orientationNulls > 0 && behaviorNulls > 0);
+	}
+}
+
+int main()
+{
+	return Test::run();
+}
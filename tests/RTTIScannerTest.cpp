@@ -0,0 +1,277 @@
+#include <sys/mman.h>
+#include <fstream>
+#include <set>
+#include <iterator>
+#include <thread>
+
+#include "include/PEImage.h"
+#include "include/RTTIScanner.h"
+#include "SyntheticPE.h"
+#include "Test.h"
+
+// RTTIScanner on synthetic PE images loaded with PEImage, see SyntheticPE.h. Every class must be found at the first of its
+// virtual function tables, including the tables at the very first and the very last slot of .rdata, whatever the thread count.
+
+namespace {
+	struct LoadedImage {
+		SyntheticPE::Image image;
+		SyntheticPE::TempFile file;
+		PEImage loaded;
+
+		LoadedImage(const SyntheticPE::Options& options) : image(SyntheticPE::build(options)), file(image.file), loaded(file.getPath()) {}
+	};
+
+	// The virtual function table the scanner found for every class of the image, nullptr for classes it did not find.
+	std::vector<void**> foundTables(const LoadedImage& image)
+	{
+		std::vector<void**> tables;
+		for (const SyntheticPE::Class& c : image.image.classes) {
+			RTTIScanner::RTTI* rtti = RTTIScanner::getClassRTTI(c.name);
+			tables.push_back(!!rtti ? rtti->pVirtualFunctionTable : nullptr);
+		}
+		return tables;
+	}
+
+	bool foundAll(const LoadedImage& image, const std::vector<void**>& tables)
+	{
+		int mismatches = 0;
+		for (size_t i = 0; i < tables.size(); i++) {
+			void** expected = reinterpret_cast<void**>(image.loaded.getBase() + image.image.classes[i].vft);
+			if (tables[i] == expected) continue;
+			if (mismatches++ < 5) printf("  %s: %p, expected %p\n", image.image.classes[i].name.c_str(), static_cast<void*>(tables[i]), static_cast<void*>(expected));
+		}
+		return mismatches == 0;
+	}
+
+	std::vector<unsigned char> readFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	bool fileExists(const std::string& path)
+	{
+		return std::ifstream(path).good();
+	}
+}
+
+// Large enough .rdata sections to be split into several chunks per section.
+TEST(ThreadedScanMatchesSerialScan)
+{
+	SyntheticPE::Options options;
+	options.classCount = 600;
+	options.secondaryTables = 100;
+	options.decoys = 4000;
+	options.rdataSections = 2;
+	options.rdataSize = 0x60000;
+	const LoadedImage image(options);
+
+	RTTIScanner scanner;
+	if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), 1))) return;
+	const std::vector<void**> serial = foundTables(image);
+	CHECK(foundAll(image, serial));
+
+	for (const unsigned int threadCount : { 2u, 3u, 8u, 0u }) {
+		if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), threadCount))) return;
+		if (!CHECK(foundTables(image) == serial)) printf("  %u threads\n", threadCount);
+	}
+}
+
+// The first class's table starts right after the first slot of .rdata, which holds its complete object locator pointer.
+// The second class's table is the last slot of the last .rdata section, the scan must not read past it.
+TEST(ScanCoversSectionEnds)
+{
+	for (const size_t sections : { 1, 3 }) {
+		SyntheticPE::Options options;
+		options.classCount = 16;
+		options.rdataSections = sections;
+		options.rdataSize = 0x2000;
+		options.decoys = 32;
+		const LoadedImage image(options);
+
+		const SyntheticPE::Section& firstRdata = image.image.sections[1];
+		const SyntheticPE::Section& lastRdata = image.image.sections[sections];
+		CHECK(image.image.classes[0].vft == firstRdata.virtualAddress + 8);
+		CHECK(image.image.classes[1].vft == lastRdata.virtualAddress + lastRdata.virtualSize - 8);
+
+		RTTIScanner scanner;
+		for (const unsigned int threadCount : { 1u, 4u }) {
+			if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), threadCount))) return;
+			if (!CHECK(foundAll(image, foundTables(image)))) printf("  %zu .rdata sections, %u threads\n", sections, threadCount);
+		}
+	}
+}
+
+// RTTIScanner::scanFor finds the same RTTI as a full scan for every requested class, in the order requested,
+// reports the ones that do not exist as nullptr and maps no other class.
+TEST(ScanForMatchesFullScan)
+{
+	SyntheticPE::Options options;
+	options.classCount = 200;
+	options.secondaryTables = 40;
+	options.decoys = 2000;
+	options.rdataSections = 2;
+	options.rdataSize = 0x40000;
+	const LoadedImage image(options);
+
+	RTTIScanner scanner;
+	if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), 1))) return;
+	const std::vector<void**> full = foundTables(image);
+	CHECK(foundAll(image, full));
+
+	// classes with a secondary table, structs, the classes at the ends of .rdata, and names that are not in the image
+	const std::vector<size_t> requested = { 150, 2, 0, 4, 1, 9, 41, 199 };
+	std::vector<std::string_view> names;
+	for (const size_t i : requested) names.push_back(image.image.classes[i].name);
+	names.insert(names.begin() + 3, "Synthetic::Missing");
+	names.push_back("Synthetic::Class200");
+
+	const std::vector<RTTIScanner::RTTI*> found = scanner.scanFor(names, image.loaded.makeProcessInfo());
+	if (!CHECK(found.size() == names.size())) return;
+	for (size_t i = 0, r = 0; i < names.size(); i++) {
+		if (i == 3 || i == names.size() - 1) {
+			CHECK(!found[i]);
+			continue;
+		}
+		const size_t index = requested[r++];
+		if (!CHECK(!!found[i] && found[i]->pVirtualFunctionTable == full[index])) printf("  %s\n", image.image.classes[index].name.c_str());
+	}
+
+	CHECK(!RTTIScanner::getClassRTTI(image.image.classes[3].name));
+	CHECK(!!RTTIScanner::getClassRTTI(image.image.classes[150].name));
+}
+
+// Once every requested class is found the scan stops. The first class's table is in the first window of the first .rdata section,
+// so every page of the last .rdata section that no RTTI structure is on is made unreadable: scanning that far would crash.
+TEST(ScanForStopsOnceAllFound)
+{
+	SyntheticPE::Options options;
+	options.classCount = 64;
+	options.decoys = 16;
+	options.rdataSections = 2;
+	options.rdataSize = 0x100000;
+	const LoadedImage image(options);
+	unsigned char* base = image.loaded.getBase();
+
+	RTTIScanner scanner;
+	if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), 1))) return;
+
+	// the pages a scan dereferences: the targets of all pointers, e.g. of decoys and secondary tables, and the structures of every class
+	std::set<uintptr_t> structurePages;
+	const auto addPages = [&](const void* p, const size_t size) {
+		structurePages.insert(reinterpret_cast<uintptr_t>(p) & ~0xFFFull);
+		structurePages.insert((reinterpret_cast<uintptr_t>(p) + size - 1) & ~0xFFFull);
+	};
+	for (const auto& [rva, value] : image.image.pointers) addPages(base + (value - SyntheticPE::imageBase), 24);
+	for (const SyntheticPE::Class& c : image.image.classes) {
+		RTTIScanner::RTTI* rtti = RTTIScanner::getClassRTTI(c.name);
+		if (!CHECK(!!rtti)) return;
+		addPages(rtti->pCompleteObjectLocator, sizeof(RTTIScanner::CompleteObjectLocator));
+		addPages(rtti->pClassHierarchyDescriptor, sizeof(RTTIScanner::ClassHierarchyDescriptor));
+		addPages(rtti->pBaseClassDescriptor, 32);
+	}
+
+	const SyntheticPE::Section& lastRdata = image.image.sections[2];
+	std::vector<unsigned char*> protectedPages;
+	for (uint32_t offset = 0; offset < lastRdata.virtualSize; offset += 0x1000) {
+		unsigned char* page = base + lastRdata.virtualAddress + offset;
+		if (structurePages.count(reinterpret_cast<uintptr_t>(page))) continue;
+		if (mprotect(page, 0x1000, PROT_NONE) == 0) protectedPages.push_back(page);
+	}
+	if (!CHECK(protectedPages.size() > 64)) printf("  %zu pages protected\n", protectedPages.size());
+
+	const std::vector<RTTIScanner::RTTI*> found = scanner.scanFor({ image.image.classes[0].name }, image.loaded.makeProcessInfo());
+	CHECK(found.size() == 1 && !!found[0] && found[0]->pVirtualFunctionTable == reinterpret_cast<void**>(base + image.image.classes[0].vft));
+
+	for (unsigned char* page : protectedPages) mprotect(page, 0x1000, PROT_READ | PROT_WRITE);
+}
+
+// The cache is written by a full scan and used by the next one. To tell the two apart, the first virtual function of class 0 is cleared
+// after the cache is written: a scan skips a table that does not point into .text, while the cache only checks the locators.
+TEST(CacheRoundTrip)
+{
+	SyntheticPE::Options options;
+	options.classCount = 64;
+	const LoadedImage image(options);
+	const SyntheticPE::TempFile cache;
+	const std::string tempPath = std::string(cache.getPath()) + ".tmp";
+
+	RTTIScanner scanner;
+	if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), 1, cache.getPath()))) return;
+	CHECK(foundAll(image, foundTables(image)));
+	const std::vector<unsigned char> saved = readFile(cache.getPath());
+	CHECK(!saved.empty());
+	CHECK(!fileExists(tempPath));
+
+	void** vft = reinterpret_cast<void**>(image.loaded.getBase() + image.image.classes[0].vft);
+	void* const function = vft[0];
+	vft[0] = nullptr;
+
+	if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), 4, cache.getPath()))) return;
+	CHECK(foundAll(image, foundTables(image)));
+	CHECK(readFile(cache.getPath()) == saved);
+
+	if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), 1))) return;
+	CHECK(foundTables(image)[0] != vft);
+
+	vft[0] = function;
+}
+
+// A cache made for an image with another timestamp is rejected, the image is scanned and the cache is replaced.
+TEST(CacheIdentityMismatch)
+{
+	SyntheticPE::Options options;
+	options.classCount = 64;
+	const LoadedImage first(options);
+	options.timestamp++;
+	const LoadedImage second(options);
+	const SyntheticPE::TempFile cache;
+
+	RTTIScanner scanner;
+	if (!CHECK(scanner.scan(first.loaded.makeProcessInfo(), 1, cache.getPath()))) return;
+	const std::vector<unsigned char> firstCache = readFile(cache.getPath());
+
+	// the cache entries would validate against the second image, only the identity tells them apart
+	void** vft = reinterpret_cast<void**>(second.loaded.getBase() + second.image.classes[0].vft);
+	void* const function = vft[0];
+	vft[0] = nullptr;
+
+	if (!CHECK(scanner.scan(second.loaded.makeProcessInfo(), 1, cache.getPath()))) return;
+	CHECK(foundTables(second)[0] != vft);
+	const std::vector<unsigned char> secondCache = readFile(cache.getPath());
+	CHECK(!secondCache.empty() && secondCache != firstCache);
+	CHECK(!fileExists(std::string(cache.getPath()) + ".tmp"));
+
+	vft[0] = function;
+}
+
+// RTTIScanner::scanFor only ever saves a complete class map: without a valid cache it does a full scan and writes it,
+// and with one it leaves the file as it is.
+TEST(ScanForSavesCompleteCache)
+{
+	SyntheticPE::Options options;
+	options.classCount = 64;
+	const LoadedImage image(options);
+	const SyntheticPE::TempFile fullCache;
+	const SyntheticPE::TempFile scanForCache;
+
+	RTTIScanner scanner;
+	if (!CHECK(scanner.scan(image.loaded.makeProcessInfo(), 1, fullCache.getPath()))) return;
+	const std::vector<unsigned char> full = readFile(fullCache.getPath());
+
+	const std::vector<std::string_view> names = { image.image.classes[2].name, image.image.classes[3].name };
+	std::vector<RTTIScanner::RTTI*> found = scanner.scanFor(names, image.loaded.makeProcessInfo(), scanForCache.getPath());
+	CHECK(found.size() == 2 && !!found[0] && !!found[1]);
+	CHECK(readFile(scanForCache.getPath()) == full);
+	CHECK(foundAll(image, foundTables(image)));
+
+	found = scanner.scanFor(names, image.loaded.makeProcessInfo(), fullCache.getPath());
+	CHECK(found.size() == 2 && !!found[0] && !!found[1]);
+	CHECK(readFile(fullCache.getPath()) == full);
+	CHECK(foundAll(image, foundTables(image)));
+}
+
+int main()
+{
+	return Test::run();
+}
@@ -0,0 +1,124 @@
+#include <random>
+#include <vector>
+
+#include "include/PE.h"
+#include "Test.h"
+
+// PEParser::SectionRanges built from synthetic sections against a fake base address, which is never dereferenced.
+// The ranges must be sorted and merged, and every membership check must agree with a linear search over the sections.
+
+namespace {
+	using Range = PEParser::SectionRanges::Range;
+
+	unsigned char* const base = reinterpret_cast<unsigned char*>(static_cast<uintptr_t>(0x140000000));
+
+	// Sections as start and end offsets from the base, in the given order.
+	PEParser::PESections makeSections(const std::vector<std::pair<int, int>>& offsets)
+	{
+		PEParser::PESections sections;
+		for (const auto& [start, end] : offsets) {
+			sections.push_back(std::make_unique<PEParser::Section>(PEParser::Section{ ".rdata", static_cast<size_t>(end - start), start, end }));
+		}
+		return sections;
+	}
+
+	bool linearContains(const std::vector<std::pair<int, int>>& offsets, const uintptr_t address)
+	{
+		for (const auto& [start, end] : offsets) {
+			if (reinterpret_cast<uintptr_t>(base) + start <= address && address < reinterpret_cast<uintptr_t>(base) + end) return true;
+		}
+		return false;
+	}
+
+	bool sameRanges(const PEParser::SectionRanges& ranges, const std::vector<std::pair<int, int>>& expected)
+	{
+		const std::vector<Range>& actual = ranges.getRanges();
+		if (actual.size() != expected.size()) {
+			printf("  %zu ranges, expected %zu\n", actual.size(), expected.size());
+			return false;
+		}
+		for (size_t i = 0; i < actual.size(); i++) {
+			if (actual[i].start != reinterpret_cast<uintptr_t>(base) + expected[i].first || actual[i].end != reinterpret_cast<uintptr_t>(base) + expected[i].second) {
+				printf("  range %zu: [%#zx, %#zx)\n", i, static_cast<size_t>(actual[i].start - reinterpret_cast<uintptr_t>(base)), static_cast<size_t>(actual[i].end - reinterpret_cast<uintptr_t>(base)));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Every boundary of every section and the addresses around it, as addresses, pointers and integer base offsets.
+	bool containsMatchesLinearSearch(const std::vector<std::pair<int, int>>& offsets)
+	{
+		PEParser::PESections sections = makeSections(offsets);
+		const PEParser::SectionRanges ranges(sections, base);
+
+		std::vector<int> probes = { -0x1000, -1, 0, 0x7FFFFFFF };
+		for (const auto& [start, end] : offsets) {
+			for (const int offset : { start - 1, start, start + 1, end - 1, end, end + 1, start + (end - start) / 2 }) probes.push_back(offset);
+		}
+
+		for (const int offset : probes) {
+			const uintptr_t address = reinterpret_cast<uintptr_t>(base) + static_cast<intptr_t>(offset);
+			const bool expected = linearContains(offsets, address);
+			if (ranges.contains(address) != expected || ranges.contains(reinterpret_cast<void*>(address)) != expected
+				|| ranges.contains(PEParser::ibo32(offset)) != expected) {
+				printf("  offset %#x of %zu sections: expected %d\n", offset, offsets.size(), expected);
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+// Unsorted sections, overlapping, adjacent, nested and apart. Adjacent sections merge, as an end is exclusive.
+TEST(RangesAreSortedAndMerged)
+{
+	PEParser::PESections empty;
+	const PEParser::SectionRanges none(empty, base);
+	CHECK(none.getRanges().empty());
+	CHECK(!none.contains(reinterpret_cast<uintptr_t>(base)));
+
+	PEParser::PESections sections = makeSections({ { 0x9000, 0xA000 }, { 0x1000, 0x3000 }, { 0x5000, 0x6000 }, { 0x2000, 0x4000 }, { 0x6000, 0x7000 }, { 0x5200, 0x5800 } });
+	CHECK(sameRanges(PEParser::SectionRanges(sections, base), { { 0x1000, 0x4000 }, { 0x5000, 0x7000 }, { 0x9000, 0xA000 } }));
+
+	// a section nested in the one before it must not shorten it
+	sections = makeSections({ { 0x1000, 0x8000 }, { 0x2000, 0x3000 }, { 0x9000, 0x9100 } });
+	CHECK(sameRanges(PEParser::SectionRanges(sections, base), { { 0x1000, 0x8000 }, { 0x9000, 0x9100 } }));
+}
+
+// A single range, given as one section or merged from several, takes the single compare path.
+// Addresses below the range wrap around to large differences and must not be contained.
+TEST(SingleRange)
+{
+	for (const auto& offsets : std::vector<std::vector<std::pair<int, int>>>{ { { 0x1000, 0x5000 } }, { { 0x3000, 0x5000 }, { 0x1000, 0x3000 }, { 0x2000, 0x2800 } } }) {
+		PEParser::PESections sections = makeSections(offsets);
+		const PEParser::SectionRanges ranges(sections, base);
+		CHECK(sameRanges(ranges, { { 0x1000, 0x5000 } }));
+		CHECK(containsMatchesLinearSearch(offsets));
+
+		CHECK(!ranges.contains(static_cast<uintptr_t>(0)));
+		CHECK(!ranges.contains(UINTPTR_MAX));
+		CHECK(ranges.contains(reinterpret_cast<uintptr_t>(base) + 0x1000));
+		CHECK(!ranges.contains(reinterpret_cast<uintptr_t>(base) + 0x5000));
+	}
+}
+
+// Random layouts with up to a dozen sections, some of which touch or overlap.
+TEST(ContainsMatchesLinearSearch)
+{
+	std::mt19937 rng(47);
+	for (int layout = 0; layout < 500; layout++) {
+		std::vector<std::pair<int, int>> offsets;
+		const size_t count = rng() % 12;
+		for (size_t i = 0; i < count; i++) {
+			const int start = static_cast<int>(rng() % 64) * 0x200;
+			offsets.emplace_back(start, start + static_cast<int>(1 + rng() % 8) * 0x200);
+		}
+		if (!CHECK(containsMatchesLinearSearch(offsets))) return;
+	}
+}
+
+int main()
+{
+	return Test::run();
+}
@@ -0,0 +1,272 @@
+#include <random>
+#include <vector>
+#include <stdexcept>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "include/SignatureScanner.h"
+#include "Test.h"
+
+// Fuzzes SignatureScanner against a naive scanner, at every CPU tier. The scanned memory ends at an unreadable page,
+// so a kernel that reads past the end of a block faults, the handler reports the case that was running.
+
+namespace {
+	using Signature = SignatureScanner::Signature;
+
+	char currentCase[128] = "";
+
+	void onFault(int)
+	{
+		const char message[] = "  read past the end of the scanned memory into the guard page: ";
+		(void)!write(STDOUT_FILENO, message, sizeof(message) - 1);
+		(void)!write(STDOUT_FILENO, currentCase, strlen(currentCase));
+		(void)!write(STDOUT_FILENO, "\n", 1);
+		_exit(1);
+	}
+
+	// Memory that ends right before a PROT_NONE page.
+	class GuardedMemory {
+	public:
+		GuardedMemory(const size_t size)
+		{
+			const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			this->mappingSize = (size + pageSize - 1) / pageSize * pageSize + pageSize;
+			void* mapping = mmap(nullptr, this->mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapping == MAP_FAILED) return;
+
+			this->mapping = static_cast<unsigned char*>(mapping);
+			mprotect(this->mapping + this->mappingSize - pageSize, pageSize, PROT_NONE);
+			this->endPointer = this->mapping + this->mappingSize - pageSize;
+			this->beginPointer = this->endPointer - size;
+		}
+
+		~GuardedMemory()
+		{
+			if (!!this->mapping) munmap(this->mapping, this->mappingSize);
+		}
+
+		bool valid() const { return !!this->mapping; }
+		unsigned char* begin() const { return this->beginPointer; }
+		unsigned char* end() const { return this->endPointer; }
+
+	private:
+		unsigned char* mapping = nullptr;
+		size_t mappingSize = 0;
+		unsigned char* beginPointer = nullptr;
+		unsigned char* endPointer = nullptr;
+	};
+
+	// A random signature over a small alphabet, with wildcard bytes and wildcard bits. The alphabet of the memory is the same,
+	// so that anchors often match and candidates fail late in verification.
+	struct RandomSignature {
+		std::vector<unsigned char> bytes, ignore;
+
+		RandomSignature(std::mt19937& rng, const size_t length) : bytes(length), ignore(length)
+		{
+			for (size_t i = 0; i < length; i++) {
+				this->bytes[i] = static_cast<unsigned char>(rng() % 4 + (rng() % 3 == 0 ? 0x40 : 0));
+				const int kind = rng() % 6;
+				this->ignore[i] = kind == 0 ? 0xFF : kind == 1 ? static_cast<unsigned char>(rng()) : 0;
+			}
+		}
+
+		Signature make() const { return Signature(this->bytes.data(), this->ignore.data(), this->bytes.size()); }
+
+		bool matches(const unsigned char* mem) const
+		{
+			for (size_t i = 0; i < this->bytes.size(); i++) {
+				if ((mem[i] | this->ignore[i]) != (this->bytes[i] | this->ignore[i])) return false;
+			}
+			return true;
+		}
+	};
+
+	std::vector<unsigned char*> naiveScan(const RandomSignature& signature, unsigned char* begin, unsigned char* end)
+	{
+		std::vector<unsigned char*> matches;
+		for (unsigned char* position = begin; static_cast<size_t>(end - position) >= signature.bytes.size(); position++) {
+			if (signature.matches(position)) matches.push_back(position);
+		}
+		return matches;
+	}
+
+	void fillLowEntropy(std::mt19937& rng, unsigned char* begin, unsigned char* end)
+	{
+		for (unsigned char* p = begin; p < end; p++) *p = static_cast<unsigned char>(rng() % 4 + (rng() % 16 == 0 ? 0x40 : 0));
+	}
+
+	std::vector<CPUFeatures::Tier> supportedTiers()
+	{
+		std::vector<CPUFeatures::Tier> tiers;
+		for (int tier = 0; tier <= static_cast<int>(CPUFeatures::detect()); tier++) tiers.push_back(static_cast<CPUFeatures::Tier>(tier));
+		return tiers;
+	}
+}
+
+TEST(ParsesPatterns)
+{
+	const Signature signature("48 8D 05 ?? ? 4c 89");
+	CHECK(signature.size() == 7);
+
+	const unsigned char code[] = { 0x48, 0x8D, 0x05, 0x12, 0x34, 0x4C, 0x89 };
+	CHECK(signature.matches(code));
+	unsigned char other[sizeof(code)];
+	memcpy(other, code, sizeof(code));
+	other[5] = 0x4D;
+	CHECK(!signature.matches(other));
+
+	for (const char* invalid : { "", "4", "4G", "48 8", "48 XX", "  " }) {
+		bool threw = false;
+		try {
+			Signature parsed(invalid);
+		}
+		catch (const std::runtime_error&) {
+			threw = true;
+		}
+		if (!CHECK(threw)) printf("  \"%s\"\n", invalid);
+	}
+}
+
+TEST(ScanMatchesNaiveScan)
+{
+	constexpr size_t size = 1 << 18;
+	GuardedMemory memory(size);
+	if (!CHECK(memory.valid())) return;
+
+	std::mt19937 rng(49);
+	fillLowEntropy(rng, memory.begin(), memory.end());
+
+	for (int trial = 0; trial < 60; trial++) {
+		const RandomSignature random(rng, 1 + rng() % 40);
+		const Signature signature = random.make();
+
+		// plant copies, one ending at the end of the memory, and near misses that differ in one compared bit
+		for (int copy = 0; copy < 4; copy++) {
+			memcpy(memory.begin() + rng() % (size - random.bytes.size()), random.bytes.data(), random.bytes.size());
+		}
+		memcpy(memory.end() - random.bytes.size(), random.bytes.data(), random.bytes.size());
+		for (int copy = 0; copy < 8; copy++) {
+			unsigned char* miss = memory.begin() + rng() % (size - random.bytes.size());
+			memcpy(miss, random.bytes.data(), random.bytes.size());
+			const size_t i = rng() % random.bytes.size();
+			const unsigned char bit = static_cast<unsigned char>(1 << rng() % 8);
+			if (!(random.ignore[i] & bit)) miss[i] ^= bit;
+		}
+
+		unsigned char* begin = memory.begin() + rng() % 64;
+		const std::vector<unsigned char*> expected = naiveScan(random, begin, memory.end());
+
+		for (const CPUFeatures::Tier tier : supportedTiers()) {
+			CPUFeatures::force(tier);
+			snprintf(currentCase, sizeof(currentCase), "signature of %zu bytes, tier %d", random.bytes.size(), static_cast<int>(tier));
+			const std::vector<unsigned char*> all = SignatureScanner::scan(signature, begin, memory.end());
+			const std::vector<unsigned char*> first = SignatureScanner::scan(signature, begin, memory.end(), SignatureScanner::Mode::First);
+
+			if (!CHECK(all == expected)) printf("  trial %d, tier %d: %zu matches, expected %zu\n", trial, static_cast<int>(tier), all.size(), expected.size());
+			CHECK(first.size() == 1 && first[0] == expected[0]);
+		}
+	}
+	CPUFeatures::initialize();
+}
+
+// Blocks of every size near the SIMD block and verification sizes, ending at the guard page.
+TEST(ShortBlocks)
+{
+	GuardedMemory memory(4096);
+	if (!CHECK(memory.valid())) return;
+
+	std::mt19937 rng(50);
+	fillLowEntropy(rng, memory.begin(), memory.end());
+
+	for (const size_t signatureSize : { 1, 2, 5, 16, 17, 32, 33 }) {
+		const RandomSignature random(rng, signatureSize);
+		const Signature signature = random.make();
+		memcpy(memory.end() - signatureSize, random.bytes.data(), signatureSize);
+
+		for (size_t blockSize = 0; blockSize < 140; blockSize++) {
+			unsigned char* begin = memory.end() - blockSize;
+			const std::vector<unsigned char*> expected = naiveScan(random, begin, memory.end());
+
+			for (const CPUFeatures::Tier tier : supportedTiers()) {
+				CPUFeatures::force(tier);
+				snprintf(currentCase, sizeof(currentCase), "signature of %zu bytes, block of %zu, tier %d", signatureSize, blockSize, static_cast<int>(tier));
+				if (!CHECK(SignatureScanner::scan(signature, begin, memory.end()) == expected)) printf("  %s\n", currentCase);
+			}
+		}
+	}
+	CPUFeatures::initialize();
+
+	// an empty or reversed block has no matches
+	const Signature signature("00");
+	CHECK(SignatureScanner::scan(signature, memory.end(), memory.begin()).empty());
+	CHECK(SignatureScanner::scan(signature, static_cast<const PEParser::SectionRanges*>(nullptr)).empty());
+}
+
+// A set scan must find what separate scans of its signatures find, with chunks and threads, at every tier.
+TEST(SetScanMatchesSeparateScans)
+{
+	// large enough to be split into 4 chunks
+	constexpr size_t size = 4 << 20;
+	GuardedMemory memory(size);
+	if (!CHECK(memory.valid())) return;
+
+	std::mt19937 rng(51);
+	for (int trial = 0; trial < 4; trial++) {
+		unsigned char* begin = memory.begin() + rng() % 64;
+		unsigned char* end = memory.end() - rng() % 2;
+		fillLowEntropy(rng, begin, end);
+		const size_t length = end - begin;
+
+		std::vector<RandomSignature> randoms;
+		std::vector<Signature> signatures;
+		const size_t count = 1 + rng() % 40;
+		for (size_t i = 0; i < count; i++) {
+			randoms.emplace_back(rng, 1 + rng() % 24);
+			signatures.push_back(randoms.back().make());
+
+			// plant copies across the boundaries between chunks, and at the end
+			const std::vector<unsigned char>& bytes = randoms.back().bytes;
+			for (int copy = 0; copy < 4; copy++) {
+				const size_t at = length * (rng() % 4 + 1) / 4 - rng() % (bytes.size() + 1);
+				if (at + bytes.size() <= length) memcpy(begin + at, bytes.data(), bytes.size());
+			}
+		}
+		const SignatureScanner::SignatureSet set(signatures);
+
+		CPUFeatures::force(CPUFeatures::Tier::SSE2);
+		std::vector<std::vector<unsigned char*>> expected;
+		for (const Signature& signature : signatures) expected.push_back(SignatureScanner::scan(signature, begin, end));
+
+		for (const CPUFeatures::Tier tier : supportedTiers()) {
+			CPUFeatures::force(tier);
+			for (const unsigned int threads : { 1u, 3u }) {
+				snprintf(currentCase, sizeof(currentCase), "set of %zu signatures, tier %d, %u threads", count, static_cast<int>(tier), threads);
+				if (!CHECK(SignatureScanner::scan(set, begin, end, threads) == expected)) printf("  trial %d, %s\n", trial, currentCase);
+			}
+		}
+
+		// short regions ending at the guard page, every size near the fingerprint and block sizes
+		for (size_t blockSize = 0; blockSize < 80; blockSize++) {
+			unsigned char* blockBegin = memory.end() - blockSize;
+			CPUFeatures::force(CPUFeatures::Tier::SSE2);
+			std::vector<std::vector<unsigned char*>> blockExpected;
+			for (const Signature& signature : signatures) blockExpected.push_back(SignatureScanner::scan(signature, blockBegin, memory.end()));
+
+			for (const CPUFeatures::Tier tier : supportedTiers()) {
+				CPUFeatures::force(tier);
+				snprintf(currentCase, sizeof(currentCase), "set of %zu signatures, block of %zu, tier %d", count, blockSize, static_cast<int>(tier));
+				if (!CHECK(SignatureScanner::scan(set, blockBegin, memory.end()) == blockExpected)) printf("  trial %d, %s\n", trial, currentCase);
+			}
+		}
+	}
+	CPUFeatures::initialize();
+}
+
+int main()
+{
+	CPUFeatures::initialize();
+	signal(SIGSEGV, onFault);
+	signal(SIGBUS, onFault);
+	return Test::run();
+}
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// Builds PE32+ images with MSVC style RTTI, for testing and benchmarking PEImage, PEParser and RTTIScanner without the game.
+// Sections are stored at file offsets that differ from their virtual addresses and every absolute pointer has a base relocation,
+// so an image only makes sense once it has been placed and relocated like the loader would.
+
+namespace SyntheticPE {
+	constexpr uint64_t imageBase = 0x140000000;
+	constexpr uint32_t sectionAlignment = 0x1000;
+	constexpr uint32_t fileAlignment = 0x200;
+	constexpr uint32_t sizeOfHeaders = 0x400;
+
+	struct Options {
+		size_t classCount = 64;
+		// Classes with a second virtual function table, as with multiple inheritance. A scan must find the first one.
+		size_t secondaryTables = 8;
+		// Slot pairs that look like a complete object locator pointer followed by a function pointer, but point to garbage.
+		size_t decoys = 256;
+		size_t rdataSections = 1;
+		// Bytes per .rdata section, a multiple of 8.
+		size_t rdataSize = 0x10000;
+		uint32_t timestamp = 0x5EED0001;
+		// Whether SizeOfImage is rounded up to the section alignment, as the loader requires.
+		bool alignSizeOfImage = true;
+		unsigned int seed = 42;
+	};
+
+	struct Section {
+		std::string name;
+		uint32_t virtualAddress;
+		uint32_t virtualSize;
+		uint32_t rawOffset;
+		uint32_t rawSize;
+	};
+
+	struct Class {
+		std::string name; // e.g. "Synthetic::Class12"
+		std::string mangledName; // e.g. ".?AVClass12@Synthetic@@"
+		uint32_t vft; // the RVA of the class's first virtual function table in .rdata order, the one a scan keeps
+	};
+
+	struct Image {
+		std::vector<unsigned char> file;
+		std::vector<Section> sections;
+		std::vector<Class> classes;
+		// Every absolute pointer in the image, as its RVA and its value for the preferred image base.
+		std::vector<std::pair<uint32_t, uint64_t>> pointers;
+		uint32_t sizeOfImage;
+	};
+
+	namespace Impl {
+		inline uint32_t alignUp(const size_t value, const uint32_t alignment)
+		{
+			return static_cast<uint32_t>((value + alignment - 1) & ~static_cast<size_t>(alignment - 1));
+		}
+
+		template <typename T> void put(std::vector<unsigned char>& bytes, const size_t offset, const T value)
+		{
+			memcpy(bytes.data() + offset, &value, sizeof(T));
+		}
+
+		struct Content {
+			Section header;
+			std::vector<unsigned char> bytes; // the virtual contents, zero beyond what the file stores
+			uint32_t rawContentSize; // how much of the contents the file stores
+			unsigned char rawPadding; // the file's padding beyond the virtual size, which must not be loaded
+		};
+
+		class Builder {
+		public:
+			Builder(const Options& options) : options(options), rng(options.seed) {}
+
+			Image build()
+			{
+				Image image;
+
+				// .text is padded in the file beyond its virtual size, .data is zero filled in memory beyond its raw size
+				uint32_t rva = sectionAlignment;
+				this->addSection(".text", rva, 0x2F00, 0x2F00, 0xAB);
+				std::fill(this->sections[0].bytes.begin(), this->sections[0].bytes.end(), 0xCC);
+				for (size_t i = 0; i < this->options.rdataSections; i++) {
+					this->addSection(".rdata", rva, static_cast<uint32_t>(this->options.rdataSize), static_cast<uint32_t>(this->options.rdataSize), 0);
+				}
+				this->rdataBegin = 1;
+				this->rdataEnd = 1 + this->options.rdataSections;
+				for (size_t i = this->rdataBegin; i < this->rdataEnd; i++) this->used.emplace_back(this->sections[i].bytes.size() / 8, false);
+
+				size_t dataSize = 0;
+				for (size_t i = 0; i < this->options.classCount; i++) dataSize += alignUp(16 + mangledName(i).size() + 1, 16);
+				const uint32_t dataRaw = alignUp(dataSize, fileAlignment);
+				this->addSection(".data", rva, dataRaw + 0x800, dataRaw, 0);
+				this->dataIndex = this->sections.size() - 1;
+
+				this->placeClasses(image);
+				this->placeDecoys();
+				this->fillGarbage();
+
+				// the relocations of all pointers, in blocks of one page
+				std::sort(this->pointers.begin(), this->pointers.end());
+				std::vector<unsigned char> relocations;
+				for (size_t i = 0; i < this->pointers.size();) {
+					const uint32_t page = this->pointers[i].first & ~0xFFFu;
+					std::vector<uint16_t> entries;
+					for (; i < this->pointers.size() && (this->pointers[i].first & ~0xFFFu) == page; i++) {
+						entries.push_back(static_cast<uint16_t>(10 << 12 | (this->pointers[i].first & 0xFFF))); // IMAGE_REL_BASED_DIR64
+					}
+					if (entries.size() % 2) entries.push_back(0); // IMAGE_REL_BASED_ABSOLUTE, padding
+
+					const size_t block = relocations.size();
+					relocations.resize(block + 8 + entries.size() * 2);
+					put<uint32_t>(relocations, block, page);
+					put<uint32_t>(relocations, block + 4, static_cast<uint32_t>(8 + entries.size() * 2));
+					memcpy(relocations.data() + block + 8, entries.data(), entries.size() * 2);
+				}
+				const uint32_t relocSize = static_cast<uint32_t>(relocations.size());
+				this->addSection(".reloc", rva, relocSize, relocSize, 0);
+				std::copy(relocations.begin(), relocations.end(), this->sections.back().bytes.begin());
+
+				const Section& last = this->sections.back().header;
+				image.sizeOfImage = this->options.alignSizeOfImage ? alignUp(last.virtualAddress + last.virtualSize, sectionAlignment) : last.virtualAddress + last.virtualSize;
+				image.file = this->writeFile(image.sizeOfImage, last.virtualAddress, relocSize);
+				for (const Content& section : this->sections) image.sections.push_back(section.header);
+				image.pointers = this->pointers;
+				return image;
+			}
+
+		private:
+			Options options;
+			std::mt19937 rng;
+			std::vector<Content> sections;
+			std::vector<std::vector<bool>> used; // the used slots of every .rdata section
+			size_t rdataBegin = 0, rdataEnd = 0, dataIndex = 0;
+			size_t dataOffset = 0;
+			std::vector<std::pair<uint32_t, uint64_t>> pointers;
+
+			static std::string mangledName(const size_t index)
+			{
+				return std::string(index % 5 == 4 ? ".?AU" : ".?AV") + "Class" + std::to_string(index) + "@Synthetic@@";
+			}
+
+			void addSection(const char* name, uint32_t& rva, const uint32_t virtualSize, const uint32_t rawContentSize, const unsigned char rawPadding)
+			{
+				Content section;
+				section.header = { name, rva, virtualSize, 0, alignUp(rawContentSize, fileAlignment) };
+				section.bytes.assign(virtualSize, 0);
+				section.rawContentSize = rawContentSize;
+				section.rawPadding = rawPadding;
+				this->sections.push_back(std::move(section));
+				rva = alignUp(rva + virtualSize, sectionAlignment);
+			}
+
+			uint32_t slotRva(const size_t section, const size_t slot) const
+			{
+				return this->sections[section].header.virtualAddress + static_cast<uint32_t>(slot * 8);
+			}
+
+			void putPointer(const size_t section, const size_t offset, const uint32_t targetRva)
+			{
+				const uint64_t value = imageBase + targetRva;
+				put<uint64_t>(this->sections[section].bytes, offset, value);
+				this->pointers.emplace_back(this->sections[section].header.virtualAddress + static_cast<uint32_t>(offset), value);
+			}
+
+			bool isFree(const size_t section, const size_t slot, const size_t count) const
+			{
+				const std::vector<bool>& used = this->used[section - this->rdataBegin];
+				if (slot + count > used.size()) return false;
+				return std::none_of(used.begin() + slot, used.begin() + slot + count, [](bool u) { return u; });
+			}
+
+			void take(const size_t section, const size_t slot, const size_t count)
+			{
+				std::vector<bool>& used = this->used[section - this->rdataBegin];
+				std::fill(used.begin() + slot, used.begin() + slot + count, true);
+			}
+
+			// A free run of slots anywhere in .rdata, as a section index and a slot.
+			std::pair<size_t, size_t> allocate(const size_t count)
+			{
+				while (true) {
+					const size_t section = this->rdataBegin + this->rng() % (this->rdataEnd - this->rdataBegin);
+					const size_t slot = this->rng() % this->used[section - this->rdataBegin].size();
+					if (this->isFree(section, slot, count)) {
+						this->take(section, slot, count);
+						return { section, slot };
+					}
+				}
+			}
+
+			uint32_t randomTextRva()
+			{
+				const Section& text = this->sections[0].header;
+				return text.virtualAddress + this->rng() % text.virtualSize;
+			}
+
+			// A complete object locator pointer followed by the function pointers, at a given place. Returns the table's RVA.
+			uint32_t putTable(const size_t section, const size_t slot, const size_t functions, const uint32_t col)
+			{
+				this->putPointer(section, slot * 8, col);
+				for (size_t f = 0; f < functions; f++) this->putPointer(section, (slot + 1 + f) * 8, this->randomTextRva());
+				return this->slotRva(section, slot + 1);
+			}
+
+			// A complete object locator, offset is the position of the table's subobject in the complete object.
+			uint32_t putLocator(const unsigned int offset, const uint32_t td, const uint32_t chd)
+			{
+				const auto [section, slot] = this->allocate(3);
+				std::vector<unsigned char>& bytes = this->sections[section].bytes;
+				put<uint32_t>(bytes, slot * 8, 1);
+				put<uint32_t>(bytes, slot * 8 + 4, offset);
+				put<uint32_t>(bytes, slot * 8 + 8, 0);
+				put<int32_t>(bytes, slot * 8 + 12, static_cast<int32_t>(td));
+				put<int32_t>(bytes, slot * 8 + 16, static_cast<int32_t>(chd));
+				return this->slotRva(section, slot);
+			}
+
+			void placeClasses(Image& image)
+			{
+				const size_t count = this->options.classCount;
+				const size_t lastSection = this->rdataEnd - 1;
+				const size_t lastSlot = this->used[lastSection - this->rdataBegin].size() - 1;
+
+				// the first class's table starts at the first slot of .rdata, the second one's ends at the last slot
+				if (count > 0) this->take(this->rdataBegin, 0, 4);
+				if (count > 1) this->take(lastSection, lastSlot - 1, 2);
+
+				for (size_t i = 0; i < count; i++) {
+					// the type descriptor in .data: the type_info vtable, a spare pointer and the name
+					const std::string name = mangledName(i);
+					const uint32_t td = this->sections[this->dataIndex].header.virtualAddress + static_cast<uint32_t>(this->dataOffset);
+					memcpy(this->sections[this->dataIndex].bytes.data() + this->dataOffset + 16, name.c_str(), name.size() + 1);
+					this->dataOffset += alignUp(16 + name.size() + 1, 16);
+
+					// the class hierarchy descriptor and its base class descriptor
+					const auto [chdSection, chdSlot] = this->allocate(2);
+					const auto [bcdSection, bcdSlot] = this->allocate(4);
+					const uint32_t chd = this->slotRva(chdSection, chdSlot);
+					const uint32_t bcd = this->slotRva(bcdSection, bcdSlot);
+					put<uint32_t>(this->sections[chdSection].bytes, chdSlot * 8 + 8, 1);
+					put<int32_t>(this->sections[chdSection].bytes, chdSlot * 8 + 12, static_cast<int32_t>(bcd));
+					put<int32_t>(this->sections[bcdSection].bytes, bcdSlot * 8, static_cast<int32_t>(td));
+					put<int32_t>(this->sections[bcdSection].bytes, bcdSlot * 8 + 12, -1);
+					put<uint32_t>(this->sections[bcdSection].bytes, bcdSlot * 8 + 20, 0x40);
+					put<int32_t>(this->sections[bcdSection].bytes, bcdSlot * 8 + 24, static_cast<int32_t>(chd));
+
+					uint32_t vft;
+					const uint32_t col = this->putLocator(0, td, chd);
+					if (i == 0) {
+						vft = this->putTable(this->rdataBegin, 0, 3, col);
+					}
+					else if (i == 1) {
+						vft = this->putTable(lastSection, lastSlot - 1, 1, col);
+					}
+					else {
+						const size_t functions = 1 + this->rng() % 6;
+						const auto [section, slot] = this->allocate(functions + 1);
+						vft = this->putTable(section, slot, functions, col);
+					}
+
+					if (i >= 2 && i < 2 + this->options.secondaryTables) {
+						const size_t functions = 1 + this->rng() % 3;
+						const auto [section, slot] = this->allocate(functions + 1);
+						vft = (std::min)(vft, this->putTable(section, slot, functions, this->putLocator(8, td, chd)));
+					}
+
+					std::string demangled = name.substr(4, name.find('@') - 4);
+					image.classes.push_back({ "Synthetic::" + demangled, name, vft });
+				}
+			}
+
+			void placeDecoys()
+			{
+				for (size_t i = 0; i < this->options.decoys; i++) {
+					const auto [section, slot] = this->allocate(2);
+
+					// the target is left to the garbage
+					size_t targetSection, targetSlot;
+					do {
+						targetSection = this->rdataBegin + this->rng() % (this->rdataEnd - this->rdataBegin);
+						targetSlot = this->rng() % this->used[targetSection - this->rdataBegin].size();
+					} while (!this->isFree(targetSection, targetSlot, 3));
+					this->putPointer(section, slot * 8, this->slotRva(targetSection, targetSlot));
+					this->putPointer(section, slot * 8 + 8, this->randomTextRva());
+				}
+			}
+
+			// Random data in every unused slot, never a complete object locator signature.
+			void fillGarbage()
+			{
+				for (size_t section = this->rdataBegin; section < this->rdataEnd; section++) {
+					const std::vector<bool>& used = this->used[section - this->rdataBegin];
+					for (size_t slot = 0; slot < used.size(); slot++) {
+						if (used[slot]) continue;
+						const uint64_t value = static_cast<uint64_t>(this->rng()) << 32 | (this->rng() | 2);
+						put<uint64_t>(this->sections[section].bytes, slot * 8, this->rng() % 4 ? value : 0);
+					}
+				}
+			}
+
+			std::vector<unsigned char> writeFile(const uint32_t sizeOfImage, const uint32_t relocRva, const uint32_t relocSize)
+			{
+				size_t fileSize = sizeOfHeaders;
+				for (Content& section : this->sections) {
+					section.header.rawOffset = static_cast<uint32_t>(fileSize);
+					fileSize += section.header.rawSize;
+				}
+
+				std::vector<unsigned char> file(fileSize, 0);
+				put<uint16_t>(file, 0, 0x5A4D);
+				put<uint32_t>(file, 0x3C, 0x80);
+
+				const size_t pe = 0x80, optional = pe + 0x18;
+				put<uint32_t>(file, pe, 0x4550);
+				put<uint16_t>(file, pe + 0x04, 0x8664);
+				put<uint16_t>(file, pe + 0x06, static_cast<uint16_t>(this->sections.size()));
+				put<uint32_t>(file, pe + 0x08, this->options.timestamp);
+				put<uint16_t>(file, pe + 0x14, 0xF0);
+				put<uint16_t>(file, pe + 0x16, 0x22);
+
+				put<uint16_t>(file, optional, 0x20B);
+				put<uint32_t>(file, optional + 0x10, this->sections[0].header.virtualAddress);
+				put<uint64_t>(file, optional + 0x18, imageBase);
+				put<uint32_t>(file, optional + 0x20, sectionAlignment);
+				put<uint32_t>(file, optional + 0x24, fileAlignment);
+				put<uint32_t>(file, optional + 0x38, sizeOfImage);
+				put<uint32_t>(file, optional + 0x3C, sizeOfHeaders);
+				put<uint32_t>(file, optional + 0x6C, 16);
+				put<uint32_t>(file, optional + 0x70 + 5 * 8, relocRva);
+				put<uint32_t>(file, optional + 0x70 + 5 * 8 + 4, relocSize);
+
+				for (size_t i = 0; i < this->sections.size(); i++) {
+					const Content& section = this->sections[i];
+					const size_t header = optional + 0xF0 + i * 0x28;
+					memcpy(file.data() + header, section.header.name.c_str(), section.header.name.size());
+					put<uint32_t>(file, header + 0x08, section.header.virtualSize);
+					put<uint32_t>(file, header + 0x0C, section.header.virtualAddress);
+					put<uint32_t>(file, header + 0x10, section.header.rawSize);
+					put<uint32_t>(file, header + 0x14, section.header.rawOffset);
+
+					memcpy(file.data() + section.header.rawOffset, section.bytes.data(), (std::min)(section.rawContentSize, section.header.virtualSize));
+					for (uint32_t k = section.header.virtualSize; k < section.header.rawSize; k++) file[section.header.rawOffset + k] = section.rawPadding;
+				}
+				return file;
+			}
+		};
+	}
+
+	inline Image build(const Options& options = {})
+	{
+		return Impl::Builder(options).build();
+	}
+
+	// A file in the temporary directory, deleted again when it goes out of scope.
+	class TempFile {
+	public:
+		TempFile(const std::vector<unsigned char>& contents = {})
+		{
+			char path[] = "/tmp/skeletonman-XXXXXX";
+			const int descriptor = mkstemp(path);
+			if (descriptor < 0) return;
+
+			this->path = path;
+			size_t written = 0;
+			while (written < contents.size()) {
+				const ssize_t result = write(descriptor, contents.data() + written, contents.size() - written);
+				if (result <= 0) break;
+				written += static_cast<size_t>(result);
+			}
+			close(descriptor);
+		}
+
+		~TempFile()
+		{
+			if (!this->path.empty()) unlink(this->path.c_str());
+		}
+
+		TempFile(const TempFile&) = delete;
+		TempFile& operator = (const TempFile&) = delete;
+
+		const char* getPath() const { return this->path.c_str(); }
+
+	private:
+		std::string path;
+	};
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+// A minimal test runner. Tests are registered with TEST and run in order by Test::run, failed checks are reported
+// with their location and make the test executable return 1.
+namespace Test {
+	namespace Impl {
+		struct Case {
+			const char* name;
+			void (*fn)();
+		};
+
+		inline std::vector<Case>& cases()
+		{
+			static std::vector<Case> cases;
+			return cases;
+		}
+
+		inline int& failures()
+		{
+			static int failures = 0;
+			return failures;
+		}
+
+		struct Registrar {
+			Registrar(const char* name, void (*fn)()) { cases().push_back({ name, fn }); }
+		};
+
+		inline bool check(const bool condition, const char* expression, const char* file, const int line)
+		{
+			if (!condition) {
+				printf("  %s:%d: check failed: %s\n", file, line, expression);
+				failures()++;
+			}
+			return condition;
+		}
+	}
+
+	// Runs every registered test, returns the exit code for main.
+	inline int run()
+	{
+		int failedCases = 0;
+		for (const Impl::Case& test : Impl::cases()) {
+			const int failures = Impl::failures();
+			test.fn();
+			const bool passed = Impl::failures() == failures;
+			printf("[%s] %s\n", passed ? "  OK  " : " FAIL ", test.name);
+			if (!passed) failedCases++;
+		}
+
+		printf("%d of %zu tests passed\n", static_cast<int>(Impl::cases().size()) - failedCases, Impl::cases().size());
+		return failedCases ? 1 : 0;
+	}
+}
+
+#define TEST(name) \
+	static void name(); \
+	static const Test::Impl::Registrar name##Registrar(#name, &name); \
+	static void name()
+
+// Reports a failed condition and continues. Evaluates to the condition, so a test can stop early with if (!CHECK(...)) return.
+#define CHECK(condition) Test::Impl::check(!!(condition), #condition, __FILE__, __LINE__)
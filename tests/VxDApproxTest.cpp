@@ -0,0 +1,158 @@
+#include <math.h>
+#include <string.h>
+#include <random>
+
+#include "include/VxDApprox.h"
+#include "Test.h"
+
+// The approximations in VxDApprox.h against the C runtime in double precision, over each function's stated domain.
+// Every function is evaluated four lanes at a time on evenly spaced inputs, random inputs and the ends of its domain,
+// and its maximum error must stay within the one documented next to it.
+
+namespace {
+	constexpr int evenSamples = 1 << 20;
+	constexpr int randomSamples = 1 << 20;
+
+	struct Error {
+		double max = 0.0;
+		float at = 0.0f;
+
+		void add(const double error, const float x)
+		{
+			// a NaN is the largest error
+			if (!(error <= this->max)) {
+				this->max = error;
+				this->at = x;
+			}
+		}
+	};
+
+	// Runs fn on all samples of [low, high], four at a time, and returns the largest error reported by measure.
+	template <typename Fn, typename Measure> Error sweep(const float low, const float high, Fn fn, Measure measure)
+	{
+		std::mt19937 rng(32);
+		std::uniform_real_distribution<float> random(low, high);
+		std::vector<float> inputs = { low, high, nextafterf(low, high), nextafterf(high, low), 0.0f };
+		for (int i = 0; i <= evenSamples; i++) inputs.push_back(low + (high - low) * (static_cast<double>(i) / evenSamples));
+		for (int i = 0; i < randomSamples; i++) inputs.push_back(random(rng));
+		while (inputs.size() % 4) inputs.push_back(low);
+
+		Error error;
+		for (size_t i = 0; i < inputs.size(); i += 4) {
+			if (inputs[i] < low || inputs[i] > high) continue;
+			alignas(16) float out[4];
+			_mm_store_ps(out, fn(_mm_loadu_ps(&inputs[i])));
+			for (int k = 0; k < 4; k++) {
+				if (inputs[i + k] >= low && inputs[i + k] <= high) error.add(measure(out[k], static_cast<double>(inputs[i + k])), inputs[i + k]);
+			}
+		}
+		return error;
+	}
+
+	double relative(const double approx, const double exact)
+	{
+		return fabs(approx - exact) / fabs(exact);
+	}
+
+	bool within(const char* name, const Error& error, const double bound)
+	{
+		if (error.max <= bound) return true;
+		printf("  %s: max error %.3g at %.9g, documented %.3g\n", name, error.max, error.at, bound);
+		return false;
+	}
+}
+
+TEST(SinCos)
+{
+	const Error sinError = sweep(-8192.0f, 8192.0f, [](const __m128 x) { return VxD::Approx::sin(x); },
+		[](const float s, const double x) { return fabs(s - ::sin(x)); });
+	const Error cosError = sweep(-8192.0f, 8192.0f, [](const __m128 x) { return VxD::Approx::cos(x); },
+		[](const float c, const double x) { return fabs(c - ::cos(x)); });
+	CHECK(within("sin", sinError, 9.4e-8));
+	CHECK(within("cos", cosError, 9.4e-8));
+
+	// near 0, where most of the rotations the library computes are
+	const Error smallError = sweep(-4.0f, 4.0f, [](const __m128 x) { return VxD::Approx::sin(x); },
+		[](const float s, const double x) { return fabs(s - ::sin(x)); });
+	CHECK(within("sin near 0", smallError, 9.4e-8));
+
+	// the scalar version is the same function
+	float s, c;
+	VxD::Approx::sincos(1.0f, s, c);
+	CHECK(s == VxD::Approx::sin(1.0f) && c == VxD::Approx::cos(1.0f));
+}
+
+TEST(Atan2)
+{
+	// on circles of different radii and on lines through the axes, covering every octant and the signs of zero
+	for (const float radius : { 1e-20f, 1.0f, 3e4f, 1e30f }) {
+		const Error error = sweep(-3.14159265f, 3.14159265f, [radius](const __m128 t) {
+			__m128 s, c;
+			VxD::Approx::sincos(t, s, c);
+			return VxD::Approx::atan2(_mm_mul_ps(s, _mm_set1_ps(radius)), _mm_mul_ps(c, _mm_set1_ps(radius)));
+		}, [radius](const float a, const double t) {
+			float s, c;
+			VxD::Approx::sincos(static_cast<float>(t), s, c);
+			return fabs(a - ::atan2(static_cast<double>(s * radius), static_cast<double>(c * radius)));
+		});
+		if (!CHECK(within("atan2", error, 2.8e-7))) printf("  radius %g\n", radius);
+	}
+
+	const Error axisError = sweep(-100.0f, 100.0f, [](const __m128 y) { return VxD::Approx::atan2(y, _mm_set1_ps(-1.0f)); },
+		[](const float a, const double y) { return fabs(a - ::atan2(y, -1.0)); });
+	CHECK(within("atan2 with x = -1", axisError, 2.8e-7));
+
+	CHECK(VxD::Approx::atan2(0.0f, 0.0f) == 0.0f);
+}
+
+TEST(Acos)
+{
+	const Error error = sweep(-1.0f, 1.0f, [](const __m128 x) { return VxD::Approx::acos(x); },
+		[](const float a, const double x) { return fabs(a - ::acos(x)); });
+	CHECK(within("acos", error, 3.1e-7));
+}
+
+TEST(Log)
+{
+	// every exponent of the positive normal floats, with random mantissas
+	std::mt19937 rng(32);
+	Error error;
+	for (uint32_t exponent = 1; exponent < 255; exponent++) {
+		for (int i = 0; i < 4096; i += 4) {
+			alignas(16) float x[4], out[4];
+			for (int k = 0; k < 4; k++) {
+				const uint32_t bits = exponent << 23 | (i + k < 4 ? (k == 3 ? 0x7FFFFF : k) : rng() & 0x7FFFFF);
+				memcpy(&x[k], &bits, 4);
+			}
+			_mm_store_ps(out, VxD::Approx::log(_mm_load_ps(x)));
+			for (int k = 0; k < 4; k++) {
+				const double exact = ::log(static_cast<double>(x[k]));
+				// log(1) is 0, the error there is absolute
+				error.add(exact == 0.0 ? fabs(out[k]) : relative(out[k], exact), x[k]);
+			}
+		}
+	}
+	CHECK(within("log", error, 2.3e-7));
+
+	// around 1, where the relative error is hardest to keep
+	const Error nearOne = sweep(0.5f, 2.0f, [](const __m128 x) { return VxD::Approx::log(x); },
+		[](const float l, const double x) { return x == 1.0 ? fabs(l) : relative(l, ::log(x)); });
+	CHECK(within("log near 1", nearOne, 2.3e-7));
+}
+
+TEST(Exp)
+{
+	const Error error = sweep(-87.3f, 88.7f, [](const __m128 x) { return VxD::Approx::exp(x); },
+		[](const float e, const double x) { return relative(e, ::exp(x)); });
+	CHECK(within("exp", error, 8.2e-8));
+
+	// inputs outside of the domain are clamped
+	CHECK(VxD::Approx::exp(1000.0f) == VxD::Approx::exp(88.7228f));
+	CHECK(VxD::Approx::exp(-1000.0f) == VxD::Approx::exp(-87.3365f));
+	CHECK(isfinite(VxD::Approx::exp(1000.0f)));
+}
+
+int main()
+{
+	return Test::run();
+}
@@ -0,0 +1,160 @@
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include "include/VxD.h"
+#include "Test.h"
+
+// Round trips through the affine matrix functions of VxD: transforms to matrices and back, mirrored transforms,
+// and matrices times their inverses. The batch mFromTransforms must build the same matrices as mFromTransform.
+
+namespace {
+	struct Transform {
+		V4D q, translation, scale;
+	};
+
+	std::vector<Transform> makeTransforms(const size_t count, const bool mirrored)
+	{
+		std::mt19937 rng(mirrored ? 361 : 36);
+		std::uniform_real_distribution<float> component(-1.0f, 1.0f), position(-50.0f, 50.0f), scaleExponent(-2.0f, 2.0f);
+
+		std::vector<Transform> transforms;
+		while (transforms.size() < count) {
+			const V4D q(component(rng), component(rng), component(rng), component(rng));
+			if (q.length() < 0.1f) continue;
+
+			V4D scale(exp2f(scaleExponent(rng)), exp2f(scaleExponent(rng)), exp2f(scaleExponent(rng)));
+			if (mirrored) scale[0] = -scale[0];
+			transforms.push_back({ q.normalize(), V4D(position(rng), position(rng), position(rng)), scale });
+		}
+		return transforms;
+	}
+
+	bool near(const V4D a, const V4D b, const float tolerance)
+	{
+		for (int i = 0; i < 4; i++) {
+			if (!(fabsf(a[i] - b[i]) <= tolerance)) return false;
+		}
+		return true;
+	}
+
+	// q and -q are the same rotation
+	bool nearQ(const V4D a, const V4D b, const float tolerance)
+	{
+		return near(a, b, tolerance) || near(a, b * -1.0f, tolerance);
+	}
+
+	// Compares every row relative to the longest axis or translation of a, and to at least 1.
+	bool nearMatrix(const m128Matrix& a, const m128Matrix& b, const float tolerance)
+	{
+		float magnitude = 1.0f;
+		for (const __m128 r : a.r) magnitude = (std::max)(magnitude, V4D(r).flatten<V4D::CoordinateAxis::W>().length());
+		for (int i = 0; i < 4; i++) {
+			if (!near(a.r[i], b.r[i], tolerance * magnitude)) return false;
+		}
+		return true;
+	}
+
+	constexpr size_t count = 4096;
+}
+
+TEST(TransformRoundTrip)
+{
+	int mismatches = 0;
+	for (const Transform& t : makeTransforms(count, false)) {
+		V4D q, translation, scale;
+		VxD::mToTransform(VxD::mFromTransform(t.q, t.translation, t.scale), q, translation, scale);
+
+		if (!nearQ(q, t.q, 2e-6f) || !near(translation, t.translation, 0.0f) || !near(scale, t.scale, 1.6e-5f)) mismatches++;
+	}
+	CHECK(mismatches == 0);
+
+	// the identity and rotations that take each branch of the decomposition
+	const float h = sqrtf(0.5f);
+	for (const V4D& q : { V4D(0.0f, 0.0f, 0.0f, 1.0f), V4D(1.0f, 0.0f, 0.0f, 0.0f), V4D(0.0f, 1.0f, 0.0f, 0.0f), V4D(0.0f, 0.0f, 1.0f, 0.0f), V4D(h, 0.0f, 0.0f, h), V4D(0.0f, h, h, 0.0f) }) {
+		V4D back, translation, scale;
+		VxD::mToTransform(VxD::mFromTransform(q, V4D(1.0f, 2.0f, 3.0f)), back, translation, scale);
+		CHECK(nearQ(back, q, 1e-6f) && near(scale, V4D(1.0f, 1.0f, 1.0f, 0.0f), 1e-6f));
+	}
+}
+
+// A mirroring transform decomposes into a negative scale on the first axis. Mirrored on the first axis, the rotation
+// and the scale come back as they were. Mirrored on any other odd number of axes, the rotation differs,
+// but the transform rebuilt from the decomposition is the same.
+TEST(MirroredTransformRoundTrip)
+{
+	int mismatches = 0;
+	std::mt19937 rng(362);
+	for (const Transform& t : makeTransforms(count, true)) {
+		const m128Matrix m = VxD::mFromTransform(t.q, t.translation, t.scale);
+		V4D q, translation, scale;
+		VxD::mToTransform(m, q, translation, scale);
+		if (!nearQ(q, t.q, 2e-6f) || !near(scale, t.scale, 1.6e-5f)) mismatches++;
+
+		// the same mirror on another axis, or on all three
+		V4D otherScale = t.scale;
+		otherScale[0] = -otherScale[0];
+		if (rng() % 2) otherScale[1 + rng() % 2] *= -1.0f;
+		else otherScale = otherScale * -1.0f;
+
+		const m128Matrix other = VxD::mFromTransform(t.q, t.translation, otherScale);
+		VxD::mToTransform(other, q, translation, scale);
+		if (!(scale[0] < 0.0f && scale[1] > 0.0f && scale[2] > 0.0f)) mismatches++;
+		if (!nearMatrix(VxD::mFromTransform(q, translation, scale), other, 4e-6f)) mismatches++;
+	}
+	CHECK(mismatches == 0);
+}
+
+TEST(InverseAffine)
+{
+	const m128Matrix identity = VxD::mIdentity();
+	int mismatches = 0;
+	for (const bool mirrored : { false, true }) {
+		for (const Transform& t : makeTransforms(count, mirrored)) {
+			const m128Matrix m = VxD::mFromTransform(t.q, t.translation, t.scale);
+			const m128Matrix inverse = VxD::mInverseAffine(m);
+
+			// the scales are up to 4 apart and the translations up to 50 long, the error grows with both
+			if (!nearMatrix(VxD::mMul(m, inverse), identity, 4e-5f)) mismatches++;
+			if (!nearMatrix(VxD::mMul(inverse, m), identity, 4e-5f)) mismatches++;
+
+			// the inverse's last row stays (0, 0, 0, 1)
+			if (V4D(inverse.r[0])[3] != 0.0f || V4D(inverse.r[1])[3] != 0.0f || V4D(inverse.r[2])[3] != 0.0f || V4D(inverse.r[3])[3] != 1.0f) mismatches++;
+		}
+	}
+	CHECK(mismatches == 0);
+
+	// a point transformed and transformed back
+	const m128Matrix m = VxD::mFromTransform(V4D(0.2f, -0.4f, 0.1f, 0.9f).normalize(), V4D(5.0f, -3.0f, 2.0f), V4D(2.0f, 0.5f, -1.5f));
+	const V4D point(1.0f, 2.0f, 3.0f);
+	CHECK(near(VxD::mTransformPoint(VxD::mInverseAffine(m), VxD::mTransformPoint(m, point)), V4D(1.0f, 2.0f, 3.0f, 1.0f), 1e-5f));
+}
+
+TEST(BatchMatchesSingle)
+{
+	for (const size_t n : { 1, 3, 4, 7, 64 }) {
+		const std::vector<Transform> transforms = makeTransforms(n, n % 2 == 1);
+		std::vector<float> lanes[10];
+		for (const Transform& t : transforms) {
+			for (int i = 0; i < 4; i++) lanes[i].push_back(t.q[i]);
+			for (int i = 0; i < 3; i++) lanes[4 + i].push_back(t.translation[i]);
+			for (int i = 0; i < 3; i++) lanes[7 + i].push_back(t.scale[i]);
+		}
+		const float* q[4] = { lanes[0].data(), lanes[1].data(), lanes[2].data(), lanes[3].data() };
+		const float* translation[3] = { lanes[4].data(), lanes[5].data(), lanes[6].data() };
+		const float* scale[3] = { lanes[7].data(), lanes[8].data(), lanes[9].data() };
+
+		std::vector<m128Matrix> batch(n);
+		VxD::mFromTransforms(q, translation, scale, batch.data(), n);
+		for (size_t i = 0; i < n; i++) {
+			if (!CHECK(nearMatrix(batch[i], VxD::mFromTransform(transforms[i].q, transforms[i].translation, transforms[i].scale), 1e-6f))) {
+				printf("  matrix %zu of %zu\n", i, n);
+			}
+		}
+	}
+}
+
+int main()
+{
+	return Test::run();
+}
@@ -0,0 +1,232 @@
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include "include/VxD.h"
+#include "Test.h"
+
+// Compares the SIMD quaternion products of V4D and QuatX4 against scalar references, the component formulas VxD used before
+// they were kept in SSE registers, evaluated in double precision.
+
+namespace {
+	struct Quat {
+		double x, z, y, w;
+
+		Quat(const V4D v) : x(v[0]), z(v[1]), y(v[2]), w(v[3]) {}
+		Quat(const double x, const double z, const double y, const double w) : x(x), z(z), y(y), w(w) {}
+	};
+
+	Quat refMul(const Quat a, const Quat b)
+	{
+		return Quat(a.w * b.x + a.x * b.w + a.z * b.y - a.y * b.z,
+			a.w * b.z - a.x * b.y + a.z * b.w + a.y * b.x,
+			a.w * b.y + a.x * b.z - a.z * b.x + a.y * b.w,
+			a.w * b.w - a.x * b.x - a.z * b.z - a.y * b.y);
+	}
+
+	Quat refDiv(const Quat a, const Quat b)
+	{
+		return Quat(b.w * a.x - b.x * a.w + b.z * a.y - b.y * a.z,
+			b.w * a.z - b.x * a.y - b.z * a.w + b.y * a.x,
+			b.w * a.y + b.x * a.z - b.z * a.x - b.y * a.w,
+			b.w * a.w + b.x * a.x + b.z * a.z + b.y * a.y);
+	}
+
+	// Rotates v by the unit quaternion q.
+	Quat refTransform(const Quat v, const Quat q)
+	{
+		const double ww = q.w * q.w - 0.5;
+		return Quat(2.0 * (v.x * (q.x * q.x + ww) + v.z * (q.x * q.z - q.y * q.w) + v.y * (q.x * q.y + q.z * q.w)),
+			2.0 * (v.x * (q.x * q.z + q.y * q.w) + v.z * (q.z * q.z + ww) + v.y * (q.z * q.y - q.x * q.w)),
+			2.0 * (v.x * (q.x * q.y - q.z * q.w) + v.z * (q.z * q.y + q.x * q.w) + v.y * (q.y * q.y + ww)),
+			0.0);
+	}
+
+	// The error allowed for a product of floats with operands of the given magnitude, a few ulp of the largest term.
+	bool near(const V4D actual, const Quat expected, const double magnitude)
+	{
+		const double tolerance = 8.0 * FLT_EPSILON * std::max(magnitude, 1e-30);
+		return fabs(actual[0] - expected.x) <= tolerance && fabs(actual[1] - expected.z) <= tolerance
+			&& fabs(actual[2] - expected.y) <= tolerance && fabs(actual[3] - expected.w) <= tolerance;
+	}
+
+	double magnitude(const V4D v)
+	{
+		return sqrt(static_cast<double>(v[0]) * v[0] + static_cast<double>(v[1]) * v[1] + static_cast<double>(v[2]) * v[2] + static_cast<double>(v[3]) * v[3]);
+	}
+
+	// Random quaternions, unit ones when normalized, mixed with rotations that are special cases for the formulas.
+	std::vector<V4D> makeInputs(const bool normalized, const size_t count)
+	{
+		std::vector<V4D> inputs = {
+			V4D(0.0f, 0.0f, 0.0f, 1.0f), V4D(0.0f, 0.0f, 0.0f, -1.0f), V4D(1.0f, 0.0f, 0.0f, 0.0f), V4D(0.0f, 1.0f, 0.0f, 0.0f),
+			V4D(0.0f, 0.0f, 1.0f, 0.0f), V4D(-0.0f, -0.0f, -0.0f, 1.0f), V4D(0.5f, 0.5f, 0.5f, 0.5f), V4D(0.5f, -0.5f, 0.5f, -0.5f)
+		};
+
+		std::mt19937 rng(30);
+		std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> exponent(-8.0f, 8.0f);
+		while (inputs.size() < count) {
+			V4D q(component(rng), component(rng), component(rng), component(rng));
+			if (q.iszero()) continue;
+			inputs.push_back(normalized ? q.normalize() : q * exp2f(exponent(rng)));
+		}
+		return inputs;
+	}
+
+	std::vector<V4D> makeVectors(const size_t count)
+	{
+		std::vector<V4D> vectors = { V4D(0.0f), V4D(1.0f, 0.0f, 0.0f), V4D(0.0f, -1.0f, 0.0f), V4D(0.0f, 0.0f, 1e6f), V4D(1e-6f, 2e-6f, -3e-6f) };
+
+		std::mt19937 rng(31);
+		std::uniform_real_distribution<float> component(-100.0f, 100.0f);
+		while (vectors.size() < count) vectors.push_back(V4D(component(rng), component(rng), component(rng)));
+		return vectors;
+	}
+
+	// V4D::isfinite only detects NaN.
+	bool allFinite(const V4D v)
+	{
+		return std::isfinite(v[0]) && std::isfinite(v[1]) && std::isfinite(v[2]) && std::isfinite(v[3]);
+	}
+
+	constexpr size_t count = 4096;
+}
+
+TEST(QMulMatchesScalar)
+{
+	const std::vector<V4D> a = makeInputs(false, count);
+	const std::vector<V4D> b = makeInputs(true, count);
+
+	int mismatches = 0;
+	for (size_t i = 0; i < count; i++) {
+		for (const auto& [p, q] : { std::make_pair(a[i], b[(i * 7) % count]), std::make_pair(b[i], a[(i * 13) % count]), std::make_pair(a[i], a[(i * 5) % count]) }) {
+			if (!near(p.qMul(q), refMul(Quat(p), Quat(q)), magnitude(p) * magnitude(q))) mismatches++;
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+TEST(QDivMatchesScalar)
+{
+	const std::vector<V4D> a = makeInputs(false, count);
+	const std::vector<V4D> b = makeInputs(true, count);
+
+	int mismatches = 0;
+	for (size_t i = 0; i < count; i++) {
+		for (const auto& [p, q] : { std::make_pair(a[i], b[(i * 7) % count]), std::make_pair(b[i], a[(i * 13) % count]), std::make_pair(a[i], a[(i * 5) % count]) }) {
+			if (!near(p.qDiv(q), refDiv(Quat(p), Quat(q)), magnitude(p) * magnitude(q))) mismatches++;
+		}
+	}
+	CHECK(mismatches == 0);
+
+	// dividing a unit quaternion by itself is the identity, whatever the sign convention of the product
+	for (size_t i = 0; i < 64; i++) {
+		CHECK(near(b[i].qDiv(b[i]), Quat(0.0, 0.0, 0.0, 1.0), 1.0));
+	}
+}
+
+TEST(QTransformMatchesScalar)
+{
+	const std::vector<V4D> q = makeInputs(true, count);
+	const std::vector<V4D> v = makeVectors(count);
+
+	int mismatches = 0;
+	for (size_t i = 0; i < count; i++) {
+		for (const V4D& vector : { v[i], v[(i * 11) % count] }) {
+			const V4D result = vector.qTransform(q[i]);
+			if (!near(result, refTransform(Quat(vector), Quat(q[i])), magnitude(vector))) mismatches++;
+			if (result[3] != 0.0f) mismatches++;
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+TEST(QuatX4MatchesScalar)
+{
+	const std::vector<V4D> a = makeInputs(false, count);
+	const std::vector<V4D> b = makeInputs(true, count);
+	const std::vector<V4D> v = makeVectors(count);
+
+	int mismatches = 0;
+	for (size_t i = 0; i < count; i += VxD::QuatX4::width) {
+		const VxD::QuatX4 pa = VxD::QuatX4::load(&a[i]);
+		const VxD::QuatX4 pb = VxD::QuatX4::load(&b[i]);
+		const VxD::QuatX4 pv = VxD::QuatX4::load(&v[i]);
+
+		alignas(16) V4D product[4], transformed[4];
+		pa.qMul(pb).store(product);
+		pv.qTransform(pb).store(transformed);
+
+		for (size_t k = 0; k < VxD::QuatX4::width; k++) {
+			if (!near(product[k], refMul(Quat(a[i + k]), Quat(b[i + k])), magnitude(a[i + k]))) mismatches++;
+			if (!near(transformed[k], refTransform(Quat(v[i + k]), Quat(b[i + k])), magnitude(v[i + k]))) mismatches++;
+			if (transformed[k][3] != 0.0f) mismatches++;
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+// Non-finite inputs must not turn into finite garbage.
+TEST(NonFiniteInputsPropagate)
+{
+	const V4D q = V4D(0.5f, 0.5f, 0.5f, 0.5f);
+	for (const float bad : { NAN, INFINITY, -INFINITY }) {
+		for (int lane = 0; lane < 4; lane++) {
+			float components[4] = { 0.1f, 0.2f, 0.3f, 0.9f };
+			components[lane] = bad;
+			const V4D p(components[0], components[1], components[2], components[3]);
+
+			CHECK(!allFinite(p.qMul(q)));
+			CHECK(!allFinite(q.qMul(p)));
+			CHECK(!allFinite(p.qDiv(q)));
+			if (lane < 3) CHECK(!allFinite(p.qTransform(q)));
+		}
+	}
+}
+
+// A rotation accumulated frame after frame is renormalized by the batch kernel, as HkSkeleton::updateAll does for the rotations
+// modifiers write. The length must stay near 1 however many frames pass, at every tier.
+TEST(AccumulatedRotationsDoNotDrift)
+{
+	constexpr size_t rotations = 61;
+	constexpr int frames = 20000;
+
+	std::mt19937 rng(35);
+	std::uniform_real_distribution<float> component(-1.0f, 1.0f), angle(-0.05f, 0.05f);
+	std::vector<V4D> deltas;
+	while (deltas.size() < rotations) {
+		const V4D axis(component(rng), component(rng), component(rng));
+		if (axis.length() > 0.1f) deltas.push_back(V4D(axis.normalize(), angle(rng)));
+	}
+
+	for (int tier = 0; tier <= static_cast<int>(CPUFeatures::detect()); tier++) {
+		CPUFeatures::force(static_cast<CPUFeatures::Tier>(tier));
+
+		std::vector<V4D> q = makeInputs(true, rotations);
+		std::vector<V4D*> pointers;
+		for (V4D& rotation : q) pointers.push_back(&rotation);
+
+		double maxDrift = 0.0, unnormalizedDrift = 0.0;
+		V4D unnormalized = q[0];
+		for (int frame = 0; frame < frames; frame++) {
+			for (size_t i = 0; i < rotations; i++) q[i] = q[i].qMul(deltas[i]);
+			VxD::Kernels::qNormalize(pointers.data(), pointers.size());
+			for (const V4D& rotation : q) maxDrift = std::max(maxDrift, fabs(magnitude(rotation) - 1.0));
+
+			unnormalized = unnormalized.qMul(deltas[0]);
+			unnormalizedDrift = fabs(magnitude(unnormalized) - 1.0);
+		}
+
+		if (!CHECK(maxDrift <= 4e-7)) printf("  tier %d: |length - 1| up to %g\n", tier, maxDrift);
+		// the products alone do drift, so the bound above is the renormalization's doing
+		CHECK(unnormalizedDrift > maxDrift);
+	}
+	CPUFeatures::initialize();
+}
+
+int main()
+{
+	CPUFeatures::initialize();
+	return Test::run();
+}